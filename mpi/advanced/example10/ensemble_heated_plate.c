@@ -0,0 +1,409 @@
+/*
+** An ensemble of heated plate simulations, run within a single MPI job.
+**
+** Parameter sweeps over the boundary temperatures of the heated plate
+** (see mpi/example5/skeleton2-heated-plate.c) are often launched as
+** hundreds of small, separate jobs.  Here, instead, we:
+**
+** - split MPI_COMM_WORLD into groups of ranks using MPI_Comm_split(),
+** - give each group its own communicator, on which the usual column-based
+**   halo exchange is performed, and
+** - let each group solve one case at a time from a list of cases.
+**
+** Cases are handed out dynamically: whenever a group finishes a case, its
+** leader takes the index of the next pending case from a shared counter
+** held by the master rank, using the one-sided MPI_Fetch_and_op().
+** Cases which converge quickly therefore leave their group free to pick up
+** more work, rather than waiting idle for the slowest group.
+**
+** Usage: ensemble_heated_plate.exe <ranks_per_case> [cases_file]
+**
+** The optional cases file holds one case per line, listing the top,
+** bottom, left and right boundary temperatures, e.g.
+**
+**   # top bottom left right
+**   0.0 100.0 100.0 100.0
+**   50.0 100.0 0.0 100.0
+**
+** If no file is given, a default sweep over the top temperature is used.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mpi.h"
+
+#define NROWS 32
+#define NCOLS 32
+#define EPSILON 0.01       /* convergence threshold on the largest change in a step */
+#define MAXITERS 100000    /* give up on a case after this many steps */
+#define MAXCASES 4096      /* maximum number of cases read from file */
+#define NDEFAULTCASES 24   /* number of cases in the default sweep */
+#define NBCS 4             /* number of boundary values per case */
+#define NRESULTS 3         /* iterations, mean and centre temperature per case */
+#define MASTER 0
+
+/* indices into the boundary values for a case */
+#define TOP 0
+#define BOTTOM 1
+#define LEFT 2
+#define RIGHT 3
+
+/* function prototypes */
+int calc_ncols_from_rank(int rank, int size);
+int read_cases(const char* filename, double* cases);
+int default_cases(double* cases);
+int solve_plate(const double* bc, MPI_Comm comm, double* mean, double* centre);
+
+int main(int argc, char* argv[])
+{
+  int ii;                /* generic counter */
+  int rank;              /* the rank of this process in MPI_COMM_WORLD */
+  int size;              /* number of processes in MPI_COMM_WORLD */
+  int ranks_per_case;    /* number of ranks working together on each case */
+  int colour;            /* ranks of the same colour work on the same case */
+  int ngroups;           /* number of groups of ranks */
+  int case_rank;         /* the rank of this process within its group */
+  int ncases;            /* number of cases in the ensemble */
+  int icase;             /* index of the case being solved */
+  int one = 1;           /* increment for the shared case counter */
+  int next_case = 0;     /* shared counter, only used on the master rank */
+  int iters;             /* number of steps taken to solve a case */
+  double mean;           /* mean temperature over the plate for a case */
+  double centre;         /* temperature at the centre of the plate for a case */
+  double tic, toc;       /* timestamps */
+  double* cases;         /* boundary values for all cases */
+  double* results;       /* results for the cases solved by this group */
+  double* allresults;    /* results for all cases, gathered on the master */
+  int* group_ncases;     /* number of cases solved by each group */
+  int* all_group_ncases; /* as above, totalled on the master */
+  MPI_Comm case_comm;    /* communicator for the ranks sharing a case */
+  MPI_Win counter_win;   /* RMA window exposing next_case */
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  if (argc < 2) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s <ranks_per_case> [cases_file]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  ranks_per_case = atoi(argv[1]);
+  if (ranks_per_case < 1 || ranks_per_case > size || ranks_per_case > NCOLS) {
+    if (rank == MASTER)
+      fprintf(stderr, "Error: ranks_per_case must be between 1 and %d\n",
+              (size < NCOLS) ? size : NCOLS);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  /*
+  ** the master reads the list of cases and shares it with everyone
+  */
+  cases = (double*)malloc(sizeof(double) * MAXCASES * NBCS);
+  if (rank == MASTER) {
+    ncases = (argc > 2) ? read_cases(argv[2], cases) : default_cases(cases);
+    if (ncases < 1) {
+      fprintf(stderr, "Error: no cases to solve\n");
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+  }
+  MPI_Bcast(&ncases, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+  MPI_Bcast(cases, ncases * NBCS, MPI_DOUBLE, MASTER, MPI_COMM_WORLD);
+
+  /*
+  ** split the processes into groups of ranks_per_case ranks.
+  ** if size is not a multiple of ranks_per_case, the last group
+  ** is smaller, which calc_ncols_from_rank() copes with.
+  */
+  colour = rank / ranks_per_case;
+  ngroups = (size + ranks_per_case - 1) / ranks_per_case;
+  MPI_Comm_split(MPI_COMM_WORLD, colour, rank, &case_comm);
+  MPI_Comm_rank(case_comm, &case_rank);
+
+  /*
+  ** the counter of the next pending case lives on the master.
+  ** as in rma_trapezoid.c, all processes create the window, but only
+  ** the master exposes any memory.
+  */
+  if (rank == MASTER) {
+    MPI_Win_create(&next_case, sizeof(int), sizeof(int), MPI_INFO_NULL,
+                   MPI_COMM_WORLD, &counter_win);
+  }
+  else {
+    MPI_Win_create(MPI_BOTTOM, 0, sizeof(int), MPI_INFO_NULL,
+                   MPI_COMM_WORLD, &counter_win);
+  }
+
+  results = (double*)calloc(ncases * NRESULTS, sizeof(double));
+  allresults = (double*)calloc(ncases * NRESULTS, sizeof(double));
+  group_ncases = (int*)calloc(ngroups, sizeof(int));
+  all_group_ncases = (int*)calloc(ngroups, sizeof(int));
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = MPI_Wtime();
+
+  /*
+  ** work loop: the group leader claims the next pending case and
+  ** tells the rest of its group which one it is.  The counter is
+  ** incremented atomically, so no case is solved twice.
+  */
+  while (1) {
+    if (case_rank == MASTER) {
+      MPI_Win_lock(MPI_LOCK_SHARED, MASTER, 0, counter_win);
+      MPI_Fetch_and_op(&one, &icase, MPI_INT, MASTER, 0, MPI_SUM, counter_win);
+      MPI_Win_unlock(MASTER, counter_win);
+    }
+    MPI_Bcast(&icase, 1, MPI_INT, MASTER, case_comm);
+    if (icase >= ncases) break;
+
+    iters = solve_plate(&cases[icase * NBCS], case_comm, &mean, &centre);
+
+    if (case_rank == MASTER) {
+      results[icase * NRESULTS + 0] = (double)iters;
+      results[icase * NRESULTS + 1] = mean;
+      results[icase * NRESULTS + 2] = centre;
+      group_ncases[colour]++;
+    }
+  }
+
+  toc = MPI_Wtime();
+
+  /* only group leaders hold non-zero results, so a sum collects them all */
+  MPI_Reduce(results, allresults, ncases * NRESULTS, MPI_DOUBLE, MPI_SUM,
+             MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(group_ncases, all_group_ncases, ngroups, MPI_INT, MPI_SUM,
+             MASTER, MPI_COMM_WORLD);
+
+  if (rank == MASTER) {
+    printf("NROWS: %d\nNCOLS: %d\n", NROWS, NCOLS);
+    printf("%d cases solved by %d groups of up to %d ranks in %f s\n\n",
+           ncases, ngroups, ranks_per_case, toc - tic);
+    printf("%5s %8s %8s %8s %8s %8s %10s %10s\n",
+           "case", "top", "bottom", "left", "right", "iters", "mean", "centre");
+    for (icase = 0; icase < ncases; icase++) {
+      printf("%5d %8.2f %8.2f %8.2f %8.2f %8d %10.4f %10.4f\n", icase,
+             cases[icase * NBCS + TOP], cases[icase * NBCS + BOTTOM],
+             cases[icase * NBCS + LEFT], cases[icase * NBCS + RIGHT],
+             (int)allresults[icase * NRESULTS + 0],
+             allresults[icase * NRESULTS + 1], allresults[icase * NRESULTS + 2]);
+    }
+    printf("\n");
+    for (ii = 0; ii < ngroups; ii++)
+      printf("group %d solved %d cases\n", ii, all_group_ncases[ii]);
+  }
+
+  /* free up the window and communicator now that we have finished with them */
+  MPI_Win_free(&counter_win);
+  MPI_Comm_free(&case_comm);
+
+  MPI_Finalize();
+
+  free(cases);
+  free(results);
+  free(allresults);
+  free(group_ncases);
+  free(all_group_ncases);
+
+  return EXIT_SUCCESS;
+}
+
+/*
+** Solve a single heated plate case on the ranks of 'comm'.
+** The plate is divided into column strips, exactly as in
+** skeleton2-heated-plate.c, and Jacobi steps are taken until
+** the largest change in any cell falls below EPSILON.
+** Returns the number of steps taken, which is MAXITERS if the case did
+** not converge; the mean temperature and the temperature at the centre of
+** the plate are returned on rank 0 of comm.
+*/
+int solve_plate(const double* bc, MPI_Comm comm, double* mean, double* centre)
+{
+  int ii, jj;            /* row and column indices for the grid */
+  int iter;              /* index for timestep iterations */
+  int rank;              /* the rank of this process in comm */
+  int size;              /* number of processes in comm */
+  int left;              /* the rank of the process to the left */
+  int right;             /* the rank of the process to the right */
+  int tag = 0;           /* scope for adding extra information to a message */
+  MPI_Status status;     /* struct used by MPI_Sendrecv */
+  int local_ncols;       /* number of columns apportioned to this rank */
+  int start_col;         /* first global column held by this rank */
+  int first, last;       /* local columns which are updated by the stencil */
+  int width;             /* local row length, including the halos */
+  double boundary_mean;  /* mean of boundary values used to initialise inner cells */
+  double diff;           /* largest local change in a step */
+  double maxdiff;        /* largest change over all ranks in a step */
+  double local_vals[2];  /* local sum and centre contributions */
+  double vals[2];        /* as above, reduced onto rank 0 */
+  double* u;             /* local temperature grid at time t - 1 */
+  double* w;             /* local temperature grid at time t     */
+  double* sendbuf;       /* buffer to hold values to send */
+  double* recvbuf;       /* buffer to hold received values */
+
+  MPI_Comm_size(comm, &size);
+  MPI_Comm_rank(comm, &rank);
+
+  /* the plate is not periodic, so the end ranks have no neighbour */
+  left = (rank == 0) ? MPI_PROC_NULL : rank - 1;
+  right = (rank == size - 1) ? MPI_PROC_NULL : rank + 1;
+
+  local_ncols = calc_ncols_from_rank(rank, size);
+  start_col = rank * (NCOLS / size);
+  width = local_ncols + 2;
+
+  u = (double*)malloc(sizeof(double) * NROWS * width);
+  w = (double*)malloc(sizeof(double) * NROWS * width);
+  sendbuf = (double*)malloc(sizeof(double) * NROWS);
+  recvbuf = (double*)malloc(sizeof(double) * NROWS);
+
+  /* initialise boundaries and inner cells, as in skeleton2-heated-plate.c */
+  boundary_mean = ((NROWS - 2) * (bc[LEFT] + bc[RIGHT]) +
+                   NCOLS * (bc[TOP] + bc[BOTTOM])) /
+                  (double)((2 * NROWS) + (2 * NCOLS) - 4);
+  for (ii = 0; ii < NROWS; ii++) {
+    for (jj = 0; jj < width; jj++) {
+      if (ii == 0)
+        w[ii * width + jj] = bc[TOP];
+      else if (ii == NROWS - 1)
+        w[ii * width + jj] = bc[BOTTOM];
+      else if ((rank == 0) && jj == 1)
+        w[ii * width + jj] = bc[LEFT];
+      else if ((rank == size - 1) && jj == local_ncols)
+        w[ii * width + jj] = bc[RIGHT];
+      else
+        w[ii * width + jj] = boundary_mean;
+    }
+  }
+
+  /* don't overwrite the left and right boundary conditions */
+  first = (rank == 0) ? 2 : 1;
+  last = (rank == size - 1) ? local_ncols - 1 : local_ncols;
+
+  for (iter = 0; iter < MAXITERS; iter++) {
+    /* send to the left, receive from right */
+    for (ii = 0; ii < NROWS; ii++)
+      sendbuf[ii] = w[ii * width + 1];
+    MPI_Sendrecv(sendbuf, NROWS, MPI_DOUBLE, left, tag,
+                 recvbuf, NROWS, MPI_DOUBLE, right, tag,
+                 comm, &status);
+    if (right != MPI_PROC_NULL)
+      for (ii = 0; ii < NROWS; ii++)
+        w[ii * width + local_ncols + 1] = recvbuf[ii];
+
+    /* send to the right, receive from left */
+    for (ii = 0; ii < NROWS; ii++)
+      sendbuf[ii] = w[ii * width + local_ncols];
+    MPI_Sendrecv(sendbuf, NROWS, MPI_DOUBLE, right, tag,
+                 recvbuf, NROWS, MPI_DOUBLE, left, tag,
+                 comm, &status);
+    if (left != MPI_PROC_NULL)
+      for (ii = 0; ii < NROWS; ii++)
+        w[ii * width] = recvbuf[ii];
+
+    /* copy the old solution into the u grid */
+    memcpy(u, w, sizeof(double) * NROWS * width);
+
+    /* compute new values of w using u, noting the largest change */
+    diff = 0.0;
+    for (ii = 1; ii < NROWS - 1; ii++) {
+      for (jj = first; jj < last + 1; jj++) {
+        w[ii * width + jj] = (u[(ii - 1) * width + jj] + u[(ii + 1) * width + jj] +
+                              u[ii * width + jj - 1] + u[ii * width + jj + 1]) / 4.0;
+        diff = fmax(diff, fabs(w[ii * width + jj] - u[ii * width + jj]));
+      }
+    }
+
+    /* all ranks in the group must agree on when to stop */
+    MPI_Allreduce(&diff, &maxdiff, 1, MPI_DOUBLE, MPI_MAX, comm);
+    if (maxdiff < EPSILON) break;
+  }
+
+  /* summarise the solution on rank 0 of the group */
+  local_vals[0] = 0.0;
+  local_vals[1] = 0.0;
+  for (ii = 0; ii < NROWS; ii++)
+    for (jj = 1; jj < local_ncols + 1; jj++)
+      local_vals[0] += w[ii * width + jj];
+  if (NCOLS / 2 >= start_col && NCOLS / 2 < start_col + local_ncols)
+    local_vals[1] = w[(NROWS / 2) * width + (NCOLS / 2 - start_col) + 1];
+  MPI_Reduce(local_vals, vals, 2, MPI_DOUBLE, MPI_SUM, 0, comm);
+  if (rank == 0) {
+    *mean = vals[0] / (double)(NROWS * NCOLS);
+    *centre = vals[1];
+  }
+
+  free(u);
+  free(w);
+  free(sendbuf);
+  free(recvbuf);
+
+  /* iter is MAXITERS if we gave up without converging */
+  return (iter < MAXITERS) ? iter + 1 : MAXITERS;
+}
+
+/*
+** Read up to MAXCASES lines of boundary values from a file,
+** skipping blank lines and lines starting with '#'.
+** Returns the number of cases read.
+*/
+int read_cases(const char* filename, double* cases)
+{
+  FILE* fp;
+  char line[256];
+  int ncases = 0;
+
+  fp = fopen(filename, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Error: could not open cases file '%s'\n", filename);
+    return 0;
+  }
+
+  while (ncases < MAXCASES && fgets(line, sizeof(line), fp) != NULL) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    if (sscanf(line, "%lf %lf %lf %lf",
+               &cases[ncases * NBCS + TOP], &cases[ncases * NBCS + BOTTOM],
+               &cases[ncases * NBCS + LEFT], &cases[ncases * NBCS + RIGHT]) != NBCS) {
+      fprintf(stderr, "Error: expected %d values per line in '%s'\n", NBCS, filename);
+      fclose(fp);
+      return 0;
+    }
+    ncases++;
+  }
+
+  fclose(fp);
+  return ncases;
+}
+
+/*
+** A default sweep which varies the temperature of the top edge
+** and, for the second half of the cases, of the left edge too.
+*/
+int default_cases(double* cases)
+{
+  int icase;
+
+  for (icase = 0; icase < NDEFAULTCASES; icase++) {
+    cases[icase * NBCS + TOP] = 100.0 * (icase % (NDEFAULTCASES / 2)) / (NDEFAULTCASES / 2);
+    cases[icase * NBCS + BOTTOM] = 100.0;
+    cases[icase * NBCS + LEFT] = (icase < NDEFAULTCASES / 2) ? 100.0 : 0.0;
+    cases[icase * NBCS + RIGHT] = 100.0;
+  }
+
+  return NDEFAULTCASES;
+}
+
+int calc_ncols_from_rank(int rank, int size)
+{
+  int ncols;
+
+  ncols = NCOLS / size;       /* integer division */
+  if ((NCOLS % size) != 0) {  /* if there is a remainder */
+    if (rank == size - 1)
+      ncols += NCOLS % size;  /* add remainder to last rank */
+  }
+
+  return ncols;
+}
@@ -0,0 +1,397 @@
+/*
+** The heated plate from mpi/example5/skeleton2-heated-plate.c, solved
+** with the implicit Alternating Direction Implicit (ADI) method of
+** Peaceman and Rachford.
+**
+** Boundary conditions for the full grid are, as before:
+**
+**                      W = 0
+**             +--------------------+
+**             |                    |
+**    W = 100  |                    | W = 100
+**             |                    |
+**             +--------------------+
+**                     W = 100
+**
+** Each timestep is split into two half-steps:
+**
+**   (I - r/2 Dxx) u* = (I + r/2 Dyy) u(n)      -- implicit along rows
+**   (I - r/2 Dyy) u(n+1) = (I + r/2 Dxx) u*    -- implicit along columns
+**
+** where r = alpha * dt / h^2 and Dxx, Dyy are the usual second difference
+** operators.  Each implicit half-step is a set of independent tridiagonal
+** systems, one per row or one per column.  Unlike the explicit scheme,
+** which is only stable for r <= 1/4, ADI is stable for any r, so we can
+** take much larger timesteps.
+**
+** A tridiagonal solve needs all of the unknowns in a row (or column) on
+** one rank.  So, rather than exchanging halos, we keep two layouts:
+**
+**   column strips (as in skeleton2)      row strips
+**
+**   +-----|-----|-----|-----+            +-----------------------+
+**   |     |     |     |     |            |           0           |
+**   |  0  |  1  |  2  |  3  |    <-->    +-----------------------+
+**   |     |     |     |     |            |           1           |
+**   |     |     |     |     |            +-----------------------+
+**   +-----|-----|-----|-----+                       ...
+**
+** and redistribute (transpose) the grid between them twice per step,
+** using a single call to MPI_Alltoallw() with subarray datatypes.
+** Note that the explicit parts of each half-step only need neighbours
+** along the direction which is local, so no halo exchange is needed at all.
+**
+** Usage: adi_heated_plate.exe [nrows ncols [r]]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mpi.h"
+
+#define NROWS 64
+#define NCOLS 64
+#define R 10.0             /* alpha * dt / h^2; the explicit scheme needs r <= 0.25 */
+#define EPSILON 0.01       /* convergence threshold on the largest change in a step */
+#define MAXITERS 10000
+#define MASTER 0
+
+/* function prototypes */
+int calc_nitems_from_rank(int rank, int size, int nitems);
+int calc_start_from_rank(int rank, int size, int nitems);
+void thomas_coefficients(int n, double r, double* cp, double* inv);
+
+int main(int argc, char* argv[])
+{
+  int ii, jj;            /* row and column indices for the grid */
+  int gi, gj;            /* global row and column indices */
+  int kk;                /* index for looping over ranks */
+  int iter;              /* index for timestep iterations */
+  int rank;              /* the rank of this process */
+  int size;              /* number of processes in the communicator */
+  int nrows, ncols;      /* size of the full grid, including boundaries */
+  int local_nrows;       /* number of rows apportioned to this rank (row layout) */
+  int local_ncols;       /* number of columns apportioned to this rank (column layout) */
+  int start_row;         /* first global row held by this rank (row layout) */
+  int start_col;         /* first global column held by this rank (column layout) */
+  int sizes[2], subsizes[2], starts[2];  /* arguments to MPI_Type_create_subarray() */
+  int* counts;           /* one element of each datatype is sent to each rank */
+  int* displs;           /* all displacements are folded into the datatypes */
+  double r = R;          /* dimensionless timestep */
+  double boundary_mean;  /* mean of boundary values used to initialise inner cells */
+  double diff;           /* largest local change in a step */
+  double maxdiff;        /* largest change over all ranks in a step */
+  double xnew;           /* new value of a cell */
+  double sum, mean;      /* sum and mean of the temperatures over the plate */
+  double tic, toc;       /* timestamps */
+  double t_transpose = 0.0;  /* time spent redistributing the grid */
+  double t_solve = 0.0;      /* time spent in stencils and tridiagonal solves */
+  double times[2];       /* the two times above, reduced over ranks */
+  double* ucol;          /* solution, in the column layout */
+  double* rcol;          /* right-hand side and workspace, in the column layout */
+  double* urow;          /* intermediate solution, in the row layout */
+  double* rrow;          /* right-hand side and workspace, in the row layout */
+  double* cpx, *invx;    /* Thomas algorithm coefficients along rows */
+  double* cpy, *invy;    /* Thomas algorithm coefficients along columns */
+  MPI_Datatype* coltypes;  /* part of the column layout going to/from each rank */
+  MPI_Datatype* rowtypes;  /* part of the row layout going to/from each rank */
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  nrows = NROWS;
+  ncols = NCOLS;
+  if (argc > 2) {
+    nrows = atoi(argv[1]);
+    ncols = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    r = atof(argv[3]);
+  }
+  if (nrows < 3 || ncols < 3 || r <= 0.0) {
+    if (rank == MASTER)
+      fprintf(stderr, "Error: need nrows, ncols >= 3 and r > 0\n");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  /*
+  ** each rank holds a strip of columns (column layout) and a strip
+  ** of rows (row layout), each with any remainder on the last rank
+  */
+  local_ncols = calc_nitems_from_rank(rank, size, ncols);
+  local_nrows = calc_nitems_from_rank(rank, size, nrows);
+  start_col = calc_start_from_rank(rank, size, ncols);
+  start_row = calc_start_from_rank(rank, size, nrows);
+  if (local_ncols < 1 || local_nrows < 1) {
+    fprintf(stderr, "Error: too many processes:- local_ncols or local_nrows < 1\n");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  ucol = (double*)malloc(sizeof(double) * nrows * local_ncols);
+  rcol = (double*)malloc(sizeof(double) * nrows * local_ncols);
+  urow = (double*)malloc(sizeof(double) * local_nrows * ncols);
+  rrow = (double*)malloc(sizeof(double) * local_nrows * ncols);
+  cpx = (double*)malloc(sizeof(double) * ncols);
+  invx = (double*)malloc(sizeof(double) * ncols);
+  cpy = (double*)malloc(sizeof(double) * nrows);
+  invy = (double*)malloc(sizeof(double) * nrows);
+
+  /*
+  ** Build the datatypes used by MPI_Alltoallw().
+  ** In the column layout (nrows x local_ncols), rank kk needs the rows
+  ** that it holds in the row layout.  In the row layout (local_nrows x ncols),
+  ** we receive from rank kk the columns that it holds in the column layout.
+  ** Both are just rectangular subarrays of a row-major array.
+  */
+  coltypes = (MPI_Datatype*)malloc(sizeof(MPI_Datatype) * size);
+  rowtypes = (MPI_Datatype*)malloc(sizeof(MPI_Datatype) * size);
+  counts = (int*)malloc(sizeof(int) * size);
+  displs = (int*)malloc(sizeof(int) * size);
+  for (kk = 0; kk < size; kk++) {
+    sizes[0] = nrows;
+    sizes[1] = local_ncols;
+    subsizes[0] = calc_nitems_from_rank(kk, size, nrows);
+    subsizes[1] = local_ncols;
+    starts[0] = calc_start_from_rank(kk, size, nrows);
+    starts[1] = 0;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &coltypes[kk]);
+    MPI_Type_commit(&coltypes[kk]);
+
+    sizes[0] = local_nrows;
+    sizes[1] = ncols;
+    subsizes[0] = local_nrows;
+    subsizes[1] = calc_nitems_from_rank(kk, size, ncols);
+    starts[0] = 0;
+    starts[1] = calc_start_from_rank(kk, size, ncols);
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &rowtypes[kk]);
+    MPI_Type_commit(&rowtypes[kk]);
+
+    counts[kk] = 1;
+    displs[kk] = 0;
+  }
+
+  /*
+  ** The tridiagonal systems all have the same constant coefficients,
+  ** so the modified coefficients of the Thomas algorithm can be
+  ** computed once, up front, for each direction.
+  */
+  thomas_coefficients(ncols - 2, r, cpx, invx);
+  thomas_coefficients(nrows - 2, r, cpy, invy);
+
+  /*
+  ** initialise the solution in the column layout:
+  ** boundary conditions as in skeleton2-heated-plate.c,
+  ** inner cells at the mean of the boundary values
+  */
+  boundary_mean = ((nrows - 2) * 100.0 * 2 + (ncols - 2) * 100.0) / (double)((2 * nrows) + (2 * ncols) - 4);
+  for (ii = 0; ii < nrows; ii++) {
+    for (jj = 0; jj < local_ncols; jj++) {
+      gj = start_col + jj;
+      if (ii == 0)
+        ucol[ii * local_ncols + jj] = 0.0;
+      else if (ii == nrows - 1 || gj == 0 || gj == ncols - 1)
+        ucol[ii * local_ncols + jj] = 100.0;
+      else
+        ucol[ii * local_ncols + jj] = boundary_mean;
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = MPI_Wtime();
+
+  for (iter = 0; iter < MAXITERS; iter++) {
+    /*
+    ** first half-step, explicit part: rcol = (I + r/2 Dyy) ucol.
+    ** whole columns are local, so no communication is needed.
+    ** boundary cells are simply carried through.
+    */
+    toc = MPI_Wtime();
+    memcpy(rcol, ucol, sizeof(double) * nrows * local_ncols);
+    for (ii = 1; ii < nrows - 1; ii++) {
+      for (jj = 0; jj < local_ncols; jj++) {
+        gj = start_col + jj;
+        if (gj == 0 || gj == ncols - 1) continue;
+        rcol[ii * local_ncols + jj] = (1.0 - r) * ucol[ii * local_ncols + jj]
+          + 0.5 * r * (ucol[(ii - 1) * local_ncols + jj] + ucol[(ii + 1) * local_ncols + jj]);
+      }
+    }
+    t_solve += MPI_Wtime() - toc;
+
+    /* column strips -> row strips */
+    toc = MPI_Wtime();
+    MPI_Alltoallw(rcol, counts, displs, coltypes,
+                  rrow, counts, displs, rowtypes, MPI_COMM_WORLD);
+    t_transpose += MPI_Wtime() - toc;
+
+    /*
+    ** first half-step, implicit part: solve (I - r/2 Dxx) urow = rrow
+    ** along each (local) row, with the boundary values on the right-hand side
+    */
+    toc = MPI_Wtime();
+    for (ii = 0; ii < local_nrows; ii++) {
+      double* d = &rrow[ii * ncols];
+      double* x = &urow[ii * ncols];
+      gi = start_row + ii;
+      x[0] = d[0];
+      x[ncols - 1] = d[ncols - 1];
+      if (gi == 0 || gi == nrows - 1) {
+        for (jj = 1; jj < ncols - 1; jj++) x[jj] = d[jj];
+        continue;
+      }
+      d[1] += 0.5 * r * d[0];
+      d[ncols - 2] += 0.5 * r * d[ncols - 1];
+      /* forward sweep, in place */
+      d[1] *= invx[0];
+      for (jj = 2; jj < ncols - 1; jj++)
+        d[jj] = (d[jj] + 0.5 * r * d[jj - 1]) * invx[jj - 1];
+      /* back substitution */
+      x[ncols - 2] = d[ncols - 2];
+      for (jj = ncols - 3; jj > 0; jj--)
+        x[jj] = d[jj] - cpx[jj - 1] * x[jj + 1];
+    }
+
+    /*
+    ** second half-step, explicit part: rrow = (I + r/2 Dxx) urow.
+    ** whole rows are local now.
+    */
+    memcpy(rrow, urow, sizeof(double) * local_nrows * ncols);
+    for (ii = 0; ii < local_nrows; ii++) {
+      gi = start_row + ii;
+      if (gi == 0 || gi == nrows - 1) continue;
+      for (jj = 1; jj < ncols - 1; jj++) {
+        rrow[ii * ncols + jj] = (1.0 - r) * urow[ii * ncols + jj]
+          + 0.5 * r * (urow[ii * ncols + jj - 1] + urow[ii * ncols + jj + 1]);
+      }
+    }
+    t_solve += MPI_Wtime() - toc;
+
+    /* row strips -> column strips */
+    toc = MPI_Wtime();
+    MPI_Alltoallw(rrow, counts, displs, rowtypes,
+                  rcol, counts, displs, coltypes, MPI_COMM_WORLD);
+    t_transpose += MPI_Wtime() - toc;
+
+    /*
+    ** second half-step, implicit part: solve (I - r/2 Dyy) ucol = rcol
+    ** along each column.  We sweep over all of the local columns at
+    ** once, row by row, so that the inner loop runs along contiguous
+    ** memory and can be vectorised.
+    */
+    toc = MPI_Wtime();
+    diff = 0.0;
+    for (jj = 0; jj < local_ncols; jj++) {
+      rcol[1 * local_ncols + jj] += 0.5 * r * ucol[jj];
+      rcol[(nrows - 2) * local_ncols + jj] += 0.5 * r * ucol[(nrows - 1) * local_ncols + jj];
+      rcol[1 * local_ncols + jj] *= invy[0];
+    }
+    for (ii = 2; ii < nrows - 1; ii++) {
+      for (jj = 0; jj < local_ncols; jj++) {
+        rcol[ii * local_ncols + jj] = (rcol[ii * local_ncols + jj]
+          + 0.5 * r * rcol[(ii - 1) * local_ncols + jj]) * invy[ii - 1];
+      }
+    }
+    for (ii = nrows - 2; ii > 0; ii--) {
+      for (jj = 0; jj < local_ncols; jj++) {
+        gj = start_col + jj;
+        if (gj == 0 || gj == ncols - 1) continue;
+        xnew = rcol[ii * local_ncols + jj];
+        if (ii < nrows - 2)
+          xnew -= cpy[ii - 1] * ucol[(ii + 1) * local_ncols + jj];
+        diff = fmax(diff, fabs(xnew - ucol[ii * local_ncols + jj]));
+        ucol[ii * local_ncols + jj] = xnew;
+      }
+    }
+    t_solve += MPI_Wtime() - toc;
+
+    MPI_Allreduce(&diff, &maxdiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    if (maxdiff < EPSILON) break;
+  }
+
+  toc = MPI_Wtime();
+
+  /* summarise the solution and the time spent in each phase */
+  sum = 0.0;
+  for (ii = 0; ii < nrows * local_ncols; ii++)
+    sum += ucol[ii];
+  MPI_Reduce(&sum, &mean, 1, MPI_DOUBLE, MPI_SUM, MASTER, MPI_COMM_WORLD);
+  times[0] = t_transpose;
+  times[1] = t_solve;
+  if (rank == MASTER)
+    MPI_Reduce(MPI_IN_PLACE, times, 2, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+  else
+    MPI_Reduce(times, NULL, 2, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+
+  if (rank == MASTER) {
+    mean /= (double)(nrows * ncols);
+    printf("NROWS: %d\nNCOLS: %d\n", nrows, ncols);
+    printf("r = alpha*dt/h^2: %f (explicit limit is 0.25)\n", r);
+    printf("steps taken: %d (last change %g)\n", iter + 1, maxdiff);
+    printf("mean temperature: %f\n", mean);
+    printf("total time:     %f s\n", toc - tic);
+    printf("transpose time: %f s\n", times[0]);
+    printf("solve time:     %f s\n", times[1]);
+  }
+
+  for (kk = 0; kk < size; kk++) {
+    MPI_Type_free(&coltypes[kk]);
+    MPI_Type_free(&rowtypes[kk]);
+  }
+
+  /* don't forget to tidy up when we're done */
+  MPI_Finalize();
+
+  free(ucol);
+  free(rcol);
+  free(urow);
+  free(rrow);
+  free(cpx);
+  free(invx);
+  free(cpy);
+  free(invy);
+  free(coltypes);
+  free(rowtypes);
+  free(counts);
+  free(displs);
+
+  return EXIT_SUCCESS;
+}
+
+/*
+** Precompute the Thomas algorithm coefficients for the n x n system
+** with -r/2 on the off-diagonals and (1 + r) on the diagonal.
+** The forward sweep is then d[i] = (d[i] + r/2 d[i-1]) * inv[i]
+** and the back substitution x[i] = d[i] - cp[i] * x[i+1].
+*/
+void thomas_coefficients(int n, double r, double* cp, double* inv)
+{
+  int ii;
+  double a = -0.5 * r;   /* sub- and super-diagonal */
+  double b = 1.0 + r;    /* diagonal */
+
+  inv[0] = 1.0 / b;
+  cp[0] = a * inv[0];
+  for (ii = 1; ii < n; ii++) {
+    inv[ii] = 1.0 / (b - a * cp[ii - 1]);
+    cp[ii] = a * inv[ii];
+  }
+}
+
+int calc_nitems_from_rank(int rank, int size, int nitems)
+{
+  int n;
+
+  n = nitems / size;       /* integer division */
+  if ((nitems % size) != 0) {  /* if there is a remainder */
+    if (rank == size - 1)
+      n += nitems % size;  /* add remainder to last rank */
+  }
+
+  return n;
+}
+
+int calc_start_from_rank(int rank, int size, int nitems)
+{
+  return rank * (nitems / size);
+}
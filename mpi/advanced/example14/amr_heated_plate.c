@@ -0,0 +1,775 @@
+/*
+** Block-structured adaptive mesh refinement (AMR) for the heated plate
+** from mpi/example5/skeleton2-heated-plate.c.
+**
+** Boundary conditions for the (unit square) plate are, as before:
+**
+**                      W = 0
+**             +--------------------+
+**             |                    |
+**    W = 100  |                    | W = 100
+**             |                    |
+**             +--------------------+
+**                     W = 100
+**
+** The solution is smooth over most of the plate, but has very steep
+** gradients along the 0 degree edge, and especially in its corners.
+** A uniform grid fine enough for the corners wastes most of its cells
+** on the flat interior.
+**
+** Instead, the plate is covered by square blocks of BS x BS cells.
+** Any block where the temperature gradient exceeds a threshold is
+** replaced by four blocks, each covering a quarter of the area, at twice
+** the resolution:
+**
+**   +-----------+-----+-----+
+**   |           |     |  |  |
+**   |           |     |--+--|
+**   |           +-----+-----+
+**   |           |     |     |
+**   |           |     |     |
+**   +-----------+-----+-----+
+**
+** The blocks are kept "2:1 balanced", i.e. blocks sharing an edge differ
+** by at most one level of refinement.  Each block has a layer of ghost
+** cells which are filled from its neighbours:
+**
+** - from a block at the same level, the values are copied,
+** - from a coarser block, the values are interpolated, and
+** - from a finer block, the values are averaged.
+**
+** Every rank holds a copy of the list of blocks (but not their data).
+** The blocks are ordered along a Morton (Z-order) space-filling curve
+** and the curve is cut into equal pieces, one per rank.  Blocks which are
+** close together on the plate are then likely to be on the same rank.
+** Ghost cell data for blocks on other ranks is exchanged with a single
+** call to MPI_Alltoallv() per iteration.
+**
+** The steady state is found by Jacobi iteration, refining the mesh one
+** level at a time, and the result is compared with the exact solution.
+**
+** Usage: amr_heated_plate.exe [maxlevel [threshold]]
+**
+** A threshold of 0 refines every block, i.e. gives a uniform fine grid.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mpi.h"
+
+#define NBASE 4            /* blocks along each side of the plate at level 0 */
+#define BS 8               /* cells along each side of a block */
+#define NX (BS + 2)        /* row length of a block, including ghost cells */
+#define MAXLEVEL 6         /* largest supported refinement level */
+#define DEFAULT_MAXLEVEL 3
+#define THRESHOLD 150.0    /* refine blocks with a gradient above this */
+#define EPSILON 1.0e-6     /* convergence threshold on the largest change in a step */
+#define MAXITERS 1000000
+#define MASTER 0
+
+/* the four sides of a block */
+#define WEST 0
+#define EAST 1
+#define SOUTH 2
+#define NORTH 3
+
+/* the kinds of neighbour a block can have across a side */
+#define BOUNDARY 0
+#define SAME 1
+#define COARSER 2
+#define FINER 3
+
+typedef struct {
+  int level;             /* refinement level, 0 is the coarsest */
+  int ix, iy;            /* position of the block in units of its own size */
+  int owner;             /* rank holding the block's data */
+  int src;               /* during regridding, the block this one came from */
+  unsigned long key;     /* position along the space-filling curve */
+} block_t;
+
+typedef struct {
+  int nblocks;           /* number of blocks covering the plate */
+  block_t* blocks;       /* the blocks, in space-filling curve order */
+  int* lookup[MAXLEVEL + 1];  /* block index at each (level, ix, iy), or -1 */
+  int nlocal;            /* number of blocks held by this rank */
+  int first;             /* index of the first block held by this rank */
+  double* u;             /* cell values for local blocks, nlocal * NX * NX */
+  double* unew;          /* workspace for the update */
+  double* faces;         /* edge cells of local blocks, nlocal * 4 * BS */
+  double* remote;        /* edge cells of neighbouring blocks on other ranks */
+  int* remote_slot;      /* index of each block in remote, or -1 */
+  double* sendbuf;       /* buffer to hold values to send */
+  int* sendlist;         /* local blocks to send, grouped by destination */
+  int nsend;             /* length of sendlist */
+  int* sendcounts;       /* arguments to MPI_Alltoallv() */
+  int* senddispls;
+  int* recvcounts;
+  int* recvdispls;
+} mesh_t;
+
+/* function prototypes */
+void build_lookup(mesh_t* mesh);
+void build_exchange(mesh_t* mesh, int rank, int size);
+int find_neighbours(const mesh_t* mesh, int b, int side, int* nbr);
+void exchange_and_fill(mesh_t* mesh, int rank);
+double iterate(mesh_t* mesh, int rank, int* iters);
+void regrid(mesh_t* mesh, int maxlevel, double threshold, int rank, int size);
+unsigned long morton_key(int level, int ix, int iy);
+int compare_blocks(const void* a, const void* b);
+double exact(double x, double y);
+
+int main(int argc, char* argv[])
+{
+  int ii, jj;            /* cell indices within a block */
+  int b, s;              /* block indices */
+  int level;             /* refinement level */
+  int rank;              /* the rank of this process */
+  int size;              /* number of processes in the communicator */
+  int maxlevel;          /* number of levels of refinement to allow */
+  int iters;             /* Jacobi iterations for one level */
+  int total_iters = 0;   /* Jacobi iterations over all levels */
+  int count[MAXLEVEL + 1];  /* number of blocks at each level */
+  int minlocal, maxlocal;   /* fewest and most blocks held by one rank */
+  double threshold;      /* gradient above which blocks are refined */
+  double h;              /* cell width for a block */
+  double x, y;           /* cell centre */
+  double err;            /* error in a cell */
+  double local_err[3];   /* L1 error, L1 error near the 0 degree edge, max error */
+  double errs[3];        /* as above, reduced over ranks */
+  double maxdiff;        /* largest change in the last iteration */
+  double tic, toc;       /* timestamps */
+  long ncells;           /* total number of cells */
+  long nuniform;         /* cells in a uniform grid at the finest level */
+  block_t* blk;
+  mesh_t mesh;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  maxlevel = (argc > 1) ? atoi(argv[1]) : DEFAULT_MAXLEVEL;
+  threshold = (argc > 2) ? atof(argv[2]) : THRESHOLD;
+  if (maxlevel < 0 || maxlevel > MAXLEVEL) {
+    if (rank == MASTER)
+      fprintf(stderr, "Error: maxlevel must be between 0 and %d\n", MAXLEVEL);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  /*
+  ** start with a uniform grid of NBASE x NBASE blocks at level 0,
+  ** using regrid() with no refinement to order and distribute them
+  */
+  memset(&mesh, 0, sizeof(mesh));
+  mesh.nblocks = NBASE * NBASE;
+  mesh.blocks = (block_t*)malloc(sizeof(block_t) * mesh.nblocks);
+  for (b = 0; b < mesh.nblocks; b++) {
+    mesh.blocks[b].level = 0;
+    mesh.blocks[b].ix = b % NBASE;
+    mesh.blocks[b].iy = b / NBASE;
+    mesh.blocks[b].owner = MASTER;
+  }
+  mesh.nlocal = (rank == MASTER) ? mesh.nblocks : 0;
+  mesh.first = 0;
+  mesh.u = (double*)malloc(sizeof(double) * (mesh.nlocal + 1) * NX * NX);
+  for (ii = 0; ii < mesh.nlocal * NX * NX; ii++)
+    mesh.u[ii] = 75.0;   /* the mean of the boundary values */
+  for (level = 0; level <= MAXLEVEL; level++)
+    mesh.lookup[level] = NULL;
+  build_lookup(&mesh);
+  build_exchange(&mesh, rank, size);
+  regrid(&mesh, 0, threshold, rank, size);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = MPI_Wtime();
+
+  /*
+  ** solve on the current mesh, then refine where needed and solve again.
+  ** each solve starts from the previous, coarser, solution.
+  */
+  for (level = 0; level <= maxlevel; level++) {
+    if (level > 0)
+      regrid(&mesh, level, threshold, rank, size);
+    maxdiff = iterate(&mesh, rank, &iters);
+    total_iters += iters;
+    if (rank == MASTER)
+      printf("level %d: %d blocks, %d iterations (last change %g)\n",
+             level, mesh.nblocks, iters, maxdiff);
+  }
+
+  toc = MPI_Wtime();
+
+  /* compare with the exact solution, weighting each cell by its area */
+  local_err[0] = local_err[1] = local_err[2] = 0.0;
+  for (s = 0; s < mesh.nlocal; s++) {
+    blk = &mesh.blocks[mesh.first + s];
+    h = 1.0 / (double)(NBASE * BS << blk->level);
+    for (jj = 1; jj <= BS; jj++) {
+      for (ii = 1; ii <= BS; ii++) {
+        x = (blk->ix * BS + ii - 0.5) * h;
+        y = (blk->iy * BS + jj - 0.5) * h;
+        err = fabs(mesh.u[s * NX * NX + jj * NX + ii] - exact(x, y));
+        local_err[0] += err * h * h;
+        if (y > 0.75) local_err[1] += err * h * h;
+        local_err[2] = fmax(local_err[2], err);
+      }
+    }
+  }
+  MPI_Reduce(local_err, errs, 2, MPI_DOUBLE, MPI_SUM, MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(&local_err[2], &errs[2], 1, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(&mesh.nlocal, &minlocal, 1, MPI_INT, MPI_MIN, MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(&mesh.nlocal, &maxlocal, 1, MPI_INT, MPI_MAX, MASTER, MPI_COMM_WORLD);
+
+  if (rank == MASTER) {
+    for (level = 0; level <= MAXLEVEL; level++)
+      count[level] = 0;
+    for (b = 0; b < mesh.nblocks; b++)
+      count[mesh.blocks[b].level]++;
+    ncells = (long)mesh.nblocks * BS * BS;
+    nuniform = (long)(NBASE * BS << maxlevel) * (NBASE * BS << maxlevel);
+
+    printf("\n");
+    for (level = 0; level <= maxlevel; level++)
+      printf("blocks at level %d: %d\n", level, count[level]);
+    printf("blocks per rank:   %d to %d\n", minlocal, maxlocal);
+    printf("total cells:       %ld (uniform grid at level %d: %ld)\n", ncells, maxlevel, nuniform);
+    printf("total iterations:  %d\n", total_iters);
+    printf("L1 error:          %g\n", errs[0]);
+    printf("L1 error, y > 3/4: %g\n", errs[1]);
+    printf("max error:         %g\n", errs[2]);
+    printf("time:              %f s\n", toc - tic);
+  }
+
+  MPI_Finalize();
+
+  for (level = 0; level <= MAXLEVEL; level++)
+    free(mesh.lookup[level]);
+  free(mesh.blocks);
+  free(mesh.u);
+  free(mesh.unew);
+  free(mesh.faces);
+  free(mesh.remote);
+  free(mesh.remote_slot);
+  free(mesh.sendbuf);
+  free(mesh.sendlist);
+  free(mesh.sendcounts);
+  free(mesh.senddispls);
+  free(mesh.recvcounts);
+  free(mesh.recvdispls);
+
+  return EXIT_SUCCESS;
+}
+
+/*
+** Jacobi iteration on the composite mesh until the largest change in
+** any cell falls below EPSILON.  Each block uses the largest stable
+** pseudo-timestep for its own cell size, which is fine as we only
+** want the steady state.
+*/
+double iterate(mesh_t* mesh, int rank, int* iters)
+{
+  int s, ii, jj, c;
+  int iter;
+  double diff, maxdiff = 0.0;
+  double* u;
+  double* unew;
+  double* tmp;
+
+  for (iter = 0; iter < MAXITERS; iter++) {
+    exchange_and_fill(mesh, rank);
+
+    diff = 0.0;
+    for (s = 0; s < mesh->nlocal; s++) {
+      u = &mesh->u[s * NX * NX];
+      unew = &mesh->unew[s * NX * NX];
+      for (jj = 1; jj <= BS; jj++) {
+        for (ii = 1; ii <= BS; ii++) {
+          c = jj * NX + ii;
+          unew[c] = u[c] + 0.2 * (u[c - 1] + u[c + 1] + u[c - NX] + u[c + NX] - 4.0 * u[c]);
+          diff = fmax(diff, fabs(unew[c] - u[c]));
+        }
+      }
+    }
+    tmp = mesh->u;
+    mesh->u = mesh->unew;
+    mesh->unew = tmp;
+
+    MPI_Allreduce(&diff, &maxdiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    if (maxdiff < EPSILON) break;
+  }
+
+  *iters = iter + 1;
+  return maxdiff;
+}
+
+/*
+** Find the neighbour(s) of block b across a side.
+** Returns the kind of neighbour; nbr[0] (and nbr[1] for FINER) is set
+** to the index of the neighbouring block(s), ordered along the side.
+*/
+int find_neighbours(const mesh_t* mesh, int b, int side, int* nbr)
+{
+  const block_t* blk = &mesh->blocks[b];
+  int level = blk->level;
+  int n = NBASE << level;
+  int x = blk->ix + ((side == EAST) ? 1 : (side == WEST) ? -1 : 0);
+  int y = blk->iy + ((side == NORTH) ? 1 : (side == SOUTH) ? -1 : 0);
+  int c;
+
+  if (x < 0 || x >= n || y < 0 || y >= n)
+    return BOUNDARY;
+
+  if (mesh->lookup[level][y * n + x] >= 0) {
+    nbr[0] = mesh->lookup[level][y * n + x];
+    return SAME;
+  }
+
+  if (level > 0 && mesh->lookup[level - 1][(y / 2) * (n / 2) + (x / 2)] >= 0) {
+    nbr[0] = mesh->lookup[level - 1][(y / 2) * (n / 2) + (x / 2)];
+    return COARSER;
+  }
+
+  /* the two children of (x,y) touching this block */
+  for (c = 0; c < 2; c++) {
+    if (side == WEST)
+      nbr[c] = mesh->lookup[level + 1][(2 * y + c) * (2 * n) + 2 * x + 1];
+    else if (side == EAST)
+      nbr[c] = mesh->lookup[level + 1][(2 * y + c) * (2 * n) + 2 * x];
+    else if (side == SOUTH)
+      nbr[c] = mesh->lookup[level + 1][(2 * y + 1) * (2 * n) + 2 * x + c];
+    else
+      nbr[c] = mesh->lookup[level + 1][(2 * y) * (2 * n) + 2 * x + c];
+  }
+  return FINER;
+}
+
+/* the ghost cell, and the inner cell next to it, at position t along a side */
+static int ghost_index(int side, int t)
+{
+  if (side == WEST) return (t + 1) * NX;
+  if (side == EAST) return (t + 1) * NX + BS + 1;
+  if (side == SOUTH) return t + 1;
+  return (BS + 1) * NX + t + 1;
+}
+
+static int inner_index(int side, int t)
+{
+  if (side == WEST) return (t + 1) * NX + 1;
+  if (side == EAST) return (t + 1) * NX + BS;
+  if (side == SOUTH) return NX + t + 1;
+  return BS * NX + t + 1;
+}
+
+/* the edge cells of a block along a side, wherever the block is held */
+static const double* face(const mesh_t* mesh, int rank, int b, int side)
+{
+  if (mesh->blocks[b].owner == rank)
+    return &mesh->faces[((b - mesh->first) * 4 + side) * BS];
+  return &mesh->remote[(mesh->remote_slot[b] * 4 + side) * BS];
+}
+
+/*
+** Exchange the edge cells of blocks with neighbours on other ranks,
+** then fill the ghost cells of every local block.
+*/
+void exchange_and_fill(mesh_t* mesh, int rank)
+{
+  int s, b, side, t, k, c, kind;
+  int nbr[2];
+  int opposite[4] = { EAST, WEST, NORTH, SOUTH };
+  const int half = BS / 2;
+  const double* f;
+  double* u;
+  double slope, uc, uf, bc;
+
+  /* copy out the edge cells of each local block */
+  for (s = 0; s < mesh->nlocal; s++) {
+    u = &mesh->u[s * NX * NX];
+    for (side = 0; side < 4; side++)
+      for (t = 0; t < BS; t++)
+        mesh->faces[(s * 4 + side) * BS + t] = u[inner_index(side, t)];
+  }
+
+  /* send them to any rank holding a neighbouring block */
+  for (k = 0; k < mesh->nsend; k++)
+    memcpy(&mesh->sendbuf[k * 4 * BS], &mesh->faces[mesh->sendlist[k] * 4 * BS],
+           sizeof(double) * 4 * BS);
+  MPI_Alltoallv(mesh->sendbuf, mesh->sendcounts, mesh->senddispls, MPI_DOUBLE,
+                mesh->remote, mesh->recvcounts, mesh->recvdispls, MPI_DOUBLE,
+                MPI_COMM_WORLD);
+
+  /* fill the ghost cells */
+  for (s = 0; s < mesh->nlocal; s++) {
+    b = mesh->first + s;
+    u = &mesh->u[s * NX * NX];
+    for (side = 0; side < 4; side++) {
+      kind = find_neighbours(mesh, b, side, nbr);
+      for (t = 0; t < BS; t++) {
+        if (kind == BOUNDARY) {
+          /* the boundary lies half way between the ghost and inner cells */
+          bc = (side == NORTH) ? 0.0 : 100.0;
+          u[ghost_index(side, t)] = 2.0 * bc - u[inner_index(side, t)];
+        }
+        else if (kind == SAME) {
+          f = face(mesh, rank, nbr[0], opposite[side]);
+          u[ghost_index(side, t)] = f[t];
+        }
+        else if (kind == COARSER) {
+          /*
+          ** interpolate along the coarse edge, then between the coarse
+          ** cell centre (1.5 fine cells away) and our inner cell
+          */
+          f = face(mesh, rank, nbr[0], opposite[side]);
+          k = (((side == WEST || side == EAST) ? mesh->blocks[b].iy : mesh->blocks[b].ix) % 2) * half + t / 2;
+          if (k == 0)
+            slope = f[1] - f[0];
+          else if (k == BS - 1)
+            slope = f[BS - 1] - f[BS - 2];
+          else
+            slope = 0.5 * (f[k + 1] - f[k - 1]);
+          uc = f[k] + ((t % 2) ? 0.25 : -0.25) * slope;
+          u[ghost_index(side, t)] = (u[inner_index(side, t)] + 2.0 * uc) / 3.0;
+        }
+        else {
+          /*
+          ** average the two fine cells next to the ghost cell, then
+          ** extrapolate from our inner cell through that value
+          */
+          c = t / half;
+          f = face(mesh, rank, nbr[c], opposite[side]);
+          uf = 0.5 * (f[2 * (t - c * half)] + f[2 * (t - c * half) + 1]);
+          u[ghost_index(side, t)] = (4.0 * uf - u[inner_index(side, t)]) / 3.0;
+        }
+      }
+    }
+  }
+}
+
+/*
+** Refine blocks at the given level whose gradient exceeds the threshold
+** (and any coarser neighbours needed to keep the mesh 2:1 balanced), then
+** re-order the blocks along the space-filling curve and move their data
+** to the new owners.
+*/
+void regrid(mesh_t* mesh, int level, double threshold, int rank, int size)
+{
+  int s, b, side, ii, jj, kk, nn, c, src;
+  int changed;
+  int nbr[2];
+  int nnew;              /* number of blocks after refinement */
+  int nnew_local;        /* number of those held by this rank */
+  int new_first;         /* index of the first of those */
+  int* local_flags;      /* blocks found by this rank to need refinement */
+  int* flags;            /* all blocks needing refinement */
+  int* scounts, *sdispls, *rcounts, *rdispls;
+  double grad, h;
+  double* u;
+  double* out;
+  double* sendbuf;
+  double* newu;
+  block_t* newblocks;
+  block_t* blk;
+
+  local_flags = (int*)calloc(mesh->nblocks, sizeof(int));
+  flags = (int*)calloc(mesh->nblocks, sizeof(int));
+
+  /* flag blocks at the previous level where the gradient is too steep */
+  if (level > 0) {
+    exchange_and_fill(mesh, rank);
+    for (s = 0; s < mesh->nlocal; s++) {
+      blk = &mesh->blocks[mesh->first + s];
+      if (blk->level != level - 1) continue;
+      u = &mesh->u[s * NX * NX];
+      h = 1.0 / (double)(NBASE * BS << blk->level);
+      grad = 0.0;
+      for (jj = 1; jj <= BS; jj++) {
+        for (ii = 1; ii <= BS; ii++) {
+          c = jj * NX + ii;
+          grad = fmax(grad, sqrt((u[c + 1] - u[c - 1]) * (u[c + 1] - u[c - 1]) +
+                                 (u[c + NX] - u[c - NX]) * (u[c + NX] - u[c - NX])) / (2.0 * h));
+        }
+      }
+      if (grad > threshold)
+        local_flags[mesh->first + s] = 1;
+    }
+  }
+  MPI_Allreduce(local_flags, flags, mesh->nblocks, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+  /*
+  ** keep the mesh balanced: a block being refined must not end up
+  ** next to a block two levels coarser, so refine that one too.
+  ** every rank does this on its own copy of the block list.
+  */
+  do {
+    changed = 0;
+    for (b = 0; b < mesh->nblocks; b++) {
+      if (!flags[b]) continue;
+      for (side = 0; side < 4; side++) {
+        if (find_neighbours(mesh, b, side, nbr) == COARSER && !flags[nbr[0]]) {
+          flags[nbr[0]] = 1;
+          changed = 1;
+        }
+      }
+    }
+  } while (changed);
+
+  /* the new list of blocks, remembering where each came from */
+  nnew = 0;
+  for (b = 0; b < mesh->nblocks; b++)
+    nnew += flags[b] ? 4 : 1;
+  newblocks = (block_t*)malloc(sizeof(block_t) * nnew);
+  nn = 0;
+  for (b = 0; b < mesh->nblocks; b++) {
+    blk = &mesh->blocks[b];
+    if (flags[b]) {
+      for (c = 0; c < 4; c++) {
+        newblocks[nn].level = blk->level + 1;
+        newblocks[nn].ix = 2 * blk->ix + c % 2;
+        newblocks[nn].iy = 2 * blk->iy + c / 2;
+        newblocks[nn].src = b;
+        nn++;
+      }
+    }
+    else {
+      newblocks[nn] = *blk;
+      newblocks[nn].src = b;
+      nn++;
+    }
+  }
+
+  /* order along the space-filling curve, and cut it into equal pieces */
+  for (nn = 0; nn < nnew; nn++)
+    newblocks[nn].key = morton_key(newblocks[nn].level, newblocks[nn].ix, newblocks[nn].iy);
+  qsort(newblocks, nnew, sizeof(block_t), compare_blocks);
+  for (nn = 0; nn < nnew; nn++)
+    newblocks[nn].owner = (int)(((long)nn * size) / nnew);
+  new_first = -1;
+  nnew_local = 0;
+  for (nn = 0; nn < nnew; nn++) {
+    if (newblocks[nn].owner == rank) {
+      if (new_first < 0) new_first = nn;
+      nnew_local++;
+    }
+  }
+  if (new_first < 0) new_first = 0;
+
+  /*
+  ** move the data: the old owner of each source block sends the new
+  ** block (either a copy, or a quarter of it injected onto the finer
+  ** cells) to the new owner.  sends are grouped by destination and
+  ** receives by source, both in curve order, so everything lines up.
+  */
+  scounts = (int*)calloc(size, sizeof(int));
+  sdispls = (int*)calloc(size, sizeof(int));
+  rcounts = (int*)calloc(size, sizeof(int));
+  rdispls = (int*)calloc(size, sizeof(int));
+  for (nn = 0; nn < nnew; nn++) {
+    src = newblocks[nn].src;
+    if (mesh->blocks[src].owner == rank)
+      scounts[newblocks[nn].owner] += NX * NX;
+    if (newblocks[nn].owner == rank)
+      rcounts[mesh->blocks[src].owner] += NX * NX;
+  }
+  for (kk = 1; kk < size; kk++) {
+    sdispls[kk] = sdispls[kk - 1] + scounts[kk - 1];
+    rdispls[kk] = rdispls[kk - 1] + rcounts[kk - 1];
+  }
+  sendbuf = (double*)malloc(sizeof(double) * (sdispls[size - 1] + scounts[size - 1] + 1));
+  newu = (double*)malloc(sizeof(double) * (nnew_local + 1) * NX * NX);
+
+  for (kk = 0; kk < size; kk++) {
+    out = &sendbuf[sdispls[kk]];
+    for (nn = 0; nn < nnew; nn++) {
+      src = newblocks[nn].src;
+      if (newblocks[nn].owner != kk || mesh->blocks[src].owner != rank) continue;
+      u = &mesh->u[(src - mesh->first) * NX * NX];
+      if (newblocks[nn].level == mesh->blocks[src].level) {
+        memcpy(out, u, sizeof(double) * NX * NX);
+      }
+      else {
+        for (jj = 1; jj <= BS; jj++)
+          for (ii = 1; ii <= BS; ii++)
+            out[jj * NX + ii] = u[((newblocks[nn].iy % 2) * BS / 2 + (jj + 1) / 2) * NX
+                                  + (newblocks[nn].ix % 2) * BS / 2 + (ii + 1) / 2];
+      }
+      out += NX * NX;
+    }
+  }
+  MPI_Alltoallv(sendbuf, scounts, sdispls, MPI_DOUBLE,
+                newu, rcounts, rdispls, MPI_DOUBLE, MPI_COMM_WORLD);
+
+  /* received data is grouped by source rank, so put it into curve order */
+  free(mesh->u);
+  mesh->u = (double*)malloc(sizeof(double) * (nnew_local + 1) * NX * NX);
+  for (kk = 0; kk < size; kk++) {
+    out = &newu[rdispls[kk]];
+    for (nn = new_first; nn < new_first + nnew_local; nn++) {
+      if (mesh->blocks[newblocks[nn].src].owner != kk) continue;
+      memcpy(&mesh->u[(nn - new_first) * NX * NX], out, sizeof(double) * NX * NX);
+      out += NX * NX;
+    }
+  }
+
+  free(mesh->blocks);
+  mesh->blocks = newblocks;
+  mesh->nblocks = nnew;
+  mesh->nlocal = nnew_local;
+  mesh->first = new_first;
+  free(mesh->unew);
+  mesh->unew = (double*)malloc(sizeof(double) * (nnew_local + 1) * NX * NX);
+  build_lookup(mesh);
+  build_exchange(mesh, rank, size);
+
+  free(local_flags);
+  free(flags);
+  free(scounts);
+  free(sdispls);
+  free(rcounts);
+  free(rdispls);
+  free(sendbuf);
+  free(newu);
+}
+
+/* record where each block sits, so that neighbours can be found */
+void build_lookup(mesh_t* mesh)
+{
+  int level, b, n;
+  block_t* blk;
+
+  for (level = 0; level <= MAXLEVEL; level++) {
+    n = NBASE << level;
+    free(mesh->lookup[level]);
+    mesh->lookup[level] = (int*)malloc(sizeof(int) * n * n);
+    for (b = 0; b < n * n; b++)
+      mesh->lookup[level][b] = -1;
+  }
+  for (b = 0; b < mesh->nblocks; b++) {
+    blk = &mesh->blocks[b];
+    mesh->lookup[blk->level][blk->iy * (NBASE << blk->level) + blk->ix] = b;
+  }
+}
+
+/*
+** Work out which local blocks must be sent to which ranks, and which
+** remote blocks we will receive.  A block is sent to a rank if any of its
+** neighbours is held there.  Since every rank has the full block list,
+** the sender and receiver can agree on this without communicating.
+*/
+void build_exchange(mesh_t* mesh, int rank, int size)
+{
+  int b, side, kk, k, n, nrecv;
+  int nbr[2];
+  int* touches;          /* for one block, whether it neighbours each rank */
+
+  free(mesh->faces);
+  free(mesh->remote);
+  free(mesh->remote_slot);
+  free(mesh->sendbuf);
+  free(mesh->sendlist);
+  free(mesh->sendcounts);
+  free(mesh->senddispls);
+  free(mesh->recvcounts);
+  free(mesh->recvdispls);
+
+  mesh->faces = (double*)malloc(sizeof(double) * (mesh->nlocal + 1) * 4 * BS);
+  mesh->remote_slot = (int*)malloc(sizeof(int) * mesh->nblocks);
+  mesh->sendcounts = (int*)calloc(size, sizeof(int));
+  mesh->senddispls = (int*)calloc(size, sizeof(int));
+  mesh->recvcounts = (int*)calloc(size, sizeof(int));
+  mesh->recvdispls = (int*)calloc(size, sizeof(int));
+  touches = (int*)malloc(sizeof(int) * size);
+
+  /* first pass counts, second pass fills in the lists */
+  mesh->sendlist = NULL;
+  for (k = 0; k < 2; k++) {
+    mesh->nsend = 0;
+    nrecv = 0;
+    for (kk = 0; kk < size; kk++) {
+      for (b = 0; b < mesh->nblocks; b++) {
+        if (k == 0 && kk == 0) mesh->remote_slot[b] = -1;
+        memset(touches, 0, sizeof(int) * size);
+        for (side = 0; side < 4; side++) {
+          switch (find_neighbours(mesh, b, side, nbr)) {
+            case FINER:
+              touches[mesh->blocks[nbr[1]].owner] = 1;
+              /* fall through */
+            case SAME:
+            case COARSER:
+              touches[mesh->blocks[nbr[0]].owner] = 1;
+          }
+        }
+        /* a local block going to rank kk */
+        if (mesh->blocks[b].owner == rank && kk != rank && touches[kk]) {
+          if (k == 0) mesh->sendcounts[kk] += 4 * BS;
+          else mesh->sendlist[mesh->nsend] = b - mesh->first;
+          mesh->nsend++;
+        }
+        /* a block on rank kk coming to us */
+        if (mesh->blocks[b].owner == kk && kk != rank && touches[rank]) {
+          if (k == 0) mesh->recvcounts[kk] += 4 * BS;
+          else mesh->remote_slot[b] = nrecv;
+          nrecv++;
+        }
+      }
+    }
+    if (k == 0)
+      mesh->sendlist = (int*)malloc(sizeof(int) * (mesh->nsend + 1));
+  }
+
+  for (kk = 1; kk < size; kk++) {
+    mesh->senddispls[kk] = mesh->senddispls[kk - 1] + mesh->sendcounts[kk - 1];
+    mesh->recvdispls[kk] = mesh->recvdispls[kk - 1] + mesh->recvcounts[kk - 1];
+  }
+  n = nrecv + 1;
+  mesh->remote = (double*)malloc(sizeof(double) * n * 4 * BS);
+  mesh->sendbuf = (double*)malloc(sizeof(double) * (mesh->nsend + 1) * 4 * BS);
+
+  free(touches);
+}
+
+/*
+** Position of a block along the Morton (Z-order) curve: interleave the
+** bits of its coordinates, measured in units of the finest blocks.
+*/
+unsigned long morton_key(int level, int ix, int iy)
+{
+  unsigned long key = 0;
+  unsigned long x = (unsigned long)ix << (MAXLEVEL - level);
+  unsigned long y = (unsigned long)iy << (MAXLEVEL - level);
+  int bit;
+
+  for (bit = 0; bit < 16; bit++) {
+    key |= ((x >> bit) & 1UL) << (2 * bit);
+    key |= ((y >> bit) & 1UL) << (2 * bit + 1);
+  }
+  return key;
+}
+
+int compare_blocks(const void* a, const void* b)
+{
+  unsigned long ka = ((const block_t*)a)->key;
+  unsigned long kb = ((const block_t*)b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+/*
+** The exact steady state: 100 minus the solution with 100 on the top
+** edge and 0 elsewhere, which is a Fourier sine series.
+** Terms are summed until they become negligible.
+*/
+double exact(double x, double y)
+{
+  int n;
+  double pi = 4.0 * atan(1.0);
+  double v = 0.0;
+  double decay;
+
+  for (n = 1; ; n += 2) {
+    /* sinh(n pi y) / sinh(n pi), written so as not to overflow */
+    decay = exp(n * pi * (y - 1.0)) * (1.0 - exp(-2.0 * n * pi * y)) / (1.0 - exp(-2.0 * n * pi));
+    if (decay < 1.0e-14) break;
+    v += 400.0 / (n * pi) * sin(n * pi * x) * decay;
+  }
+  return 100.0 - v;
+}
@@ -0,0 +1,468 @@
+/*
+** A direct solver for the steady state of the heated plate from
+** mpi/example5/skeleton2-heated-plate.c.
+**
+** Boundary conditions for the full grid are, as before:
+**
+**                      W = 0
+**             +--------------------+
+**             |                    |
+**    W = 100  |                    | W = 100
+**             |                    |
+**             +--------------------+
+**                     W = 100
+**
+** The time-stepping examples converge towards the steady state, which
+** satisfies Laplace's equation.  With the 5-point stencil this is
+**
+**   u(i-1,j) + u(i+1,j) + u(i,j-1) + u(i,j+1) - 4 u(i,j) = 0
+**
+** for every inner cell.  Moving the boundary values to the right-hand
+** side gives a linear system A u = b which we can solve directly:
+**
+** 1. Apply a discrete sine transform (DST) along each row.  The sines
+**    are the eigenvectors of the second difference along a row, so this
+**    decouples the columns: mode k only couples to mode k in the rows
+**    above and below.
+** 2. For each mode k, solve a tridiagonal system down the column.
+** 3. Apply the inverse DST along each row.
+**
+** The DST is computed with a radix-2 FFT, written out below, so that the
+** whole solve costs O(N log N) operations per row, with no library needed.
+** The FFT requires the number of inner columns to be one less than a power
+** of two, i.e. ncols = 2^m + 1.
+**
+** As in adi_heated_plate.c, the solution is held in column strips and the
+** grid is redistributed to row strips with MPI_Alltoallw() whenever whole
+** rows are needed.  At the end, a single halo exchange lets us check the
+** residual of the 5-point stencil.
+**
+** Usage: poisson_dst_heated_plate.exe [nrows ncols]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mpi.h"
+
+#define NROWS 129
+#define NCOLS 129
+#define MASTER 0
+
+/* function prototypes */
+int calc_nitems_from_rank(int rank, int size, int nitems);
+int calc_start_from_rank(int rank, int size, int nitems);
+void fft(int n, double* re, double* im, const double* cosw, const double* sinw);
+void dst_rows(int nrows, int ncols, int start_row, int local_nrows, double* grid,
+              double* re, double* im, const double* cosw, const double* sinw);
+
+int main(int argc, char* argv[])
+{
+  int ii, jj;            /* row and column indices for the grid */
+  int gi, gj;            /* global row and column indices */
+  int kk;                /* index for looping over ranks */
+  int rank;              /* the rank of this process */
+  int size;              /* number of processes in the communicator */
+  int left;              /* the rank of the process to the left */
+  int right;             /* the rank of the process to the right */
+  int tag = 0;           /* scope for adding extra information to a message */
+  MPI_Status status;     /* struct used by MPI_Sendrecv */
+  int nrows, ncols;      /* size of the full grid, including boundaries */
+  int ninner;            /* number of inner columns, i.e. the DST length */
+  int nfft;              /* length of the FFT used for the DST */
+  int local_nrows;       /* number of rows apportioned to this rank (row layout) */
+  int local_ncols;       /* number of columns apportioned to this rank (column layout) */
+  int start_row;         /* first global row held by this rank (row layout) */
+  int start_col;         /* first global column held by this rank (column layout) */
+  int width;             /* local row length in the column layout, including halos */
+  int sizes[2], subsizes[2], starts[2];  /* arguments to MPI_Type_create_subarray() */
+  int* counts;           /* one element of each datatype is sent to each rank */
+  int* displs;           /* all displacements are folded into the datatypes */
+  double pi = 4.0 * atan(1.0);
+  double lambda;         /* eigenvalue of the second difference for a mode */
+  double residual;       /* largest local residual of the 5-point stencil */
+  double maxres;         /* largest residual over all ranks */
+  double sum, mean;      /* sum and mean of the temperatures over the plate */
+  double tic, toc;       /* timestamps */
+  double t_transpose = 0.0;  /* time spent redistributing the grid */
+  double t_dst = 0.0;        /* time spent in the sine transforms */
+  double t_tridiag = 0.0;    /* time spent in the tridiagonal solves */
+  double times[4];       /* the times above, reduced over ranks */
+  double* ucol;          /* boundary values, then solution, in the column layout (with halos) */
+  double* bcol;          /* right-hand side and workspace, in the column layout */
+  double* brow;          /* right-hand side and workspace, in the row layout */
+  double* diag;          /* diagonal of the tridiagonal system for each local mode */
+  double* cp;            /* Thomas algorithm coefficients for each local mode */
+  double* re, *im;       /* FFT workspace */
+  double* cosw, *sinw;   /* FFT twiddle factors */
+  double* sendbuf;       /* buffer to hold values to send */
+  double* recvbuf;       /* buffer to hold received values */
+  MPI_Datatype* coltypes;  /* part of the column layout going to/from each rank */
+  MPI_Datatype* rowtypes;  /* part of the row layout going to/from each rank */
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  nrows = NROWS;
+  ncols = NCOLS;
+  if (argc > 2) {
+    nrows = atoi(argv[1]);
+    ncols = atoi(argv[2]);
+  }
+  ninner = ncols - 2;
+  nfft = 2 * (ninner + 1);
+  if (nrows < 3 || ncols < 3 || ((ncols - 1) & (ncols - 2)) != 0) {
+    if (rank == MASTER)
+      fprintf(stderr, "Error: need nrows >= 3 and ncols = 2^m + 1\n");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  left = (rank == 0) ? MPI_PROC_NULL : rank - 1;
+  right = (rank == size - 1) ? MPI_PROC_NULL : rank + 1;
+
+  local_ncols = calc_nitems_from_rank(rank, size, ncols);
+  local_nrows = calc_nitems_from_rank(rank, size, nrows);
+  start_col = calc_start_from_rank(rank, size, ncols);
+  start_row = calc_start_from_rank(rank, size, nrows);
+  width = local_ncols + 2;
+  if (local_ncols < 1 || local_nrows < 1) {
+    fprintf(stderr, "Error: too many processes:- local_ncols or local_nrows < 1\n");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  ucol = (double*)malloc(sizeof(double) * nrows * width);
+  bcol = (double*)malloc(sizeof(double) * nrows * local_ncols);
+  brow = (double*)malloc(sizeof(double) * local_nrows * ncols);
+  diag = (double*)malloc(sizeof(double) * local_ncols);
+  cp = (double*)malloc(sizeof(double) * nrows * local_ncols);
+  re = (double*)malloc(sizeof(double) * nfft);
+  im = (double*)malloc(sizeof(double) * nfft);
+  cosw = (double*)malloc(sizeof(double) * nfft / 2);
+  sinw = (double*)malloc(sizeof(double) * nfft / 2);
+  sendbuf = (double*)malloc(sizeof(double) * nrows);
+  recvbuf = (double*)malloc(sizeof(double) * nrows);
+
+  /* subarray datatypes for the transposes, exactly as in adi_heated_plate.c */
+  coltypes = (MPI_Datatype*)malloc(sizeof(MPI_Datatype) * size);
+  rowtypes = (MPI_Datatype*)malloc(sizeof(MPI_Datatype) * size);
+  counts = (int*)malloc(sizeof(int) * size);
+  displs = (int*)malloc(sizeof(int) * size);
+  for (kk = 0; kk < size; kk++) {
+    sizes[0] = nrows;
+    sizes[1] = local_ncols;
+    subsizes[0] = calc_nitems_from_rank(kk, size, nrows);
+    subsizes[1] = local_ncols;
+    starts[0] = calc_start_from_rank(kk, size, nrows);
+    starts[1] = 0;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &coltypes[kk]);
+    MPI_Type_commit(&coltypes[kk]);
+
+    sizes[0] = local_nrows;
+    sizes[1] = ncols;
+    subsizes[0] = local_nrows;
+    subsizes[1] = calc_nitems_from_rank(kk, size, ncols);
+    starts[0] = 0;
+    starts[1] = calc_start_from_rank(kk, size, ncols);
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &rowtypes[kk]);
+    MPI_Type_commit(&rowtypes[kk]);
+
+    counts[kk] = 1;
+    displs[kk] = 0;
+  }
+
+  /* twiddle factors, exp(-2 pi i k / nfft), for the FFT */
+  for (kk = 0; kk < nfft / 2; kk++) {
+    cosw[kk] = cos(2.0 * pi * kk / nfft);
+    sinw[kk] = -sin(2.0 * pi * kk / nfft);
+  }
+
+  /*
+  ** set the boundary values in the column layout, note that
+  ** the halo columns (0 and local_ncols + 1) are left for later.
+  ** inner cells are zero for now.
+  */
+  for (ii = 0; ii < nrows; ii++) {
+    for (jj = 1; jj < local_ncols + 1; jj++) {
+      gj = start_col + jj - 1;
+      if (ii == 0)
+        ucol[ii * width + jj] = 0.0;
+      else if (ii == nrows - 1 || gj == 0 || gj == ncols - 1)
+        ucol[ii * width + jj] = 100.0;
+      else
+        ucol[ii * width + jj] = 0.0;
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = MPI_Wtime();
+
+  /*
+  ** right-hand side: minus the sum of any boundary neighbours.
+  ** the left and right boundaries sit in the first and last global
+  ** columns; rather than exchanging halos for them we use the known values.
+  */
+  memset(bcol, 0, sizeof(double) * nrows * local_ncols);
+  for (ii = 1; ii < nrows - 1; ii++) {
+    for (jj = 0; jj < local_ncols; jj++) {
+      gj = start_col + jj;
+      if (gj == 0 || gj == ncols - 1) continue;
+      if (ii == 1)
+        bcol[ii * local_ncols + jj] -= ucol[0 * width + jj + 1];
+      if (ii == nrows - 2)
+        bcol[ii * local_ncols + jj] -= ucol[(nrows - 1) * width + jj + 1];
+      if (gj == 1)
+        bcol[ii * local_ncols + jj] -= 100.0;
+      if (gj == ncols - 2)
+        bcol[ii * local_ncols + jj] -= 100.0;
+    }
+  }
+
+  /* column strips -> row strips, then a forward DST along each row */
+  toc = MPI_Wtime();
+  MPI_Alltoallw(bcol, counts, displs, coltypes,
+                brow, counts, displs, rowtypes, MPI_COMM_WORLD);
+  t_transpose += MPI_Wtime() - toc;
+
+  toc = MPI_Wtime();
+  dst_rows(nrows, ncols, start_row, local_nrows, brow, re, im, cosw, sinw);
+  t_dst += MPI_Wtime() - toc;
+
+  /* row strips -> column strips; each rank now holds a set of modes */
+  toc = MPI_Wtime();
+  MPI_Alltoallw(brow, counts, displs, rowtypes,
+                bcol, counts, displs, coltypes, MPI_COMM_WORLD);
+  t_transpose += MPI_Wtime() - toc;
+
+  /*
+  ** For mode k the system down a column is
+  **   v(i-1) + (lambda_k - 2) v(i) + v(i+1) = bhat(i)
+  ** with lambda_k = -4 sin^2(pi k / (2 (ninner + 1))).
+  ** The diagonal differs between modes, so the Thomas coefficients
+  ** are stored per column.  As in adi_heated_plate.c, we sweep over
+  ** all local columns row by row so the inner loop is contiguous.
+  */
+  toc = MPI_Wtime();
+  for (jj = 0; jj < local_ncols; jj++) {
+    gj = start_col + jj;
+    lambda = -4.0 * sin(pi * gj / (2.0 * (ninner + 1))) * sin(pi * gj / (2.0 * (ninner + 1)));
+    diag[jj] = lambda - 2.0;
+    cp[1 * local_ncols + jj] = 1.0 / diag[jj];
+    bcol[1 * local_ncols + jj] /= diag[jj];
+  }
+  for (ii = 2; ii < nrows - 1; ii++) {
+    for (jj = 0; jj < local_ncols; jj++) {
+      double inv = 1.0 / (diag[jj] - cp[(ii - 1) * local_ncols + jj]);
+      cp[ii * local_ncols + jj] = inv;
+      bcol[ii * local_ncols + jj] = (bcol[ii * local_ncols + jj] - bcol[(ii - 1) * local_ncols + jj]) * inv;
+    }
+  }
+  for (ii = nrows - 3; ii > 0; ii--) {
+    for (jj = 0; jj < local_ncols; jj++) {
+      bcol[ii * local_ncols + jj] -= cp[ii * local_ncols + jj] * bcol[(ii + 1) * local_ncols + jj];
+    }
+  }
+  t_tridiag += MPI_Wtime() - toc;
+
+  /* column strips -> row strips, inverse DST, and back to column strips */
+  toc = MPI_Wtime();
+  MPI_Alltoallw(bcol, counts, displs, coltypes,
+                brow, counts, displs, rowtypes, MPI_COMM_WORLD);
+  t_transpose += MPI_Wtime() - toc;
+
+  toc = MPI_Wtime();
+  dst_rows(nrows, ncols, start_row, local_nrows, brow, re, im, cosw, sinw);
+  for (ii = 0; ii < local_nrows * ncols; ii++)
+    brow[ii] *= 2.0 / (ninner + 1);    /* the DST-I is its own inverse, up to scaling */
+  t_dst += MPI_Wtime() - toc;
+
+  toc = MPI_Wtime();
+  MPI_Alltoallw(brow, counts, displs, rowtypes,
+                bcol, counts, displs, coltypes, MPI_COMM_WORLD);
+  t_transpose += MPI_Wtime() - toc;
+
+  /* copy the solution for the inner cells into ucol */
+  for (ii = 1; ii < nrows - 1; ii++) {
+    for (jj = 0; jj < local_ncols; jj++) {
+      gj = start_col + jj;
+      if (gj == 0 || gj == ncols - 1) continue;
+      ucol[ii * width + jj + 1] = bcol[ii * local_ncols + jj];
+    }
+  }
+
+  toc = MPI_Wtime();
+
+  /*
+  ** check the answer: after one halo exchange, as in
+  ** skeleton2-heated-plate.c, compute the residual of the 5-point stencil
+  */
+  for (ii = 0; ii < nrows; ii++)
+    sendbuf[ii] = ucol[ii * width + 1];
+  MPI_Sendrecv(sendbuf, nrows, MPI_DOUBLE, left, tag,
+               recvbuf, nrows, MPI_DOUBLE, right, tag,
+               MPI_COMM_WORLD, &status);
+  for (ii = 0; ii < nrows; ii++)
+    ucol[ii * width + local_ncols + 1] = recvbuf[ii];
+  for (ii = 0; ii < nrows; ii++)
+    sendbuf[ii] = ucol[ii * width + local_ncols];
+  MPI_Sendrecv(sendbuf, nrows, MPI_DOUBLE, right, tag,
+               recvbuf, nrows, MPI_DOUBLE, left, tag,
+               MPI_COMM_WORLD, &status);
+  for (ii = 0; ii < nrows; ii++)
+    ucol[ii * width] = recvbuf[ii];
+
+  residual = 0.0;
+  sum = 0.0;
+  for (ii = 0; ii < nrows; ii++) {
+    for (jj = 1; jj < local_ncols + 1; jj++) {
+      gi = ii;
+      gj = start_col + jj - 1;
+      sum += ucol[ii * width + jj];
+      if (gi == 0 || gi == nrows - 1 || gj == 0 || gj == ncols - 1) continue;
+      residual = fmax(residual, fabs(ucol[(ii - 1) * width + jj] + ucol[(ii + 1) * width + jj]
+                                     + ucol[ii * width + jj - 1] + ucol[ii * width + jj + 1]
+                                     - 4.0 * ucol[ii * width + jj]));
+    }
+  }
+  MPI_Reduce(&residual, &maxres, 1, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(&sum, &mean, 1, MPI_DOUBLE, MPI_SUM, MASTER, MPI_COMM_WORLD);
+
+  times[0] = toc - tic;
+  times[1] = t_transpose;
+  times[2] = t_dst;
+  times[3] = t_tridiag;
+  if (rank == MASTER)
+    MPI_Reduce(MPI_IN_PLACE, times, 4, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+  else
+    MPI_Reduce(times, NULL, 4, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+
+  if (rank == MASTER) {
+    mean /= (double)(nrows * ncols);
+    printf("NROWS: %d\nNCOLS: %d\n", nrows, ncols);
+    printf("mean temperature: %f\n", mean);
+    printf("max residual:     %g\n", maxres);
+    printf("total time:       %f s\n", times[0]);
+    printf("transpose time:   %f s\n", times[1]);
+    printf("DST time:         %f s\n", times[2]);
+    printf("tridiagonal time: %f s\n", times[3]);
+  }
+
+  for (kk = 0; kk < size; kk++) {
+    MPI_Type_free(&coltypes[kk]);
+    MPI_Type_free(&rowtypes[kk]);
+  }
+
+  /* don't forget to tidy up when we're done */
+  MPI_Finalize();
+
+  free(ucol);
+  free(bcol);
+  free(brow);
+  free(diag);
+  free(cp);
+  free(re);
+  free(im);
+  free(cosw);
+  free(sinw);
+  free(sendbuf);
+  free(recvbuf);
+  free(coltypes);
+  free(rowtypes);
+  free(counts);
+  free(displs);
+
+  return EXIT_SUCCESS;
+}
+
+/*
+** Apply a DST-I to the inner cells of each inner row held locally:
+**
+**   X(k) = sum_{j=1}^{n} x(j) sin(pi j k / (n + 1)),  k = 1..n
+**
+** The row is extended to an odd sequence of length 2(n + 1),
+** whose FFT is -2i X(k), so we can read X(k) off the imaginary part.
+*/
+void dst_rows(int nrows, int ncols, int start_row, int local_nrows, double* grid,
+              double* re, double* im, const double* cosw, const double* sinw)
+{
+  int ii, jj, gi;
+  int n = ncols - 2;
+  int nfft = 2 * (n + 1);
+
+  for (ii = 0; ii < local_nrows; ii++) {
+    gi = start_row + ii;
+    if (gi == 0 || gi == nrows - 1) continue;
+    re[0] = 0.0;
+    re[n + 1] = 0.0;
+    for (jj = 1; jj <= n; jj++) {
+      re[jj] = grid[ii * ncols + jj];
+      re[nfft - jj] = -grid[ii * ncols + jj];
+    }
+    for (jj = 0; jj < nfft; jj++)
+      im[jj] = 0.0;
+    fft(nfft, re, im, cosw, sinw);
+    for (jj = 1; jj <= n; jj++)
+      grid[ii * ncols + jj] = -0.5 * im[jj];
+  }
+}
+
+/*
+** An in-place, iterative, radix-2 FFT of length n (a power of two).
+** The twiddle factors are passed in, as they are the same for every row.
+*/
+void fft(int n, double* re, double* im, const double* cosw, const double* sinw)
+{
+  int ii, jj, kk;
+  int len, half, step;
+  double tr, ti, wr, wi;
+
+  /* bit-reversal permutation */
+  for (ii = 1, jj = 0; ii < n; ii++) {
+    int bit = n >> 1;
+    for (; jj & bit; bit >>= 1)
+      jj ^= bit;
+    jj ^= bit;
+    if (ii < jj) {
+      tr = re[ii]; re[ii] = re[jj]; re[jj] = tr;
+      ti = im[ii]; im[ii] = im[jj]; im[jj] = ti;
+    }
+  }
+
+  /* butterflies, doubling the transform length each pass */
+  for (len = 2; len <= n; len <<= 1) {
+    half = len >> 1;
+    step = n / len;
+    for (ii = 0; ii < n; ii += len) {
+      for (kk = 0; kk < half; kk++) {
+        wr = cosw[kk * step];
+        wi = sinw[kk * step];
+        jj = ii + kk + half;
+        tr = wr * re[jj] - wi * im[jj];
+        ti = wr * im[jj] + wi * re[jj];
+        re[jj] = re[ii + kk] - tr;
+        im[jj] = im[ii + kk] - ti;
+        re[ii + kk] += tr;
+        im[ii + kk] += ti;
+      }
+    }
+  }
+}
+
+int calc_nitems_from_rank(int rank, int size, int nitems)
+{
+  int n;
+
+  n = nitems / size;       /* integer division */
+  if ((nitems % size) != 0) {  /* if there is a remainder */
+    if (rank == size - 1)
+      n += nitems % size;  /* add remainder to last rank */
+  }
+
+  return n;
+}
+
+int calc_start_from_rank(int rank, int size, int nitems)
+{
+  return rank * (nitems / size);
+}
@@ -0,0 +1,335 @@
+/*
+** A small, generic stencil engine.
+**
+** The 1D update in openmp/example4/serial_heat.c, the 5-point update in
+** mpi/example5/skeleton2-heated-plate.c and the halo layout in
+** mpi/example5/skeleton2-simple2d.c are all special cases of:
+**
+**   out(x) = sum over offsets o of c(o) * in(x + o)
+**
+** where the offsets o cover a box of (2 * Radius + 1)^Dim points.
+** Here, the dimension and radius are template parameters, so that:
+**
+** - the sum over offsets is fully unrolled at compile time,
+** - the halo width of a Grid is the stencil radius, and
+** - a HaloExchange fills the halos of a Grid distributed over a
+**   cartesian communicator, including the corners and edges, which
+**   9-point and other "box" stencils need.
+**
+** Coefficients may be given at run-time, as a Stencil object, or at
+** compile-time, as a reference to a constexpr Stencil.  In the latter
+** case, terms with a zero coefficient are removed by the compiler.
+*/
+
+#ifndef STENCIL_HPP
+#define STENCIL_HPP
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <mpi.h>
+
+namespace stencil {
+
+constexpr int ipow(int base, int exp)
+{
+  return (exp == 0) ? 1 : base * ipow(base, exp - 1);
+}
+
+/*
+** Coefficients of a stencil, stored for every offset in the box,
+** with the last dimension varying fastest.
+*/
+template <int Dim, int Radius>
+struct Stencil {
+  static constexpr int width = 2 * Radius + 1;
+  static constexpr int npoints = ipow(width, Dim);
+
+  std::array<double, npoints> c{};
+
+  /* the offset along dimension d of point p in the box */
+  static constexpr int offset(int p, int d)
+  {
+    return (p / ipow(width, Dim - 1 - d)) % width - Radius;
+  }
+
+  /* the coefficient at a given offset from the centre */
+  constexpr double& at(const std::array<int, Dim>& off)
+  {
+    int p = 0;
+    for (int d = 0; d < Dim; ++d)
+      p = p * width + off[d] + Radius;
+    return c[p];
+  }
+};
+
+/*
+** Explicit timestep of the heat equation, u + r * Laplacian(u),
+** using the usual second order central difference in each dimension.
+** With Dim = 2 and r = 1/4 this is the Jacobi update of skeleton2-heated-plate.c.
+*/
+template <int Dim>
+constexpr Stencil<Dim, 1> heat(double r)
+{
+  Stencil<Dim, 1> s{};
+  std::array<int, Dim> off{};
+  s.at(off) = 1.0 - 2.0 * Dim * r;
+  for (int d = 0; d < Dim; ++d) {
+    off[d] = -1; s.at(off) += r;
+    off[d] = +1; s.at(off) += r;
+    off[d] = 0;
+  }
+  return s;
+}
+
+/* as above, using the fourth order central difference, which has radius 2 */
+template <int Dim>
+constexpr Stencil<Dim, 2> heat4(double r)
+{
+  Stencil<Dim, 2> s{};
+  std::array<int, Dim> off{};
+  s.at(off) = 1.0 - 2.5 * Dim * r;
+  for (int d = 0; d < Dim; ++d) {
+    off[d] = -2; s.at(off) += -r / 12.0;
+    off[d] = -1; s.at(off) += 4.0 * r / 3.0;
+    off[d] = +1; s.at(off) += 4.0 * r / 3.0;
+    off[d] = +2; s.at(off) += -r / 12.0;
+    off[d] = 0;
+  }
+  return s;
+}
+
+/*
+** As heat<2>, using the isotropic 9-point Laplacian, which
+** also uses the diagonal neighbours:
+**   (4 * (N + S + E + W) + (NE + NW + SE + SW) - 20 * C) / 6
+*/
+constexpr Stencil<2, 1> heat9(double r)
+{
+  Stencil<2, 1> s{};
+  for (int i = -1; i <= 1; ++i)
+    for (int j = -1; j <= 1; ++j)
+      s.at({i, j}) = ((i == 0) != (j == 0)) ? 4.0 * r / 6.0 : r / 6.0;
+  s.at({0, 0}) = 1.0 - 20.0 * r / 6.0;
+  return s;
+}
+
+/*
+** A Dim-dimensional grid of n[0] x n[1] x ... cells, surrounded by a
+** halo of width Radius.  Storage is row-major (the last dimension is
+** contiguous) and indices run from -Radius to n[d] + Radius - 1.
+*/
+template <int Dim, int Radius>
+class Grid {
+public:
+  static constexpr int halo = Radius;
+
+  explicit Grid(const std::array<int, Dim>& n) : n_(n)
+  {
+    std::size_t total = 1;
+    for (int d = Dim - 1; d >= 0; --d) {
+      ext_[d] = n_[d] + 2 * halo;
+      stride_[d] = (std::ptrdiff_t)total;
+      total *= ext_[d];
+    }
+    data_.assign(total, 0.0);
+  }
+
+  double* data() { return data_.data(); }
+  const double* data() const { return data_.data(); }
+  const std::array<int, Dim>& extent() const { return n_; }
+  const std::array<int, Dim>& storage_extent() const { return ext_; }
+  const std::array<std::ptrdiff_t, Dim>& stride() const { return stride_; }
+
+  std::ptrdiff_t index(const std::array<int, Dim>& idx) const
+  {
+    std::ptrdiff_t p = 0;
+    for (int d = 0; d < Dim; ++d)
+      p += (idx[d] + halo) * stride_[d];
+    return p;
+  }
+
+  double& operator()(const std::array<int, Dim>& idx) { return data_[index(idx)]; }
+  double operator()(const std::array<int, Dim>& idx) const { return data_[index(idx)]; }
+
+  void swap(Grid& other) { data_.swap(other.data_); }
+
+private:
+  std::array<int, Dim> n_;                 /* interior cells in each dimension */
+  std::array<int, Dim> ext_;               /* cells in each dimension, including halos */
+  std::array<std::ptrdiff_t, Dim> stride_; /* distance between neighbours in each dimension */
+  std::vector<double> data_;
+};
+
+namespace detail {
+
+/* distance in memory from a cell to each point of the stencil */
+template <int Dim, int Radius>
+std::array<std::ptrdiff_t, Stencil<Dim, Radius>::npoints>
+offsets(const std::array<std::ptrdiff_t, Dim>& stride)
+{
+  std::array<std::ptrdiff_t, Stencil<Dim, Radius>::npoints> off{};
+  for (int p = 0; p < Stencil<Dim, Radius>::npoints; ++p)
+    for (int d = 0; d < Dim; ++d)
+      off[p] += Stencil<Dim, Radius>::offset(p, d) * stride[d];
+  return off;
+}
+
+/* the unrolled sum, with run-time coefficients */
+template <std::size_t N, std::size_t... P>
+inline double sum(const double* in, const std::array<std::ptrdiff_t, N>& off,
+                  const std::array<double, N>& c, std::index_sequence<P...>)
+{
+  return ((c[P] * in[off[P]]) + ...);
+}
+
+/* the unrolled sum, with compile-time coefficients: zero terms vanish */
+template <const auto& S, std::size_t N, std::size_t... P>
+inline double sum(const double* in, const std::array<std::ptrdiff_t, N>& off,
+                  std::index_sequence<P...>)
+{
+  return (((S.c[P] != 0.0) ? S.c[P] * in[off[P]] : 0.0) + ...);
+}
+
+/* visit every interior cell, with the innermost loop over contiguous memory */
+template <int D, int Dim, class F>
+inline void for_interior(const std::array<int, Dim>& n,
+                         const std::array<std::ptrdiff_t, Dim>& stride,
+                         std::ptrdiff_t base, F&& f)
+{
+  if constexpr (D == Dim - 1) {
+#pragma omp simd
+    for (int i = 0; i < n[D]; ++i)
+      f(base + i);
+  }
+  else {
+    for (int i = 0; i < n[D]; ++i)
+      for_interior<D + 1, Dim>(n, stride, base + i * stride[D], f);
+  }
+}
+
+} /* namespace detail */
+
+/* out = s applied to in, over the interior of the grids */
+template <int Dim, int Radius>
+void apply(const Stencil<Dim, Radius>& s, const Grid<Dim, Radius>& in, Grid<Dim, Radius>& out)
+{
+  constexpr int np = Stencil<Dim, Radius>::npoints;
+  const auto off = detail::offsets<Dim, Radius>(in.stride());
+  const double* src = in.data();
+  double* dst = out.data();
+
+  detail::for_interior<0, Dim>(in.extent(), in.stride(), in.index({}),
+    [&](std::ptrdiff_t p) {
+      dst[p] = detail::sum(src + p, off, s.c, std::make_index_sequence<np>{});
+    });
+}
+
+/* as above, with the coefficients known at compile-time, e.g. apply<my_stencil>(in, out) */
+template <const auto& S, int Dim, int Radius>
+void apply(const Grid<Dim, Radius>& in, Grid<Dim, Radius>& out)
+{
+  constexpr int np = Stencil<Dim, Radius>::npoints;
+  static_assert(std::remove_reference_t<decltype(S)>::npoints == np,
+                "stencil and grid must have the same dimension and radius");
+  const auto off = detail::offsets<Dim, Radius>(in.stride());
+  const double* src = in.data();
+  double* dst = out.data();
+
+  detail::for_interior<0, Dim>(in.extent(), in.stride(), in.index({}),
+    [&](std::ptrdiff_t p) {
+      dst[p] = detail::sum<S>(src + p, off, std::make_index_sequence<np>{});
+    });
+}
+
+/*
+** Halo exchange for a Grid distributed over a cartesian communicator.
+**
+** Halos are exchanged one dimension at a time, and each message covers
+** the full extent of the grid, halos included, in the other dimensions.
+** So, by the time the last dimension is exchanged, the halos of the
+** earlier dimensions already hold their neighbours' values, and these are
+** passed on to fill the corners, e.g. in 2D:
+**
+**   after dimension 0:      after dimension 1:
+**
+**     . x x x x .             d x x x x d
+**     o o o o o o             o o o o o o
+**     o o o o o o             o o o o o o
+**     . x x x x .             d x x x x d
+**
+** Each face is described by an MPI subarray datatype, so no packing is
+** needed.  Halos on a non-periodic domain boundary are left untouched,
+** and can be used to hold boundary values.
+*/
+template <int Dim, int Radius>
+class HaloExchange {
+public:
+  HaloExchange(MPI_Comm cart, const Grid<Dim, Radius>& grid) : comm_(cart)
+  {
+    int sizes[Dim], subsizes[Dim], starts[Dim];
+
+    for (int d = 0; d < Dim; ++d)
+      MPI_Cart_shift(comm_, d, 1, &lo_[d], &hi_[d]);
+
+    for (int d = 0; d < Dim; ++d) {
+      for (int e = 0; e < Dim; ++e) {
+        sizes[e] = grid.storage_extent()[e];
+        subsizes[e] = (e == d) ? Radius : sizes[e];
+        starts[e] = 0;
+      }
+      const int n = grid.extent()[d];
+      starts[d] = Radius;               /* first interior layers */
+      make_type(sizes, subsizes, starts, &send_lo_[d]);
+      starts[d] = n;                    /* last interior layers */
+      make_type(sizes, subsizes, starts, &send_hi_[d]);
+      starts[d] = 0;                    /* low halo */
+      make_type(sizes, subsizes, starts, &recv_lo_[d]);
+      starts[d] = n + Radius;           /* high halo */
+      make_type(sizes, subsizes, starts, &recv_hi_[d]);
+    }
+  }
+
+  ~HaloExchange()
+  {
+    for (int d = 0; d < Dim; ++d) {
+      MPI_Type_free(&send_lo_[d]);
+      MPI_Type_free(&send_hi_[d]);
+      MPI_Type_free(&recv_lo_[d]);
+      MPI_Type_free(&recv_hi_[d]);
+    }
+  }
+
+  HaloExchange(const HaloExchange&) = delete;
+  HaloExchange& operator=(const HaloExchange&) = delete;
+
+  void exchange(Grid<Dim, Radius>& grid)
+  {
+    double* p = grid.data();
+    for (int d = 0; d < Dim; ++d) {
+      /* send to the low neighbour, receive from the high neighbour */
+      MPI_Sendrecv(p, 1, send_lo_[d], lo_[d], d,
+                   p, 1, recv_hi_[d], hi_[d], d, comm_, MPI_STATUS_IGNORE);
+      /* send to the high neighbour, receive from the low neighbour */
+      MPI_Sendrecv(p, 1, send_hi_[d], hi_[d], d,
+                   p, 1, recv_lo_[d], lo_[d], d, comm_, MPI_STATUS_IGNORE);
+    }
+  }
+
+private:
+  static void make_type(int* sizes, int* subsizes, int* starts, MPI_Datatype* type)
+  {
+    MPI_Type_create_subarray(Dim, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, type);
+    MPI_Type_commit(type);
+  }
+
+  MPI_Comm comm_;
+  int lo_[Dim], hi_[Dim];   /* neighbouring ranks in each dimension */
+  MPI_Datatype send_lo_[Dim], send_hi_[Dim], recv_lo_[Dim], recv_hi_[Dim];
+};
+
+} /* namespace stencil */
+
+#endif
@@ -0,0 +1,280 @@
+/*
+** Heat diffusion using the generic stencil engine in stencil.hpp.
+**
+** The same few lines of code run:
+**
+**   1d    - the 1D explicit scheme of openmp/example4/serial_heat.c
+**   5pt   - the 5-point heated plate of mpi/example5/skeleton2-heated-plate.c
+**   9pt   - the heated plate with a 9-point stencil, which needs corner halos
+**   4th   - the heated plate with a fourth order, radius 2, stencil
+**
+** on a grid distributed over a cartesian communicator.  Each case is run
+** twice, with compile-time and with run-time coefficients, and the result
+** is checked against a plain, serial loop over the whole grid.
+**
+** Usage: stencil_heat.exe <1d|5pt|9pt|4th> [n [steps]]
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mpi.h>
+
+#include "stencil.hpp"
+
+#define NX 100             /* 1d: grid points, as in serial_heat.c */
+#define NSTEPS 10000       /* 1d: timesteps, as in serial_heat.c */
+#define N2D 128            /* 2d: inner cells along each side of the plate */
+#define NSTEPS2D 1000      /* 2d: timesteps */
+#define MAXCHECK 1.0e9     /* largest n^dim * steps * points for the serial check */
+#define MASTER 0
+
+using stencil::Grid;
+using stencil::HaloExchange;
+using stencil::Stencil;
+
+/* the stencils, fixed at compile-time */
+static constexpr auto ftcs = stencil::heat<1>(0.5);      /* dt = 0.5 * dx^2, as in serial_heat.c */
+static constexpr auto five = stencil::heat<2>(0.25);     /* the Jacobi update of skeleton2 */
+static constexpr auto nine = stencil::heat9(0.25);
+static constexpr auto fourth = stencil::heat4<2>(0.15);
+
+/* boundary values: serial_heat.c in 1d, and the heated plate in 2d */
+template <int Dim>
+double boundary_value(int d, int side)
+{
+  if (Dim == 1)
+    return (side == 0) ? 1.0 : 10.0;
+  return (d == 0 && side == 0) ? 0.0 : 100.0;
+}
+
+/* initial value of the inner cells */
+template <int Dim>
+double initial_value()
+{
+  return (Dim == 1) ? 0.0 : 75.0;
+}
+
+int calc_nitems_from_rank(int rank, int size, int nitems)
+{
+  int n = nitems / size;
+  if (rank == size - 1)
+    n += nitems % size;    /* add remainder to last rank */
+  return n;
+}
+
+/*
+** Set every cell of a grid: inner cells to their initial value and halo
+** cells on the boundary of the domain to the boundary value.  If a halo
+** cell is outside the domain in more than one dimension, the first such
+** dimension wins (so the plate's corners are at 0, as in skeleton2).
+*/
+template <int Dim, int Radius>
+void initialise(Grid<Dim, Radius>& grid, const int* coords, const int* dims)
+{
+  const auto& ext = grid.storage_extent();
+  const auto& n = grid.extent();
+  std::ptrdiff_t total = grid.stride()[0] * ext[0];
+
+  for (std::ptrdiff_t p = 0; p < total; ++p) {
+    double value = initial_value<Dim>();
+    bool done = false;
+    std::ptrdiff_t rem = p;
+    for (int d = 0; d < Dim; ++d) {
+      int i = (int)(rem / grid.stride()[d]) - Radius;
+      rem %= grid.stride()[d];
+      if (done) continue;
+      if (i < 0 && coords[d] == 0) {
+        value = boundary_value<Dim>(d, 0);
+        done = true;
+      }
+      else if (i >= n[d] && coords[d] == dims[d] - 1) {
+        value = boundary_value<Dim>(d, 1);
+        done = true;
+      }
+    }
+    grid.data()[p] = value;
+  }
+}
+
+/*
+** The whole grid, stepped with a plain loop over every inner cell and
+** every coefficient: slow, but obviously correct.
+*/
+template <int Dim, int Radius>
+Grid<Dim, Radius> reference(const Stencil<Dim, Radius>& s, int n, int steps)
+{
+  std::array<int, Dim> extent;
+  int coords[Dim], dims[Dim];
+  for (int d = 0; d < Dim; ++d) {
+    extent[d] = n;
+    coords[d] = 0;
+    dims[d] = 1;
+  }
+  Grid<Dim, Radius> u(extent), w(extent);
+  initialise(u, coords, dims);
+  initialise(w, coords, dims);
+
+  const auto& ext = u.storage_extent();
+  std::ptrdiff_t total = u.stride()[0] * ext[0];
+  for (int step = 0; step < steps; ++step) {
+    for (std::ptrdiff_t p = 0; p < total; ++p) {
+      bool inner = true;
+      std::ptrdiff_t rem = p;
+      for (int d = 0; d < Dim; ++d) {
+        int i = (int)(rem / u.stride()[d]) - Radius;
+        rem %= u.stride()[d];
+        if (i < 0 || i >= n) inner = false;
+      }
+      if (!inner) continue;
+      double sum = 0.0;
+      for (int q = 0; q < Stencil<Dim, Radius>::npoints; ++q) {
+        std::ptrdiff_t off = 0;
+        for (int d = 0; d < Dim; ++d)
+          off += Stencil<Dim, Radius>::offset(q, d) * u.stride()[d];
+        sum += s.c[q] * u.data()[p + off];
+      }
+      w.data()[p] = sum;
+    }
+    u.swap(w);
+  }
+  return u;
+}
+
+/*
+** Run one case on the cartesian communicator, with compile-time
+** coefficients and then with run-time coefficients, timing both.
+*/
+template <const auto& S>
+void run(MPI_Comm cart, int n, int steps)
+{
+  constexpr int Dim = [] {
+    int d = 0;
+    while (stencil::ipow(S.width, d) < S.npoints) ++d;
+    return d;
+  }();
+  constexpr int Radius = (S.width - 1) / 2;
+
+  int rank, size;
+  int dims[Dim], periods[Dim], coords[Dim];
+  int start[Dim];
+  std::array<int, Dim> extent;
+  double tic, times[2], maxtime[2];
+  double diff = 0.0, maxdiff;
+  double sum = 0.0, mean;
+
+  MPI_Comm_rank(cart, &rank);
+  MPI_Comm_size(cart, &size);
+  MPI_Cart_get(cart, Dim, dims, periods, coords);
+  for (int d = 0; d < Dim; ++d) {
+    extent[d] = calc_nitems_from_rank(coords[d], dims[d], n);
+    start[d] = coords[d] * (n / dims[d]);
+    if (extent[d] < Radius) {
+      fprintf(stderr, "Error: too many processes:- local extent < stencil radius\n");
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+  }
+
+  Grid<Dim, Radius> u(extent), w(extent);
+  HaloExchange<Dim, Radius> halos(cart, u);
+
+  for (int pass = 0; pass < 2; ++pass) {
+    initialise(u, coords, dims);
+    initialise(w, coords, dims);
+    MPI_Barrier(cart);
+    tic = MPI_Wtime();
+    for (int step = 0; step < steps; ++step) {
+      halos.exchange(u);
+      if (pass == 0)
+        stencil::apply<S>(u, w);
+      else
+        stencil::apply(S, u, w);
+      u.swap(w);
+    }
+    times[pass] = MPI_Wtime() - tic;
+  }
+  MPI_Reduce(times, maxtime, 2, MPI_DOUBLE, MPI_MAX, MASTER, cart);
+
+  /* mean over the inner cells, and the largest difference from the plain loop */
+  bool check = std::pow((double)n, Dim) * steps * S.npoints <= MAXCHECK;
+  Grid<Dim, Radius> ref = check ? reference(S, n, steps) : Grid<Dim, Radius>(extent);
+  std::ptrdiff_t total = u.stride()[0] * u.storage_extent()[0];
+  for (std::ptrdiff_t p = 0; p < total; ++p) {
+    std::array<int, Dim> local, global;
+    bool inner = true;
+    std::ptrdiff_t rem = p;
+    for (int d = 0; d < Dim; ++d) {
+      local[d] = (int)(rem / u.stride()[d]) - Radius;
+      rem %= u.stride()[d];
+      global[d] = start[d] + local[d];
+      if (local[d] < 0 || local[d] >= extent[d]) inner = false;
+    }
+    if (!inner) continue;
+    sum += u.data()[p];
+    if (check)
+      diff = std::fmax(diff, std::fabs(u.data()[p] - ref(global)));
+  }
+  MPI_Reduce(&sum, &mean, 1, MPI_DOUBLE, MPI_SUM, MASTER, cart);
+  MPI_Reduce(&diff, &maxdiff, 1, MPI_DOUBLE, MPI_MAX, MASTER, cart);
+
+  if (rank == MASTER) {
+    double updates = std::pow((double)n, Dim) * steps;
+    mean /= std::pow((double)n, Dim);
+    printf("dimension %d, radius %d, %d points, %d ranks\n", Dim, Radius, S.npoints, size);
+    printf("grid: %d^%d inner cells, %d steps\n", n, Dim, steps);
+    printf("mean value:                   %f\n", mean);
+    if (check)
+      printf("max difference to plain loop: %g\n", maxdiff);
+    else
+      printf("max difference to plain loop: (skipped for large grids)\n");
+    printf("compile-time coefficients:    %f s (%.1f MLUP/s)\n", maxtime[0], updates / maxtime[0] / 1.0e6);
+    printf("run-time coefficients:        %f s (%.1f MLUP/s)\n", maxtime[1], updates / maxtime[1] / 1.0e6);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int rank, size;
+  int dims[2] = { 0, 0 };
+  int periods[2] = { 0, 0 };
+  int reorder = 0;
+  int ndims;
+  int n, steps;
+  MPI_Comm cart;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  if (argc < 2 || (strcmp(argv[1], "1d") && strcmp(argv[1], "5pt") &&
+                   strcmp(argv[1], "9pt") && strcmp(argv[1], "4th"))) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s <1d|5pt|9pt|4th> [n [steps]]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  ndims = strcmp(argv[1], "1d") ? 2 : 1;
+  n = (ndims == 1) ? NX - 2 : N2D;    /* serial_heat.c holds its boundaries in the grid */
+  steps = (ndims == 1) ? NSTEPS : NSTEPS2D;
+  if (argc > 2) n = atoi(argv[2]);
+  if (argc > 3) steps = atoi(argv[3]);
+
+  MPI_Dims_create(size, ndims, dims);
+  MPI_Cart_create(MPI_COMM_WORLD, ndims, dims, periods, reorder, &cart);
+
+  if (!strcmp(argv[1], "1d"))
+    run<ftcs>(cart, n, steps);
+  else if (!strcmp(argv[1], "5pt"))
+    run<five>(cart, n, steps);
+  else if (!strcmp(argv[1], "9pt"))
+    run<nine>(cart, n, steps);
+  else
+    run<fourth>(cart, n, steps);
+
+  MPI_Comm_free(&cart);
+  MPI_Finalize();
+
+  return EXIT_SUCCESS;
+}
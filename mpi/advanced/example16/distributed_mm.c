@@ -0,0 +1,400 @@
+/*
+** C = A B for n x n matrices distributed in blocks over a 2D cartesian
+** grid of processes, using either:
+**
+**   summa  - the Scalable Universal Matrix Multiply Algorithm: panels of A
+**            are broadcast along the rows of the grid and panels of B down
+**            its columns, with the broadcast of the next panel overlapping
+**            the multiply of the current one
+**   cannon - Cannon's algorithm, which needs a square grid: blocks of A
+**            shift left and blocks of B shift up around the grid
+**
+** Each process multiplies its pieces with the blocked DGEMM of
+** openmp/example4, or with a BLAS loaded at run-time.
+**
+** No process ever holds a whole matrix: every process generates its own
+** blocks of A and B from the global indices, and a sample of entries of C
+** is checked by recomputing them the same way.
+**
+** Usage: distributed_mm.exe <summa|cannon> [n [nb [kernel]]]
+**
+** where nb is the SUMMA panel width and kernel is blocked (the default) or
+** a BLAS backend, as for openmp/example4/serial_blas_mm.exe.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+#include "dgemm_blocked.h"
+#include "blas_loader.h"
+
+#define N 4096        /* default matrix size */
+#define NB 256        /* default SUMMA panel width */
+#define NCHECK 100    /* entries of C checked on each process */
+#define MASTER 0
+
+static int use_blas = 0;
+static blas_backend_t blas;
+
+int calc_nitems_from_rank(int rank, int size, int nitems);
+int calc_start_from_rank(int rank, int size, int nitems);
+int calc_owner(int index, int size, int nitems);
+double entry(int id, long i, long j);
+void local_mm(int m, int n, int k, const double* A, int lda, const double* B, int ldb,
+              double* C, int ldc);
+int start_panel(int k, int nb, int n, const int* dims, const int* coords,
+                const double* A, const double* B, double* Apanel, double* Bpanel,
+                MPI_Comm rowcomm, MPI_Comm colcomm, MPI_Request* requests);
+double summa(MPI_Comm cart, int n, int nb, const double* A, const double* B, double* C);
+double cannon(MPI_Comm cart, int n, double* A, double* B, double* C);
+
+int main(int argc, char* argv[])
+{
+  int rank, size;
+  int dims[2] = { 0, 0 };
+  int periods[2] = { 1, 1 };    /* cannon shifts around the grid */
+  int reorder = 0;
+  int coords[2];
+  int n = N, nb = NB;
+  int cannon_mode;
+  const char* kernel = "blocked";
+  MPI_Comm cart;
+
+  int mloc, nloc, kloc_a, kloc_b;
+  int row0, col0, ka0, kb0;
+  double *A, *B, *C;
+  int i, j, s;
+
+  double tic, elapsed, waiting, maxelapsed, maxwaiting;
+  double err, maxerr = 0.0, globalerr;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  if (argc < 2 || argc > 5 || (strcmp(argv[1], "summa") && strcmp(argv[1], "cannon"))) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s <summa|cannon> [n [nb [kernel]]]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  cannon_mode = !strcmp(argv[1], "cannon");
+  if (argc > 2) n = atoi(argv[2]);
+  if (argc > 3) nb = atoi(argv[3]);
+  if (argc > 4) kernel = argv[4];
+
+  MPI_Dims_create(size, 2, dims);
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, reorder, &cart);
+  MPI_Cart_coords(cart, rank, 2, coords);
+
+  if (n < dims[0] || n < dims[1] || nb < 1) {
+    if (rank == MASTER)
+      fprintf(stderr, "Error: need n >= %d and a positive panel width\n", dims[0] > dims[1] ? dims[0] : dims[1]);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  if (cannon_mode && (dims[0] != dims[1] || n % dims[0])) {
+    if (rank == MASTER)
+      fprintf(stderr, "Error: cannon needs a square number of processes (not %d) and n divisible by its root\n", size);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  if (strcmp(kernel, "blocked")) {
+    if (blas_load(kernel, &blas) != 0)
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    use_blas = 1;
+  }
+
+  /*
+  ** Rows of A and C, and of B, are split over the first dimension of the
+  ** grid; columns of B and C, and of A, over the second.
+  */
+  mloc = calc_nitems_from_rank(coords[0], dims[0], n);
+  row0 = calc_start_from_rank(coords[0], dims[0], n);
+  nloc = calc_nitems_from_rank(coords[1], dims[1], n);
+  col0 = calc_start_from_rank(coords[1], dims[1], n);
+  kloc_a = nloc;
+  ka0 = col0;
+  kloc_b = mloc;
+  kb0 = row0;
+
+  A = dgemm_alloc((long)mloc*kloc_a);
+  B = dgemm_alloc((long)kloc_b*nloc);
+  C = dgemm_alloc((long)mloc*nloc);
+
+  /* column-major local blocks */
+  for (j = 0; j < kloc_a; j++)
+    for (i = 0; i < mloc; i++)
+      A[i + (long)j*mloc] = entry(0, row0 + i, ka0 + j);
+  for (j = 0; j < nloc; j++)
+    for (i = 0; i < kloc_b; i++)
+      B[i + (long)j*kloc_b] = entry(1, kb0 + i, col0 + j);
+  for (i = 0; i < mloc*nloc; i++)
+    C[i] = 0.0;
+
+  MPI_Barrier(cart);
+  tic = MPI_Wtime();
+  if (cannon_mode)
+    waiting = cannon(cart, n, A, B, C);
+  else
+    waiting = summa(cart, n, nb, A, B, C);
+  elapsed = MPI_Wtime() - tic;
+
+  /* check a sample of our entries of C against a dot product of the generator */
+  srand(rank + 1);
+  for (s = 0; s < NCHECK; s++) {
+    long k;
+    double sum = 0.0;
+    i = rand() % mloc;
+    j = rand() % nloc;
+    for (k = 0; k < n; k++)
+      sum += entry(0, row0 + i, k) * entry(1, k, col0 + j);
+    err = fabs(C[i + (long)j*mloc] - sum) / fabs(sum);
+    if (err > maxerr) maxerr = err;
+  }
+
+  MPI_Reduce(&elapsed, &maxelapsed, 1, MPI_DOUBLE, MPI_MAX, MASTER, cart);
+  MPI_Reduce(&waiting, &maxwaiting, 1, MPI_DOUBLE, MPI_MAX, MASTER, cart);
+  MPI_Reduce(&maxerr, &globalerr, 1, MPI_DOUBLE, MPI_MAX, MASTER, cart);
+
+  if (rank == MASTER) {
+    printf("%s: C(%d,%d) = A(%d,%d) B(%d,%d) on a %dx%d grid, %s kernel\n",
+           cannon_mode ? "cannon" : "summa", n, n, n, n, n, n, dims[0], dims[1], kernel);
+    if (!cannon_mode)
+      printf("panel width: %d\n", nb);
+    printf("time: %fs (%.2f GFLOP/s, %.2f GFLOP/s per process)\n", maxelapsed,
+           2.0*n*n*(double)n / maxelapsed / 1.0e9, 2.0*n*n*(double)n / maxelapsed / 1.0e9 / size);
+    printf("longest wait for communication: %fs\n", maxwaiting);
+    printf("max relative error in %d sampled entries: %g\n", NCHECK*size, globalerr);
+  }
+
+  free(A);
+  free(B);
+  free(C);
+  MPI_Comm_free(&cart);
+  MPI_Finalize();
+
+  return EXIT_SUCCESS;
+}
+
+int calc_nitems_from_rank(int rank, int size, int nitems)
+{
+  int n = nitems / size;
+  if (rank == size - 1)
+    n += nitems % size;    /* add remainder to last rank */
+  return n;
+}
+
+int calc_start_from_rank(int rank, int size, int nitems)
+{
+  return rank * (nitems / size);
+}
+
+/* the rank which holds item index, under the distribution above */
+int calc_owner(int index, int size, int nitems)
+{
+  int owner = index / (nitems / size);
+  return (owner < size) ? owner : size - 1;
+}
+
+/* a reproducible pseudo-random value in [0,1) for entry (i,j) of matrix id */
+double entry(int id, long i, long j)
+{
+  unsigned long long z = ((unsigned long long)id << 62) + (unsigned long long)i * 0x9E3779B97F4A7C15ULL
+                         + (unsigned long long)j * 0xD1B54A32D192ED03ULL;
+
+  /* the splitmix64 finaliser */
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return (double)(z >> 11) / 9007199254740992.0;
+}
+
+/* C += A B, with the chosen kernel */
+void local_mm(int m, int n, int k, const double* A, int lda, const double* B, int ldb,
+              double* C, int ldc)
+{
+  if (m == 0 || n == 0 || k == 0)
+    return;
+  if (use_blas) {
+    char trans = 'N';
+    double one = 1.0;
+    blas.dgemm(&trans, &trans, &m, &n, &k, &one, A, &lda, B, &ldb, &one, C, &ldc);
+  }
+  else
+    dgemm_blocked(m, n, k, 1.0, A, lda, B, ldb, 1.0, C, ldc);
+}
+
+/*
+** Start the broadcasts of the SUMMA panels which begin at column (and row)
+** k: up to nb columns of A, from the process column that holds them, and
+** the same rows of B, from the process row that holds them.  The panel
+** stops short where it would cross from one process's block to the next.
+**
+** Returns the width of the panel.
+*/
+int start_panel(int k, int nb, int n, const int* dims, const int* coords,
+                const double* A, const double* B, double* Apanel, double* Bpanel,
+                MPI_Comm rowcomm, MPI_Comm colcomm, MPI_Request* requests)
+{
+  int mloc = calc_nitems_from_rank(coords[0], dims[0], n);
+  int nloc = calc_nitems_from_rank(coords[1], dims[1], n);
+  int acol = calc_owner(k, dims[1], n);
+  int brow = calc_owner(k, dims[0], n);
+  int aend = calc_start_from_rank(acol, dims[1], n) + calc_nitems_from_rank(acol, dims[1], n);
+  int bend = calc_start_from_rank(brow, dims[0], n) + calc_nitems_from_rank(brow, dims[0], n);
+  int kb = nb;
+  int i, j;
+
+  if (aend - k < kb) kb = aend - k;
+  if (bend - k < kb) kb = bend - k;
+
+  /* columns of A are contiguous; rows of B must be packed */
+  if (coords[1] == acol)
+    memcpy(Apanel, A + (long)(k - calc_start_from_rank(acol, dims[1], n))*mloc,
+           sizeof(double)*mloc*kb);
+  if (coords[0] == brow) {
+    int kb0 = calc_start_from_rank(brow, dims[0], n);
+    for (j = 0; j < nloc; j++)
+      for (i = 0; i < kb; i++)
+        Bpanel[i + (long)j*kb] = B[(k - kb0 + i) + (long)j*mloc];
+  }
+
+  MPI_Ibcast(Apanel, mloc*kb, MPI_DOUBLE, acol, rowcomm, &requests[0]);
+  MPI_Ibcast(Bpanel, kb*nloc, MPI_DOUBLE, brow, colcomm, &requests[1]);
+
+  return kb;
+}
+
+/*
+** SUMMA.  C is the sum over panels of k of A(:,panel) B(panel,:).  The
+** process column which holds a panel of A broadcasts it along each process
+** row, and the process row which holds the panel of B broadcasts it down
+** each process column.  With two buffers of each, the broadcasts of panel
+** t+1 are in flight while we multiply panel t.
+**
+** Returns the time spent waiting for the broadcasts.
+*/
+double summa(MPI_Comm cart, int n, int nb, const double* A, const double* B, double* C)
+{
+  int dims[2], periods[2], coords[2];
+  int remain[2];
+  MPI_Comm rowcomm, colcomm;
+  int mloc, nloc;
+  double *Apanel[2], *Bpanel[2];
+  MPI_Request requests[2][2];
+  int kstart[2], kwidth[2];
+  int k, next, t;
+  double tic, waiting = 0.0;
+
+  MPI_Cart_get(cart, 2, dims, periods, coords);
+  mloc = calc_nitems_from_rank(coords[0], dims[0], n);
+  nloc = calc_nitems_from_rank(coords[1], dims[1], n);
+
+  /* rowcomm joins the processes in a row of the grid, colcomm those in a column */
+  remain[0] = 0; remain[1] = 1;
+  MPI_Cart_sub(cart, remain, &rowcomm);
+  remain[0] = 1; remain[1] = 0;
+  MPI_Cart_sub(cart, remain, &colcomm);
+
+  for (t = 0; t < 2; t++) {
+    Apanel[t] = dgemm_alloc((long)mloc*nb);
+    Bpanel[t] = dgemm_alloc((long)nb*nloc);
+  }
+
+  kwidth[0] = start_panel(0, nb, n, dims, coords, A, B, Apanel[0], Bpanel[0],
+                          rowcomm, colcomm, requests[0]);
+  kstart[0] = 0;
+  t = 0;
+  for (k = 0; k < n; k = next) {
+    next = kstart[t] + kwidth[t];
+    if (next < n) {
+      kwidth[1 - t] = start_panel(next, nb, n, dims, coords, A, B, Apanel[1 - t], Bpanel[1 - t],
+                                  rowcomm, colcomm, requests[1 - t]);
+      kstart[1 - t] = next;
+    }
+
+    tic = MPI_Wtime();
+    MPI_Waitall(2, requests[t], MPI_STATUSES_IGNORE);
+    waiting += MPI_Wtime() - tic;
+
+    local_mm(mloc, nloc, kwidth[t], Apanel[t], mloc, Bpanel[t], kwidth[t], C, mloc);
+    t = 1 - t;
+  }
+
+  for (t = 0; t < 2; t++) {
+    free(Apanel[t]);
+    free(Bpanel[t]);
+  }
+  MPI_Comm_free(&rowcomm);
+  MPI_Comm_free(&colcomm);
+
+  return waiting;
+}
+
+/*
+** Cannon's algorithm on a q x q grid, with b x b blocks (b = n/q).  After
+** an initial skew, which shifts row i of A left by i and column j of B up
+** by j, the process at (i,j) holds A(i,i+j) and B(i+j,j).  Each of q steps
+** multiplies the blocks it holds and shifts A left and B up by one, so
+** that the next matching pair arrives.  The shifts for the next step are
+** in flight during the multiply.
+**
+** Returns the time spent waiting for the shifts.
+*/
+double cannon(MPI_Comm cart, int n, double* A, double* B, double* C)
+{
+  int dims[2], periods[2], coords[2];
+  int q, b, step;
+  int left, right, up, down;
+  int source, dest;
+  double *Anext, *Bnext, *tmp;
+  double *Aorig = A, *Borig = B;
+  MPI_Request requests[4];
+  double tic, waiting = 0.0;
+
+  MPI_Cart_get(cart, 2, dims, periods, coords);
+  q = dims[0];
+  b = n / q;
+
+  tic = MPI_Wtime();
+  MPI_Cart_shift(cart, 1, -coords[0], &source, &dest);
+  MPI_Sendrecv_replace(A, b*b, MPI_DOUBLE, dest, 0, source, 0, cart, MPI_STATUS_IGNORE);
+  MPI_Cart_shift(cart, 0, -coords[1], &source, &dest);
+  MPI_Sendrecv_replace(B, b*b, MPI_DOUBLE, dest, 1, source, 1, cart, MPI_STATUS_IGNORE);
+  waiting += MPI_Wtime() - tic;
+
+  /* data comes from the right and from below */
+  MPI_Cart_shift(cart, 1, -1, &right, &left);
+  MPI_Cart_shift(cart, 0, -1, &down, &up);
+
+  Anext = dgemm_alloc((long)b*b);
+  Bnext = dgemm_alloc((long)b*b);
+
+  for (step = 0; step < q; step++) {
+    int shift = (step < q - 1);
+    if (shift) {
+      MPI_Irecv(Anext, b*b, MPI_DOUBLE, right, 0, cart, &requests[0]);
+      MPI_Irecv(Bnext, b*b, MPI_DOUBLE, down, 1, cart, &requests[1]);
+      MPI_Isend(A, b*b, MPI_DOUBLE, left, 0, cart, &requests[2]);
+      MPI_Isend(B, b*b, MPI_DOUBLE, up, 1, cart, &requests[3]);
+    }
+
+    local_mm(b, b, b, A, b, B, b, C, b);
+
+    if (shift) {
+      tic = MPI_Wtime();
+      MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+      waiting += MPI_Wtime() - tic;
+      tmp = A; A = Anext; Anext = tmp;
+      tmp = B; B = Bnext; Bnext = tmp;
+    }
+  }
+
+  /* free our buffers, whichever of the pointers they ended up behind */
+  free((A == Aorig) ? Anext : A);
+  free((B == Borig) ? Bnext : B);
+
+  return waiting;
+}
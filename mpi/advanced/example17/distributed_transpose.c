@@ -0,0 +1,219 @@
+/*
+** B = A^T for an n x n matrix distributed in blocks of rows: each of the p
+** processes holds n/p whole rows of A, row-major, and ends up with the same
+** rows of B.  Block (r,s) of A, the n/p columns of rank r's rows that
+** belong to rank s, becomes block (s,r) of B, so this is one all-to-all
+** exchange plus a transpose of each block.  It is timed three ways:
+**
+**   copy     - MPI_Alltoall() of the same blocks, with no transpose at all:
+**              the bandwidth that the network and MPI library can give
+**   datatype - one MPI_Alltoall(), with derived datatypes that pick each
+**              block out of the rows of A and write it, transposed, into
+**              the rows of B, so there is no packing in our code
+**   packed   - each block is transposed into a contiguous send buffer with
+**              OpenMP, sent with a plain MPI_Alltoall() and copied from the
+**              receive buffer into the rows of B
+**
+** The bandwidth counts both the read and the write of every element of the
+** whole matrix, as in openmp/example4/omp_transpose.c.
+**
+** Usage: distributed_transpose.exe [n [repeats]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#define N 8192        /* default matrix size */
+#define REPEATS 5     /* timed runs of each variant; we keep the fastest */
+#define NB 32         /* tile size for the local transposes of packed */
+#define MASTER 0
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+#define NVARIANTS 3
+enum { COPY, DATATYPE, PACKED };
+static const char* names[NVARIANTS] = { "copy", "datatype", "packed" };
+
+void transpose_datatypes(int n, int nloc, MPI_Datatype* sendtype, MPI_Datatype* recvtype);
+void pack(int n, int nloc, int size, const double* A, double* sendbuf);
+void unpack(int n, int nloc, int size, const double* recvbuf, double* B);
+
+int main(int argc, char* argv[])
+{
+  int rank, size;
+  int n = N, repeats = REPEATS;
+  int nloc;
+  int variant, r;
+  long i, j, row0, errors, nerrors;
+
+  double *A, *B, *buf1, *buf2;
+  MPI_Datatype sendtype, recvtype;
+
+  double tic, elapsed, best, slowest, copy_time = 0.0;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  if (argc > 3) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s [n [repeats]]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  if (argc > 1) n = atoi(argv[1]);
+  if (argc > 2) repeats = atoi(argv[2]);
+  /* MPI_Alltoall() sends the same amount to everyone */
+  if (n < 1 || repeats < 1 || n % size) {
+    if (rank == MASTER)
+      fprintf(stderr, "Error: need positive repeats and n divisible by the %d processes\n", size);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  nloc = n / size;
+  row0 = (long)rank * nloc;
+
+  A = (double*)malloc(sizeof(double) * nloc * n);
+  B = (double*)malloc(sizeof(double) * nloc * n);
+  buf1 = (double*)malloc(sizeof(double) * nloc * n);
+  buf2 = (double*)malloc(sizeof(double) * nloc * n);
+  if (A == NULL || B == NULL || buf1 == NULL || buf2 == NULL) {
+    fprintf(stderr, "Error: rank %d could not allocate %d rows\n", rank, nloc);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  transpose_datatypes(n, nloc, &sendtype, &recvtype);
+
+  /* every entry is different, and a double holds it exactly */
+  for (i = 0; i < nloc; i++)
+    for (j = 0; j < n; j++)
+      A[i * n + j] = (double)((row0 + i) * n + j);
+
+  if (rank == MASTER) {
+    printf("B = A^T for A(%d,%d) in blocks of %d rows on %d processes, fastest of %d runs\n\n",
+           n, n, nloc, size, repeats);
+    printf("%-10s %12s %10s %10s\n", "variant", "time (s)", "GB/s", "vs copy");
+  }
+
+  for (variant = 0; variant < NVARIANTS; variant++) {
+    best = 0.0;
+    /* run 0 is the warm-up */
+    for (r = 0; r <= repeats; r++) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      tic = MPI_Wtime();
+      switch (variant) {
+      case COPY:
+        MPI_Alltoall(A, nloc * nloc, MPI_DOUBLE, buf1, nloc * nloc, MPI_DOUBLE, MPI_COMM_WORLD);
+        break;
+      case DATATYPE:
+        MPI_Alltoall(A, 1, sendtype, B, 1, recvtype, MPI_COMM_WORLD);
+        break;
+      case PACKED:
+        pack(n, nloc, size, A, buf1);
+        MPI_Alltoall(buf1, nloc * nloc, MPI_DOUBLE, buf2, nloc * nloc, MPI_DOUBLE, MPI_COMM_WORLD);
+        unpack(n, nloc, size, buf2, B);
+        break;
+      }
+      elapsed = MPI_Wtime() - tic;
+      /* a transpose is only done when the slowest process is */
+      MPI_Allreduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      if (r == 1 || (r > 1 && slowest < best)) best = slowest;
+    }
+    if (variant == COPY)
+      copy_time = best;
+
+    /* row i of B should be column i of A */
+    errors = 0;
+    if (variant != COPY) {
+      for (i = 0; i < nloc; i++)
+        for (j = 0; j < n; j++)
+          if (B[i * n + j] != (double)(j * n + row0 + i)) errors++;
+      for (i = 0; i < (long)nloc * n; i++)
+        B[i] = 0.0;
+    }
+    MPI_Reduce(&errors, &nerrors, 1, MPI_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+
+    if (rank == MASTER) {
+      printf("%-10s %12.6f %10.2f %10.2f", names[variant], best,
+             2.0 * sizeof(double) * n * n / best / 1.0e9, copy_time / best);
+      if (nerrors)
+        printf("   %ld WRONG ENTRIES", nerrors);
+      printf("\n");
+    }
+  }
+
+  MPI_Type_free(&sendtype);
+  MPI_Type_free(&recvtype);
+  free(A);
+  free(B);
+  free(buf1);
+  free(buf2);
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
+
+/*
+** The datatypes for MPI_Alltoall(A, 1, sendtype, B, 1, recvtype).
+**
+** sendtype is one nloc x nloc block of our rows of A, which is nloc runs of
+** nloc doubles, n apart.  recvtype walks the matching block of B down its
+** columns instead of along its rows: a column is nloc doubles n apart, and
+** the block is nloc of those, one double apart.  The elements arrive in
+** the order they were sent, so each row of the block of A lands in a
+** column of the block of B.
+**
+** MPI_Alltoall() finds the block for rank s at s times the extent of the
+** type, so both are resized to an extent of nloc doubles: the blocks sit
+** side by side along the rows.
+*/
+void transpose_datatypes(int n, int nloc, MPI_Datatype* sendtype, MPI_Datatype* recvtype)
+{
+  MPI_Datatype block, column, columns;
+  MPI_Aint lb, extent;
+
+  MPI_Type_get_extent(MPI_DOUBLE, &lb, &extent);
+
+  MPI_Type_vector(nloc, nloc, n, MPI_DOUBLE, &block);
+  MPI_Type_create_resized(block, 0, nloc * extent, sendtype);
+  MPI_Type_commit(sendtype);
+
+  MPI_Type_vector(nloc, 1, n, MPI_DOUBLE, &column);
+  MPI_Type_create_hvector(nloc, 1, extent, column, &columns);
+  MPI_Type_create_resized(columns, 0, nloc * extent, recvtype);
+  MPI_Type_commit(recvtype);
+
+  MPI_Type_free(&block);
+  MPI_Type_free(&column);
+  MPI_Type_free(&columns);
+}
+
+/*
+** Transpose block s of our rows of A into the s-th nloc x nloc piece of the
+** send buffer, in tiles so that both sides stay in cache.  Row c of the
+** piece is column s*nloc + c of A, which is row c of rank s's part of B.
+*/
+void pack(int n, int nloc, int size, const double* A, double* sendbuf)
+{
+  int s, ii, cc, i, c;
+
+#pragma omp parallel for collapse(3) schedule(static) private(i, c)
+  for (s = 0; s < size; s++)
+    for (cc = 0; cc < nloc; cc += NB)
+      for (ii = 0; ii < nloc; ii += NB)
+        for (c = cc; c < MIN(cc + NB, nloc); c++)
+          for (i = ii; i < MIN(ii + NB, nloc); i++)
+            sendbuf[(long)s * nloc * nloc + (long)c * nloc + i] = A[(long)i * n + (long)s * nloc + c];
+}
+
+/* the piece from rank s holds columns s*nloc... of our rows of B, row by row */
+void unpack(int n, int nloc, int size, const double* recvbuf, double* B)
+{
+  int s, i, c;
+
+#pragma omp parallel for collapse(2) schedule(static) private(c)
+  for (s = 0; s < size; s++)
+    for (i = 0; i < nloc; i++)
+      for (c = 0; c < nloc; c++)
+        B[(long)i * n + (long)s * nloc + c] = recvbuf[(long)s * nloc * nloc + (long)i * nloc + c];
+}
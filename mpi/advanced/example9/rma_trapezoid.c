@@ -7,6 +7,8 @@
 ** determined by the number (N) of trapezoids we use in 
 ** the estimation.
 ** In this case we've hardwired a, b, N, and f(x).
+** The sum itself is done by the integration library in ../../integrate,
+** which has other rules too.
 **
 ** This example works in parallel, using 'one-sided'
 ** (remote memory access) MPI comms.  It also takes
@@ -16,21 +18,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <inttypes.h>
 #include "mpi.h"
+#include "integrate.h"
+#include "partition.h"
 
 #define sqr(x)((x)*(x))
 #define MASTER 0
 
 /* function prototypes */
-double f(double x);  /* the function that we are integrating */
-double trapezoid(double local_a, double local_b, int local_n, double width);
+double f(double x, void* data);  /* the function that we are integrating */
 
 int main(int argc, char** argv) {
 
   int rank;           /* process rank */
   int size;           /* number of processes */
-  int total_n;        /* total number of trapezoids to evaluate */
-  int local_n;        /* number of trapezoids evaluated by each process */
+  int64_t total_n;    /* total number of trapezoids to evaluate */
+  int64_t local_n;    /* number of trapezoids evaluated by this process */
+  partition_t mine;   /* which of the total_n trapezoids they are */
 
   MPI_Win n_win, integral_win;  /* RMA windows */
 
@@ -42,6 +47,9 @@ int main(int argc, char** argv) {
   double local_b;     /* right endpoint for local chunk */
   double width;       /* width of each trapezoid - same for all proceses*/
 
+  integrand_t integrand_f = integrand(f, NULL);  /* f, as the integration library wants it */
+  quadrature_t trapezoid = { INTEGRATE_TRAPEZOID, 0 };
+
   double PI25DT = 3.141592653589793238462643;
 
   MPI_Init(&argc, &argv);
@@ -55,7 +63,7 @@ int main(int argc, char** argv) {
   ** belonging to the master process is put into a window.
   */
   if (rank == MASTER) {
-    MPI_Win_create(&total_n, sizeof(int), 1, MPI_INFO_NULL,
+    MPI_Win_create(&total_n, sizeof(total_n), 1, MPI_INFO_NULL,
 		   MPI_COMM_WORLD, &n_win);
     MPI_Win_create(&integral, sizeof(double), 1, MPI_INFO_NULL,
 		   MPI_COMM_WORLD, &integral_win);
@@ -73,8 +81,9 @@ int main(int argc, char** argv) {
       printf("\n(1) Usage: rma_trapezoid.exe <num_trapezoids>\n");
       MPI_Abort(MPI_COMM_WORLD,1);
     }
-    sscanf(argv[1],"%d",&total_n);
-    if (total_n == 0) {
+    /* 64 bits, as there can be more than 2^31 trapezoids */
+    total_n = strtoll(argv[1], NULL, 10);
+    if (total_n < 1) {
       MPI_Abort(MPI_COMM_WORLD,0);
     }
   }
@@ -86,26 +95,34 @@ int main(int argc, char** argv) {
   */
   MPI_Win_fence(0,n_win);  
   if (rank != MASTER) {
-    MPI_Get(&total_n, 1, MPI_INT, MASTER, 0, 1, MPI_INT, n_win);
+    MPI_Get(&total_n, 1, MPI_INT64_T, MASTER, 0, 1, MPI_INT64_T, n_win);
   }
   MPI_Win_fence(0,n_win);
 
   /* width is the same for all trapezoids, on all procs */
   width = (b - a)/(double)total_n;
 
-  /* how many trapezoids per process? */
-  local_n = total_n/size;
+  /*
+  ** How many trapezoids per process?  The first total_n%size processes
+  ** get one more than the rest, so none are left out.
+  */
+  mine = partition(total_n, size, rank);
+  local_n = partition_count(mine);
 
-  printf("rank %d:\tlocal_n %d\n", rank, local_n);
+  printf("rank %d:\tlocal_n %" PRId64 "\n", rank, local_n);
 
   /* calculate local interals to work on */
-  local_a = a + (rank * (local_n * width));  /* since each local interval is (local_n * width) */
-  local_b = local_a + (local_n * width);
+  local_a = a + mine.first*width;
+  local_b = a + mine.last*width;
 
   printf("rank %d:\tlocal_a %f, local_b %f\n", rank, local_a, local_b);
 
-  /* local trapezoid calculations are bundled into a function */ 
-  local_sum = trapezoid(local_a,local_b, local_n, width);
+  /*
+  ** The local trapezoid calculations are done by the integration library
+  ** in ../../integrate: our trapezoids are numbers mine.first to
+  ** mine.last - 1 of the total_n.
+  */
+  local_sum = integrate_panels(&integrand_f, trapezoid, a, b, total_n, mine.first, mine.last);
 
   printf("rank %d:\tlocal_sum %f\n", rank, local_sum);
 
@@ -121,7 +138,7 @@ int main(int argc, char** argv) {
   /* print the result */
   if (rank == MASTER) {
     printf("\n");
-    printf("Definite integral from %f to %f estimated as %f (using %d trapezoids)\n",
+    printf("Definite integral from %f to %f estimated as %f (using %" PRId64 " trapezoids)\n",
 	   a, b, integral, total_n);
     printf("(error: %.16f)\n",fabs(integral - PI25DT));
   }
@@ -135,28 +152,7 @@ int main(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
-double trapezoid(double local_a, double local_b, int local_n, double width) {
-
-  double local_sum;   /* result of (local) integration */
-  double x;           /* point in the range [a,b] */
-  int ii;
-
-  /* the first two elements in our series */
-  local_sum = (f(local_a) + f(local_b))/2.0;
-
-  /* loop over the rest */ 
-  x = local_a;
-  for (ii=1; ii<local_n; ii++) {
-    x += width;
-    local_sum += f(x);
-  }
-  /* don't forget the final multiplier */
-  local_sum *= width;
-
-  return local_sum;
-}
-
 /* definite integral of this will estimate pi */
-double f(double x) {
+double f(double x, void* data) {
   return 4.0 / (1 + sqr(x));
 }
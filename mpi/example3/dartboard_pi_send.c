@@ -19,19 +19,27 @@
 ** with a ratio of dart counts, i.e. a count of the darts which 
 ** fell inside the cicrle over a count of those which fell inside
 ** the square (all of them).
+**
+** The random numbers come from Philox (../montecarlo/philox.h), with a
+** stream of its own for each rank.  srand(rank) and rand() would give each
+** rank a shifted copy of one sequence, from a global state behind a lock.
 */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 #include "mpi.h"
+#include "philox.h"
 
 #define NDARTS 5000    /* number of throws at dartboard */
 #define ROUNDS 10       /* number of times we throw NDARTS */
 #define MASTER 0        /* task ID of master task */
+#define SEED 20240607   /* seed of the random number streams */
 
 double throw_darts (int nthrows);
 
+static philox_t rng;     /* this task's random number stream */
+
 #define sqr(x)((x)*(x))
 
 int main(int argc, char **argv) 
@@ -44,7 +52,7 @@ int main(int argc, char **argv)
   double pisum;           /* sum of workers pi values */
   double PI25DT = 3.141592653589793238462643;
 
-  int rank;               /* task ID - also used as seed number */
+  int rank;               /* task ID - also used as stream number */
   int nproc;              /* number of tasks */
   int tag;                /* message tag */
   int i;
@@ -57,8 +65,8 @@ int main(int argc, char **argv)
   MPI_Comm_rank(MPI_COMM_WORLD, &rank); 
   MPI_Comm_size(MPI_COMM_WORLD, &nproc);
 
-  /* Set seed for random number generator equal to rank */
-  srand (rank);
+  /* Give each task its own random number stream */
+  rng = philox_init(SEED, philox_stream_id(rank, 0));
 
   avepi = 0;
 
@@ -116,9 +124,9 @@ double throw_darts(int nthrows)
   /* "throw darts at board" */
   for (n = 1; n <= nthrows; n++) {
     /* generate random numbers for x and y coordinates */
-    r = (double)rand()/RAND_MAX;
+    r = philox_uniform(&rng);
     x_coord = (2.0 * r) - 1.0;
-    r = (double)rand()/RAND_MAX;
+    r = philox_uniform(&rng);
     y_coord = (2.0 * r) - 1.0;
     
     /* if dart lands in circle, increment score */
@@ -7,6 +7,8 @@
 ** determined by the number (N) of trapezoids we use in 
 ** the estimation.
 ** In this case we've hardwired a, b, N, and f(x).
+** The sum itself is done by the integration library in ../integrate,
+** which has other rules too.
 **
 ** This example works in parallel.
 */
@@ -15,14 +17,14 @@
 #include <stdlib.h>
 #include <math.h>
 #include "mpi.h"
+#include "integrate.h"
 
 #define sqr(x)((x)*(x))
 #define N 15
 #define MASTER 0
 
 /* function prototypes */
-double f(double x);  /* the function that we are integrating */
-double trapezoid(double local_a, double local_b, int local_n, double width);
+double f(double x, void* data);  /* the function that we are integrating */
 
 int main(int argc, char** argv) {
 
@@ -42,6 +44,9 @@ int main(int argc, char** argv) {
   double local_b;     /* right endpoint for local chunk */
   double width;       /* width of each trapezoid - same for all proceses*/
 
+  integrand_t integrand_f = integrand(f, NULL);  /* f, as the integration library wants it */
+  quadrature_t trapezoid = { INTEGRATE_TRAPEZOID, 0 };
+
   double PI25DT = 3.141592653589793238462643;
 
   MPI_Init(&argc, &argv);
@@ -67,8 +72,13 @@ int main(int argc, char** argv) {
 
   printf("rank %d:\tlocal_a %f, local_b %f\n", rank, local_a, local_b);
 
-  /* local trapezoid calculations are bundled into a function */ 
-  local_sum = trapezoid(local_a,local_b, local_n, width);
+  /*
+  ** The local trapezoid calculations are done by the integration library
+  ** in ../integrate: our trapezoids are numbers rank*local_n to
+  ** (rank+1)*local_n - 1 of the N.
+  */
+  local_sum = integrate_panels(&integrand_f, trapezoid, a, b, N,
+                               rank*local_n, (rank + 1)*local_n);
 
   printf("rank %d:\tlocal_sum %f\n", rank, local_sum);
 
@@ -97,28 +107,7 @@ int main(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
-double trapezoid(double local_a, double local_b, int local_n, double width) {
-
-  double local_sum;   /* result of (local) integration */
-  double x;           /* point in the range [a,b] */
-  int ii;
-
-  /* the first two elements in our series */
-  local_sum = (f(local_a) + f(local_b))/2.0;
-
-  /* loop over the rest */ 
-  x = local_a;
-  for (ii=1; ii<local_n; ii++) {
-    x += width;
-    local_sum += f(x);
-  }
-  /* don't forget the final multiplier */
-  local_sum *= width;
-
-  return local_sum;
-}
-
 /* definite integral of this will estimate pi */
-double f(double x) {
+double f(double x, void* data) {
   return 4.0 / (1 + sqr(x));
 }
@@ -7,6 +7,8 @@
 ** determined by the number (N) of trapezoids we use in 
 ** the estimation.
 ** In this case we've hardwired a, b, N, and f(x).
+** The sum itself is done by the integration library in ../integrate,
+** which has other rules too.
 **
 ** This example works in parallel, using MPI_Reduce,
 ** rather than each process calling MPI_Send back the MASTER.
@@ -15,21 +17,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <inttypes.h>
 #include "mpi.h"
+#include "integrate.h"
+#include "partition.h"
 
 #define sqr(x)((x)*(x))
 #define N 15
 #define MASTER 0
 
 /* function prototypes */
-double f(double x);  /* the function that we are integrating */
-double trapezoid(double local_a, double local_b, int local_n, double width);
+double f(double x, void* data);  /* the function that we are integrating */
 
 int main(int argc, char** argv) {
 
   int rank;           /* process rank */
   int nprocs;         /* number of processes */
-  int local_n;        /* number of trapezoids evaluated by each process */
+  int64_t local_n;    /* number of trapezoids evaluated by this process */
+  partition_t mine;   /* which of the N trapezoids they are */
 
   double integral;    /* where we'll store the result of the integration */
   double local_sum;   /* local portion of the integration summation */
@@ -39,33 +44,40 @@ int main(int argc, char** argv) {
   double local_b;     /* right endpoint for local chunk */
   double width;       /* width of each trapezoid - same for all proceses*/
 
+  integrand_t integrand_f = integrand(f, NULL);  /* f, as the integration library wants it */
+  quadrature_t trapezoid = { INTEGRATE_TRAPEZOID, 0 };
+
   double PI25DT = 3.141592653589793238462643;
 
   MPI_Init(&argc, &argv);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
 
-  if (nprocs != N) {
-    fprintf(stderr,"Error: wrong number of processes (use %d processes)\n", N);
-    MPI_Abort(MPI_COMM_WORLD,1);
-  }
-
   /* width is the same for all trapezoids, on all procs */
   width = (b - a)/(double)N;
 
-  /* how many trapezoids per process? */
-  local_n = N/nprocs;
+  /*
+  ** How many trapezoids per process?  Any number of processes will do:
+  ** the first N%nprocs processes get one more than the rest (and if
+  ** there are more processes than trapezoids, some get none).
+  */
+  mine = partition(N, nprocs, rank);
+  local_n = partition_count(mine);
 
-  printf("rank %d:\tlocal_n %d\n", rank, local_n);
+  printf("rank %d:\tlocal_n %" PRId64 "\n", rank, local_n);
 
   /* calculate local interals to work on */
-  local_a = a + (rank * (local_n * width));  /* since each local interval is (local_n * width) */
-  local_b = local_a + (local_n * width);
+  local_a = a + mine.first*width;
+  local_b = a + mine.last*width;
 
   printf("rank %d:\tlocal_a %f, local_b %f\n", rank, local_a, local_b);
 
-  /* local trapezoid calculations are bundled into a function */ 
-  local_sum = trapezoid(local_a,local_b, local_n, width);
+  /*
+  ** The local trapezoid calculations are done by the integration library
+  ** in ../integrate: our trapezoids are numbers mine.first to
+  ** mine.last - 1 of the N.
+  */
+  local_sum = integrate_panels(&integrand_f, trapezoid, a, b, N, mine.first, mine.last);
 
   printf("rank %d:\tlocal_sum %f\n", rank, local_sum);
 
@@ -89,28 +101,7 @@ int main(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
-double trapezoid(double local_a, double local_b, int local_n, double width) {
-
-  double local_sum;   /* result of (local) integration */
-  double x;           /* point in the range [a,b] */
-  int ii;
-
-  /* the first two elements in our series */
-  local_sum = (f(local_a) + f(local_b))/2.0;
-
-  /* loop over the rest */ 
-  x = local_a;
-  for (ii=1; ii<local_n; ii++) {
-    x += width;
-    local_sum += f(x);
-  }
-  /* don't forget the final multiplier */
-  local_sum *= width;
-
-  return local_sum;
-}
-
 /* definite integral of this will estimate pi */
-double f(double x) {
+double f(double x, void* data) {
   return 4.0 / (1 + sqr(x));
 }
@@ -0,0 +1,126 @@
+/*
+** The trapezoid rule for pi, as in ../example6/reduce_trapezoid.c, but for
+** as many trapezoids as you like, on as many processes and threads as you
+** like.
+**
+** The n trapezoids are shared out between the MPI processes, and each
+** process's share between its OpenMP threads, with partition.h: counts are
+** 64-bit and the remainders are spread out, so any n works with any number
+** of processes and threads.  Each thread adds up its trapezoids with
+** integrate_panels(), and the processes' sums are combined with any of the
+** strategies of reduce_strategy.h (MPI_Reduce() by default).
+**
+** We check that the shares add up to n and report the spread of the
+** shares, the time of the slowest process and the rate in trapezoids per
+** second.
+**
+** Usage: hybrid_trapezoid.exe [n [strategy]]     (n may be written as e.g. 1e11)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <mpi.h>
+#include <omp.h>
+
+#include "integrate.h"
+#include "partition.h"
+#include "reduce_strategy.h"
+
+#define N 1e10
+#define MAX_N 4e18   /* well inside an int64_t */
+#define MASTER 0
+
+/* definite integral of this will estimate pi */
+void pi_batch(long n, const double* x, double* fx, void* data)
+{
+  long i;
+
+#pragma omp simd
+  for (i = 0; i < n; i++)
+    fx[i] = 4.0 / (1.0 + x[i]*x[i]);
+}
+
+int main(int argc, char* argv[])
+{
+  int rank, size, nthreads;
+  int64_t n;                  /* total number of trapezoids */
+  int64_t local_n;            /* number of trapezoids on this process */
+  int64_t total_n;            /* the sum of local_n over the processes */
+  int64_t min_n, max_n;       /* the smallest and largest local_n */
+  partition_t mine;           /* the trapezoids of this process */
+  double requested = N;
+  double a = 0.0, b = 1.0;
+  double local_sum = 0.0, integral;
+  double tic, toc, elapsed;
+  int provided;
+  int strategy = REDUCE_REDUCE;
+  reduce_t reduce;
+
+  integrand_t pi_f = integrand_batch(pi_batch, NULL);
+  quadrature_t trapezoid = { INTEGRATE_TRAPEZOID, 0 };
+
+  double PI25DT = 3.141592653589793238462643;
+
+  /* only the master thread makes MPI calls */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (argc > 1) requested = atof(argv[1]);
+  if (argc > 2) strategy = reduce_strategy_find(argv[2]);
+  if (argc > 3 || strategy < 0 || requested < 1.0 || requested > MAX_N || requested != floor(requested)) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s [n [linear|reduce|accumulate|binomial|doubling|ireduce]]\n",
+              argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  n = (int64_t)requested;
+  nthreads = omp_get_max_threads();
+  reduce = reduce_init(strategy, MASTER, MPI_COMM_WORLD);
+
+  /* our share of the trapezoids */
+  mine = partition(n, size, rank);
+  local_n = partition_count(mine);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = MPI_Wtime();
+
+  /* and each thread's share of ours */
+#pragma omp parallel reduction(+:local_sum)
+  {
+    partition_t ours = partition_range(mine, omp_get_num_threads(), omp_get_thread_num());
+    local_sum += integrate_panels(&pi_f, trapezoid, a, b, n, ours.first, ours.last);
+  }
+
+  integral = reduce_sum(&reduce, local_sum);
+  toc = MPI_Wtime() - tic;
+
+  /* every trapezoid should be counted once, and the shares within one of each other */
+  MPI_Reduce(&toc, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(&local_n, &total_n, 1, MPI_INT64_T, MPI_SUM, MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(&local_n, &min_n, 1, MPI_INT64_T, MPI_MIN, MASTER, MPI_COMM_WORLD);
+  MPI_Reduce(&local_n, &max_n, 1, MPI_INT64_T, MPI_MAX, MASTER, MPI_COMM_WORLD);
+
+  if (rank == MASTER) {
+    printf("%d processes x %d threads, %" PRId64 " trapezoids, %s\n", size, nthreads, n,
+           reduce_strategy_name(strategy));
+    printf("trapezoids per process: %" PRId64 " to %" PRId64 " (%" PRId64 " in all)\n",
+           min_n, max_n, total_n);
+    if (total_n != n) {
+      fprintf(stderr, "Error: the shares add up to %" PRId64 " trapezoids, not %" PRId64 "\n",
+              total_n, n);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    printf("\nDefinite integral from %f to %f estimated as %.16f\n", a, b, integral);
+    printf("(error: %.3e)\n", fabs(integral - PI25DT));
+    printf("time %.3f s, %.3e trapezoids/s, %.3e per thread\n", elapsed, n/elapsed,
+           n/elapsed/((double)size*nthreads));
+  }
+
+  reduce_free(&reduce);
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+/*
+** Numerical integration rules.  See integrate.h.
+**
+** Build with -fopenmp for the _omp versions; without it, they run on one
+** thread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "integrate.h"
+#include "partition.h"
+
+#define BATCH 512         /* points evaluated in one go */
+#define MAX_DEPTH 50      /* adaptive Simpson gives up halving here */
+#define TASK_DEPTH 8      /* ... and makes tasks above this depth */
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+integrand_t integrand(integrand_fn f, void* data)
+{
+  integrand_t g;
+
+  g.f = f;
+  g.batch = NULL;
+  g.data = data;
+  return g;
+}
+
+integrand_t integrand_batch(integrand_batch_fn batch, void* data)
+{
+  integrand_t g;
+
+  g.f = NULL;
+  g.batch = batch;
+  g.data = data;
+  return g;
+}
+
+/* fx[i] = f(x[i]), whichever way f is given */
+static void evaluate(const integrand_t* f, long n, const double* x, double* fx)
+{
+  long i;
+
+  if (f->batch != NULL)
+    f->batch(n, x, fx, f->data);
+  else
+    for (i = 0; i < n; i++)
+      fx[i] = f->f(x[i], f->data);
+}
+
+static double evaluate1(const integrand_t* f, double x)
+{
+  double fx;
+
+  evaluate(f, 1, &x, &fx);
+  return fx;
+}
+
+/* sum of w[i]*fx[i], which vectorises */
+static double dot(long n, const double* w, const double* fx)
+{
+  double sum = 0.0;
+  long i;
+
+#pragma omp simd reduction(+:sum)
+  for (i = 0; i < n; i++)
+    sum += w[i]*fx[i];
+  return sum;
+}
+
+static void check_quadrature(quadrature_t q)
+{
+  if (q.rule < INTEGRATE_TRAPEZOID || q.rule > INTEGRATE_GAUSS ||
+      (q.rule == INTEGRATE_GAUSS && (q.order < 1 || q.order > INTEGRATE_MAX_ORDER))) {
+    fprintf(stderr, "Error: unknown quadrature rule %d (order %d)\n", q.rule, q.order);
+    exit(EXIT_FAILURE);
+  }
+}
+
+const char* quadrature_name(quadrature_t q)
+{
+  static char names[INTEGRATE_MAX_ORDER + 1][16];
+
+  check_quadrature(q);
+  if (q.rule == INTEGRATE_TRAPEZOID)
+    return "trapezoid";
+  if (q.rule == INTEGRATE_SIMPSON)
+    return "simpson";
+  snprintf(names[q.order], sizeof(names[q.order]), "gauss-%d", q.order);
+  return names[q.order];
+}
+
+int64_t quadrature_evals(quadrature_t q, int64_t n)
+{
+  check_quadrature(q);
+  if (q.rule == INTEGRATE_TRAPEZOID)
+    return n + 1;
+  if (q.rule == INTEGRATE_SIMPSON)
+    return 2*n + 1;
+  return q.order*n;
+}
+
+/* P_order(x), by the three-term recurrence, and its derivative */
+static void legendre(int order, double x, double* p, double* dp)
+{
+  double p0 = 1.0, p1 = x, p2;
+  int j;
+
+  for (j = 2; j <= order; j++) {
+    p2 = ((2*j - 1)*x*p1 - (j - 1)*p0)/j;
+    p0 = p1;
+    p1 = p2;
+  }
+  *p = p1;
+  *dp = order*(x*p1 - p0)/(x*x - 1.0);
+}
+
+/*
+** The points t and weights w of the order-point Gauss-Legendre rule on
+** [-1,1]: the roots of P_order, found by Newton's method from the
+** Chebyshev points, which are close to them.
+*/
+static void gauss_legendre(int order, double* t, double* w)
+{
+  int i, iter;
+  double x, p, dp;
+
+  for (i = 0; i < order; i++) {
+    x = cos(M_PI*(i + 0.75)/(order + 0.5));
+    for (iter = 0; iter < 100; iter++) {
+      legendre(order, x, &p, &dp);
+      x -= p/dp;
+      if (fabs(p/dp) < 1e-16) break;
+    }
+    legendre(order, x, &p, &dp);
+    t[i] = x;
+    w[i] = 2.0/((1.0 - x*x)*dp*dp);
+  }
+}
+
+/*
+** Each rule is a weighted sum of f at some points.  The points are made a
+** batch at a time, from their index rather than by adding up widths, so
+** that rounding errors do not build up along a long run of panels.
+*/
+double integrate_panels(const integrand_t* f, quadrature_t q, double a, double b, int64_t n,
+                        int64_t first, int64_t last)
+{
+  double x[BATCH], fx[BATCH], w[BATCH];
+  double h = (b - a)/n;
+  double sum = 0.0;
+  int64_t i0;
+  long i, count;
+
+  check_quadrature(q);
+  if (first >= last)
+    return 0.0;
+
+  if (q.rule == INTEGRATE_TRAPEZOID || q.rule == INTEGRATE_SIMPSON) {
+    /*
+    ** The ends of the panels, first to last.  Each has weight 1 (trapezoid)
+    ** or 2 (Simpson, in sixths), as it is shared by two panels, except the
+    ** two at the ends of our run.
+    */
+    double wend = (q.rule == INTEGRATE_TRAPEZOID) ? 1.0 : 2.0;
+    for (i0 = first; i0 <= last; i0 += BATCH) {
+      count = MIN(BATCH, last - i0 + 1);
+      for (i = 0; i < count; i++) {
+        x[i] = (i0 + i == n) ? b : a + (i0 + i)*h;
+        w[i] = wend;
+      }
+      if (i0 == first) w[0] = wend/2;
+      if (i0 + count - 1 == last) w[count - 1] = wend/2;
+      evaluate(f, count, x, fx);
+      sum += dot(count, w, fx);
+    }
+    if (q.rule == INTEGRATE_TRAPEZOID)
+      return sum*h;
+
+    /* and the middles of the panels, with weight 4 */
+    for (i0 = first; i0 < last; i0 += BATCH) {
+      count = MIN(BATCH, last - i0);
+      for (i = 0; i < count; i++) {
+        x[i] = a + (i0 + i + 0.5)*h;
+        w[i] = 4.0;
+      }
+      evaluate(f, count, x, fx);
+      sum += dot(count, w, fx);
+    }
+    return sum*h/6.0;
+  }
+  else {
+    /* whole panels at a time, each with the Gauss-Legendre points */
+    double t[INTEGRATE_MAX_ORDER], wt[INTEGRATE_MAX_ORDER];
+    long panels = BATCH/q.order;
+    int64_t p;
+    long np;
+    int j;
+
+    gauss_legendre(q.order, t, wt);
+    for (p = first; p < last; p += panels) {
+      np = MIN(panels, last - p);
+      for (i = 0; i < np; i++)
+        for (j = 0; j < q.order; j++) {
+          x[i*q.order + j] = a + (p + i + 0.5*(1.0 + t[j]))*h;
+          w[i*q.order + j] = 0.5*wt[j];
+        }
+      evaluate(f, np*q.order, x, fx);
+      sum += dot(np*q.order, w, fx);
+    }
+    return sum*h;
+  }
+}
+
+double integrate(const integrand_t* f, quadrature_t q, double a, double b, int64_t n)
+{
+  return integrate_panels(f, q, a, b, n, 0, n);
+}
+
+double integrate_omp_panels(const integrand_t* f, quadrature_t q, double a, double b, int64_t n,
+                            int64_t first, int64_t last)
+{
+  partition_t all = { first, last };
+  double sum = 0.0;
+
+  check_quadrature(q);
+  if (first >= last)
+    return 0.0;
+
+#pragma omp parallel reduction(+:sum)
+  {
+    int t = 0, nt = 1;
+    partition_t mine;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+    nt = omp_get_num_threads();
+#endif
+    mine = partition_range(all, nt, t);
+    sum += integrate_panels(f, q, a, b, n, mine.first, mine.last);
+  }
+
+  return sum;
+}
+
+double integrate_omp(const integrand_t* f, quadrature_t q, double a, double b, int64_t n)
+{
+  return integrate_omp_panels(f, q, a, b, n, 0, n);
+}
+
+/*
+** Simpson's rule on [a,b] is whole; on each half it is left and right.
+** Their difference is 15 times the error of left + right, near enough, so
+** if that is small we are done (and adding diff/15 makes the answer exact
+** for quintics); otherwise each half gets half the tolerance.
+*/
+static double adaptive(const integrand_t* f, double a, double b, double fa, double fm, double fb,
+                       double whole, double tol, int depth, int64_t* evals)
+{
+  double m = 0.5*(a + b);
+  double flm = evaluate1(f, 0.5*(a + m));
+  double frm = evaluate1(f, 0.5*(m + b));
+  double left = (m - a)/6.0*(fa + 4.0*flm + fm);
+  double right = (b - m)/6.0*(fm + 4.0*frm + fb);
+  double diff = left + right - whole;
+  double l, r;
+  int64_t le = 0, re = 0;
+
+  *evals += 2;
+  if (depth >= MAX_DEPTH || fabs(diff) <= 15.0*tol)
+    return left + right + diff/15.0;
+
+#pragma omp task shared(l, le) if(depth < TASK_DEPTH)
+  l = adaptive(f, a, m, fa, flm, fm, left, 0.5*tol, depth + 1, &le);
+  r = adaptive(f, m, b, fm, frm, fb, right, 0.5*tol, depth + 1, &re);
+#pragma omp taskwait
+
+  *evals += le + re;
+  return l + r;
+}
+
+double integrate_adaptive(const integrand_t* f, double a, double b, double tol, int64_t* evals)
+{
+  double fa = evaluate1(f, a), fm = evaluate1(f, 0.5*(a + b)), fb = evaluate1(f, b);
+  int64_t count = 3;
+  double sum;
+
+  sum = adaptive(f, a, b, fa, fm, fb, (b - a)/6.0*(fa + 4.0*fm + fb), tol, 0, &count);
+  if (evals != NULL)
+    *evals = count;
+  return sum;
+}
+
+double integrate_adaptive_omp(const integrand_t* f, double a, double b, double tol, int64_t* evals)
+{
+  double sum = 0.0;
+
+#pragma omp parallel
+#pragma omp single
+  sum = integrate_adaptive(f, a, b, tol, evals);
+
+  return sum;
+}
@@ -0,0 +1,84 @@
+/*
+** Numerical integration of f(x) from a to b, for any integrand, with the
+** composite trapezoid, Simpson and Gauss-Legendre rules and adaptive
+** Simpson, in serial or shared out between OpenMP threads.  The versions
+** that share the work between MPI processes are in integrate_mpi.h, and
+** C++ callables can be used through integrate.hpp.
+**
+** The composite rules cut [a,b] into n equal panels:
+**
+**   trapezoid - the ends of each panel (n + 1 evaluations in all)
+**   simpson   - the ends and middle of each panel (2n + 1)
+**   gauss     - the Gauss-Legendre points of each panel (order x n)
+**
+** The counts are 64-bit, so n can be far more than 2^31.
+**
+** Any run of panels can be integrated on its own, and the pieces add up to
+** the integral over all of them, so the panels can be shared out between
+** threads or processes however we like.
+*/
+
+#ifndef INTEGRATE_H
+#define INTEGRATE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* f(x), with data for any parameters of f */
+typedef double (*integrand_fn)(double x, void* data);
+/* fx[i] = f(x[i]) for i < n: a loop that the compiler can vectorise */
+typedef void (*integrand_batch_fn)(long n, const double* x, double* fx, void* data);
+
+/* an integrand: either one point at a time or a batch at a time */
+typedef struct {
+  integrand_fn f;
+  integrand_batch_fn batch;    /* used if not NULL */
+  void* data;
+} integrand_t;
+
+integrand_t integrand(integrand_fn f, void* data);
+integrand_t integrand_batch(integrand_batch_fn batch, void* data);
+
+enum { INTEGRATE_TRAPEZOID, INTEGRATE_SIMPSON, INTEGRATE_GAUSS };
+
+#define INTEGRATE_MAX_ORDER 32
+
+typedef struct {
+  int rule;     /* INTEGRATE_TRAPEZOID, INTEGRATE_SIMPSON or INTEGRATE_GAUSS */
+  int order;    /* the points in each panel for INTEGRATE_GAUSS, 1 to INTEGRATE_MAX_ORDER */
+} quadrature_t;
+
+/* the name of the rule, e.g. "gauss-4"; the string is static */
+const char* quadrature_name(quadrature_t q);
+/* the number of evaluations of f for n panels */
+int64_t quadrature_evals(quadrature_t q, int64_t n);
+
+/* the integral over panels first to last-1 of the n panels of [a,b] */
+double integrate_panels(const integrand_t* f, quadrature_t q, double a, double b, int64_t n,
+                        int64_t first, int64_t last);
+
+/* the integral over [a,b], on the calling thread */
+double integrate(const integrand_t* f, quadrature_t q, double a, double b, int64_t n);
+/* ... with the panels shared out between OpenMP threads */
+double integrate_omp(const integrand_t* f, quadrature_t q, double a, double b, int64_t n);
+double integrate_omp_panels(const integrand_t* f, quadrature_t q, double a, double b, int64_t n,
+                            int64_t first, int64_t last);
+
+/*
+** Adaptive Simpson: halve each interval until Simpson's rule on the halves
+** agrees with Simpson's rule on the whole to within its share of tol.  The
+** evaluations then go where f is hard to integrate.  If evals is not NULL,
+** the number of evaluations of f is returned in it.  The OpenMP version
+** makes tasks of the first few levels of halving.
+*/
+double integrate_adaptive(const integrand_t* f, double a, double b, double tol, int64_t* evals);
+double integrate_adaptive_omp(const integrand_t* f, double a, double b, double tol, int64_t* evals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
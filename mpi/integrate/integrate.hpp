@@ -0,0 +1,57 @@
+/*
+** C++ callables as integrands for integrate.h: any function object,
+** including a lambda that captures its parameters, that can be called as
+**
+**   double f(double x)                                    (make_integrand)
+**   void f(long n, const double* x, double* fx)           (make_batch_integrand)
+**
+** The integrand_t refers to f, so f must outlive it.
+*/
+
+#ifndef INTEGRATE_HPP
+#define INTEGRATE_HPP
+
+#include "integrate.h"
+
+namespace integrate_cpp {
+
+template <typename F>
+integrand_t make_integrand(F& f)
+{
+  return integrand([](double x, void* data) { return (*static_cast<F*>(data))(x); }, &f);
+}
+
+template <typename F>
+integrand_t make_batch_integrand(F& f)
+{
+  return integrand_batch([](long n, const double* x, double* fx, void* data) {
+                           (*static_cast<F*>(data))(n, x, fx);
+                         },
+                         &f);
+}
+
+/* integrate f over [a,b] with n panels of rule q, in serial or with OpenMP */
+template <typename F>
+double integrate(F f, quadrature_t q, double a, double b, int64_t n)
+{
+  integrand_t g = make_integrand(f);
+  return ::integrate(&g, q, a, b, n);
+}
+
+template <typename F>
+double integrate_omp(F f, quadrature_t q, double a, double b, int64_t n)
+{
+  integrand_t g = make_integrand(f);
+  return ::integrate_omp(&g, q, a, b, n);
+}
+
+template <typename F>
+double integrate_adaptive(F f, double a, double b, double tol, int64_t* evals = nullptr)
+{
+  integrand_t g = make_integrand(f);
+  return ::integrate_adaptive(&g, a, b, tol, evals);
+}
+
+}
+
+#endif
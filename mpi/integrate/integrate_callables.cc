@@ -0,0 +1,48 @@
+/*
+** Integrands as C++ callables, through integrate.hpp: lambdas that capture
+** the parameters of a family of integrands, rather than a void* to them.
+**
+**   x^k on [0,1], which is 1/(k + 1), and
+**   the normal density with standard deviation s on [-s,s], which is
+**   erf(1/sqrt(2)) for every s.
+**
+** Usage: integrate_callables.exe [n]
+*/
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "integrate.hpp"
+
+int main(int argc, char* argv[])
+{
+  int64_t n = (argc > 1) ? strtoll(argv[1], NULL, 10) : 1000;
+  quadrature_t gauss4 = { INTEGRATE_GAUSS, 4 };
+
+  if (argc > 2 || n < 1) {
+    fprintf(stderr, "Usage: %s [n]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("x^k on [0,1], gauss-4 with %" PRId64 " panels:\n", n);
+  for (int k = 1; k <= 8; k++) {
+    double result = integrate_cpp::integrate([k](double x) { return std::pow(x, k); },
+                                             gauss4, 0.0, 1.0, n);
+    printf("  k = %d: %.16f (error %.3e)\n", k, result, std::fabs(result - 1.0 / (k + 1)));
+  }
+
+  printf("\nnormal density on [-s,s], adaptive Simpson to 1e-12:\n");
+  for (double s = 0.001; s <= 1000.0; s *= 10.0) {
+    const double norm = 1.0 / (s * std::sqrt(2.0 * M_PI));
+    int64_t evals;
+    double result = integrate_cpp::integrate_adaptive(
+      [s, norm](double x) { return norm * std::exp(-0.5 * (x / s) * (x / s)); },
+      -s, s, 1e-12, &evals);
+    printf("  s = %-8g %.16f (error %.3e, %" PRId64 " evaluations)\n", s, result,
+           std::fabs(result - std::erf(1.0 / std::sqrt(2.0))), evals);
+  }
+
+  return EXIT_SUCCESS;
+}
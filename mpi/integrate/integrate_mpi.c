@@ -0,0 +1,49 @@
+/*
+** Numerical integration over MPI processes.  See integrate_mpi.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#include "integrate_mpi.h"
+#include "partition.h"
+
+double integrate_mpi(const integrand_t* f, quadrature_t q, double a, double b, int64_t n,
+                     MPI_Comm comm)
+{
+  int rank, size;
+  partition_t mine;
+  double local_sum, sum;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  /* our panels, shared between our threads just as integrate_omp() does */
+  mine = partition(n, size, rank);
+  local_sum = integrate_omp_panels(f, q, a, b, n, mine.first, mine.last);
+
+  MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+  return sum;
+}
+
+double integrate_adaptive_mpi(const integrand_t* f, double a, double b, double tol, int64_t* evals,
+                              MPI_Comm comm)
+{
+  int rank, size;
+  double h, local_a, local_b, local_sum, sum;
+  int64_t local_evals;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  h = (b - a)/size;
+  local_a = a + rank*h;
+  local_b = (rank == size - 1) ? b : a + (rank + 1)*h;
+  local_sum = integrate_adaptive_omp(f, local_a, local_b, tol/size, &local_evals);
+
+  MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+  if (evals != NULL)
+    MPI_Allreduce(&local_evals, evals, 1, MPI_INT64_T, MPI_SUM, comm);
+  return sum;
+}
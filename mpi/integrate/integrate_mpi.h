@@ -0,0 +1,36 @@
+/*
+** The integration rules of integrate.h, with the work shared out between
+** the processes of an MPI communicator and, within each process, between
+** its OpenMP threads.  Every process must call them with the same
+** arguments, and every process gets the answer.
+*/
+
+#ifndef INTEGRATE_MPI_H
+#define INTEGRATE_MPI_H
+
+#include <mpi.h>
+
+#include "integrate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* each process takes an equal share of the n panels, to within one */
+double integrate_mpi(const integrand_t* f, quadrature_t q, double a, double b, int64_t n,
+                     MPI_Comm comm);
+
+/*
+** Each process integrates an equal part of [a,b], to its share of tol.
+** Where f is much harder to integrate in some parts than others, the
+** processes given those parts have much more to do.  evals, if not NULL,
+** is the total number of evaluations.
+*/
+double integrate_adaptive_mpi(const integrand_t* f, double a, double b, double tol, int64_t* evals,
+                              MPI_Comm comm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
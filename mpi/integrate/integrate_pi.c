@@ -0,0 +1,158 @@
+/*
+** The integration library of integrate.h on two integrands:
+**
+**   4/(1 + x^2) on [0,1], which is pi and smooth, so the higher order rules
+**   converge very quickly, and
+**   sqrt(x) on [0,1], which is 2/3 but has an infinite derivative at 0, so
+**   every composite rule converges slowly and adaptive Simpson wins.
+**
+** Each rule is run with n panels on the calling thread, with the integrand
+** given one point at a time and then a batch at a time, with OpenMP threads
+** and with MPI processes (and their threads).  Adaptive Simpson is run to a
+** tolerance tol.
+**
+** Usage: integrate_pi.exe [n [tol]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <mpi.h>
+
+#include "integrate_mpi.h"
+
+#define N 10000000L
+#define TOL 1e-10
+#define MASTER 0
+
+#define NRULES 5
+static const quadrature_t rules[NRULES] = {
+  { INTEGRATE_TRAPEZOID, 0 }, { INTEGRATE_SIMPSON, 0 },
+  { INTEGRATE_GAUSS, 2 }, { INTEGRATE_GAUSS, 4 }, { INTEGRATE_GAUSS, 8 }
+};
+
+/* definite integral of this will estimate pi */
+double pi_f(double x, void* data)
+{
+  return 4.0 / (1.0 + x*x);
+}
+
+void pi_batch(long n, const double* x, double* fx, void* data)
+{
+  long i;
+
+#pragma omp simd
+  for (i = 0; i < n; i++)
+    fx[i] = 4.0 / (1.0 + x[i]*x[i]);
+}
+
+double sqrt_f(double x, void* data)
+{
+  return sqrt(x);
+}
+
+void sqrt_batch(long n, const double* x, double* fx, void* data)
+{
+  long i;
+
+#pragma omp simd
+  for (i = 0; i < n; i++)
+    fx[i] = sqrt(x[i]);
+}
+
+void run(const char* name, integrand_t point, integrand_t batch, double exact,
+         int64_t n, double tol, int rank)
+{
+  double tic, t_point, t_batch, t_omp, t_mpi;
+  double result = 0.0;
+  int64_t evals;
+  int r;
+
+  if (rank == MASTER) {
+    printf("\n%s, %" PRId64 " panels:\n\n", name, n);
+    printf("%-10s %12s %12s %10s %10s %10s %10s\n", "rule", "evals", "error",
+           "point (s)", "batch (s)", "omp (s)", "mpi (s)");
+  }
+
+  for (r = 0; r < NRULES; r++) {
+    t_point = t_batch = t_omp = 0.0;
+    if (rank == MASTER) {
+      tic = MPI_Wtime();
+      integrate(&point, rules[r], 0.0, 1.0, n);
+      t_point = MPI_Wtime() - tic;
+
+      tic = MPI_Wtime();
+      result = integrate(&batch, rules[r], 0.0, 1.0, n);
+      t_batch = MPI_Wtime() - tic;
+
+      tic = MPI_Wtime();
+      integrate_omp(&batch, rules[r], 0.0, 1.0, n);
+      t_omp = MPI_Wtime() - tic;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    tic = MPI_Wtime();
+    integrate_mpi(&batch, rules[r], 0.0, 1.0, n, MPI_COMM_WORLD);
+    t_mpi = MPI_Wtime() - tic;
+
+    if (rank == MASTER)
+      printf("%-10s %12" PRId64 " %12.3e %10.4f %10.4f %10.4f %10.4f\n", quadrature_name(rules[r]),
+             quadrature_evals(rules[r], n), fabs(result - exact), t_point, t_batch, t_omp, t_mpi);
+  }
+
+  t_point = t_omp = 0.0;
+  if (rank == MASTER) {
+    tic = MPI_Wtime();
+    result = integrate_adaptive(&point, 0.0, 1.0, tol, &evals);
+    t_point = MPI_Wtime() - tic;
+
+    tic = MPI_Wtime();
+    integrate_adaptive_omp(&point, 0.0, 1.0, tol, NULL);
+    t_omp = MPI_Wtime() - tic;
+
+    printf("\n%-10s %12" PRId64 " %12.3e %10.4f %10s %10.4f", "adaptive", evals, fabs(result - exact),
+           t_point, "-", t_omp);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = MPI_Wtime();
+  integrate_adaptive_mpi(&point, 0.0, 1.0, tol, NULL, MPI_COMM_WORLD);
+  t_mpi = MPI_Wtime() - tic;
+
+  if (rank == MASTER)
+    printf(" %10.4f   (tol %g)\n", t_mpi, tol);
+}
+
+int main(int argc, char* argv[])
+{
+  int rank, size;
+  int64_t n = N;
+  double tol = TOL;
+
+  double PI25DT = 3.141592653589793238462643;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (argc > 1) n = strtoll(argv[1], NULL, 10);
+  if (argc > 2) tol = atof(argv[2]);
+  if (argc > 3 || n < 1 || tol <= 0.0) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s [n [tol]]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if (rank == MASTER)
+    printf("%d processes; times for the serial and OpenMP versions are on rank %d\n", size, MASTER);
+
+  run("4/(1 + x^2) on [0,1]", integrand(pi_f, NULL), integrand_batch(pi_batch, NULL),
+      PI25DT, n, tol, rank);
+  run("sqrt(x) on [0,1]", integrand(sqrt_f, NULL), integrand_batch(sqrt_batch, NULL),
+      2.0/3.0, n, tol, rank);
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
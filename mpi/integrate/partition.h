@@ -0,0 +1,76 @@
+/*
+** Sharing out n items (trapezoids, panels, darts, rows ...) between parts
+** (processes or threads) as evenly as possible.
+**
+** n/parts items each leaves n%parts over, and dropping them gives the
+** wrong answer; giving them all to the last part makes it the one that
+** everyone waits for.  Here the first n%parts parts get one item more, so
+** no two parts differ by more than one item, and every item is in exactly
+** one part, for any n and any number of parts.
+**
+** Counts are 64-bit, so n can be well past the 2^31 of an int: 10^11
+** trapezoids over a few thousand cores is only a few seconds' work.
+**
+**   partition_t mine = partition(n, size, rank);
+**   for (i = mine.first; i < mine.last; i++)
+**     ...
+**
+** A part can be shared out again, e.g. a process's items between its
+** threads, with partition_range().
+*/
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <stdint.h>
+
+/* items first to last-1 */
+typedef struct {
+  int64_t first;
+  int64_t last;
+} partition_t;
+
+/* the first item of part, for 0 <= part <= parts (part == parts gives n) */
+static inline int64_t partition_first(int64_t n, int parts, int part)
+{
+  int64_t share = n/parts, extra = n%parts;
+
+  return share*part + (part < extra ? part : extra);
+}
+
+/* the items of part, for 0 <= part < parts */
+static inline partition_t partition(int64_t n, int parts, int part)
+{
+  partition_t p;
+
+  p.first = partition_first(n, parts, part);
+  p.last = partition_first(n, parts, part + 1);
+  return p;
+}
+
+/* the items of whole, shared out in the same way */
+static inline partition_t partition_range(partition_t whole, int parts, int part)
+{
+  partition_t p = partition(whole.last - whole.first, parts, part);
+
+  p.first += whole.first;
+  p.last += whole.first;
+  return p;
+}
+
+static inline int64_t partition_count(partition_t p)
+{
+  return p.last - p.first;
+}
+
+/* the part that item i is in, for 0 <= i < n */
+static inline int partition_owner(int64_t n, int parts, int64_t i)
+{
+  int64_t share = n/parts, extra = n%parts;
+
+  if (i < extra*(share + 1))
+    return (int)(i/(share + 1));
+  return (int)(extra + (i - extra*(share + 1))/share);
+}
+
+#endif
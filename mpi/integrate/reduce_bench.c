@@ -0,0 +1,109 @@
+/*
+** Time to add up one double from every process, for each strategy in
+** reduce_strategy.h, on the first 1, 2, 4, ... processes of
+** MPI_COMM_WORLD and on all of them.
+**
+** Each reduction starts with a barrier, and its time is the time until the
+** slowest process is done (the root, for all but doubling, which has to
+** wait for everyone).  The table gives the mean over repeats reductions in
+** microseconds, and every total is checked.
+**
+** Usage: reduce_bench.exe [repeats]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#include "reduce_strategy.h"
+
+#define REPEATS 1000
+#define MAX_SIZES 32
+#define MASTER 0
+
+int main(int argc, char* argv[])
+{
+  int rank, size, repeats = REPEATS;
+  int sizes[MAX_SIZES], nsizes = 0;
+  double times[REDUCE_NSTRATEGIES][MAX_SIZES];
+  int ss, s, rr, p;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (argc > 1) repeats = atoi(argv[1]);
+  if (argc > 2 || repeats < 1) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s [repeats]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  for (p = 1; p < size; p *= 2)
+    sizes[nsizes++] = p;
+  sizes[nsizes++] = size;
+
+  for (ss = 0; ss < nsizes; ss++) {
+    MPI_Comm comm;
+    int sub_rank;
+
+    /* the first sizes[ss] processes; the rest wait at the barrier below */
+    MPI_Comm_split(MPI_COMM_WORLD, rank < sizes[ss] ? 0 : MPI_UNDEFINED, rank, &comm);
+    if (comm == MPI_COMM_NULL) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      continue;
+    }
+    MPI_Comm_rank(comm, &sub_rank);
+
+    for (s = 0; s < REDUCE_NSTRATEGIES; s++) {
+      reduce_t r = reduce_init(s, MASTER, comm);
+      /* 1 + 2 + ... + p, which is exact in a double */
+      double value = sub_rank + 1;
+      double expected = 0.5*sizes[ss]*(sizes[ss] + 1.0);
+      double tic, toc, slowest, total = 0.0, sum;
+
+      /* once to warm up */
+      reduce_sum(&r, value);
+
+      for (rr = 0; rr < repeats; rr++) {
+        MPI_Barrier(comm);
+        tic = MPI_Wtime();
+        sum = reduce_sum(&r, value);
+        toc = MPI_Wtime() - tic;
+
+        if ((sub_rank == MASTER || s == REDUCE_DOUBLING) && sum != expected) {
+          fprintf(stderr, "Error: %s on %d processes gave %g on rank %d, not %g\n",
+                  reduce_strategy_name(s), sizes[ss], sum, sub_rank, expected);
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        MPI_Reduce(&toc, &slowest, 1, MPI_DOUBLE, MPI_MAX, MASTER, comm);
+        total += slowest;
+      }
+      times[s][ss] = total/repeats;
+
+      reduce_free(&r);
+    }
+
+    MPI_Comm_free(&comm);
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
+  if (rank == MASTER) {
+    printf("mean time (us) of %d reductions of one double\n\n", repeats);
+    printf("%-12s", "processes");
+    for (ss = 0; ss < nsizes; ss++)
+      printf(" %9d", sizes[ss]);
+    printf("\n");
+    for (s = 0; s < REDUCE_NSTRATEGIES; s++) {
+      printf("%-12s", reduce_strategy_name(s));
+      for (ss = 0; ss < nsizes; ss++)
+        printf(" %9.2f", times[s][ss]*1e6);
+      printf("\n");
+    }
+  }
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
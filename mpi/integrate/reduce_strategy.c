@@ -0,0 +1,242 @@
+/*
+** Strategies for summing one double over a communicator.  See
+** reduce_strategy.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "reduce_strategy.h"
+
+#define TAG 0
+
+static const char* names[REDUCE_NSTRATEGIES] = {
+  "linear", "reduce", "accumulate", "binomial", "doubling", "ireduce"
+};
+
+const char* reduce_strategy_name(int strategy)
+{
+  if (strategy < 0 || strategy >= REDUCE_NSTRATEGIES)
+    return NULL;
+  return names[strategy];
+}
+
+int reduce_strategy_find(const char* name)
+{
+  int s;
+
+  for (s = 0; s < REDUCE_NSTRATEGIES; s++)
+    if (strcmp(name, names[s]) == 0)
+      return s;
+  return -1;
+}
+
+reduce_t reduce_init(int strategy, int root, MPI_Comm comm)
+{
+  reduce_t r;
+  int rank;
+
+  if (reduce_strategy_name(strategy) == NULL) {
+    fprintf(stderr, "Error: unknown reduction strategy %d\n", strategy);
+    MPI_Abort(comm, 1);
+  }
+
+  MPI_Comm_rank(comm, &rank);
+  r.strategy = strategy;
+  r.root = root;
+  r.comm = comm;
+  r.win = MPI_WIN_NULL;
+  r.total = NULL;
+  r.request = MPI_REQUEST_NULL;
+  r.send = r.result = 0.0;
+
+  /* only the root's memory is in the window, as in rma_trapezoid.c */
+  if (strategy == REDUCE_ACCUMULATE) {
+    if (rank == root) {
+      MPI_Alloc_mem(sizeof(double), MPI_INFO_NULL, &r.total);
+      MPI_Win_create(r.total, sizeof(double), sizeof(double), MPI_INFO_NULL, comm, &r.win);
+    }
+    else
+      MPI_Win_create(MPI_BOTTOM, 0, sizeof(double), MPI_INFO_NULL, comm, &r.win);
+  }
+
+  return r;
+}
+
+void reduce_free(reduce_t* r)
+{
+  if (r->win != MPI_WIN_NULL)
+    MPI_Win_free(&r->win);
+  if (r->total != NULL)
+    MPI_Free_mem(r->total);
+  r->total = NULL;
+}
+
+static double linear(double value, int root, MPI_Comm comm)
+{
+  int rank, size, source;
+  double sum, part;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  if (rank != root) {
+    MPI_Send(&value, 1, MPI_DOUBLE, root, TAG, comm);
+    return 0.0;
+  }
+
+  /* in rank order, so the answer is the same every time */
+  sum = value;
+  for (source = 0; source < size; source++) {
+    if (source == root) continue;
+    MPI_Recv(&part, 1, MPI_DOUBLE, source, TAG, comm, MPI_STATUS_IGNORE);
+    sum += part;
+  }
+  return sum;
+}
+
+static double accumulate(reduce_t* r, double value)
+{
+  int rank;
+  double sum = 0.0;
+
+  MPI_Comm_rank(r->comm, &rank);
+
+  /* the root can set its own memory before the epoch starts */
+  if (rank == r->root)
+    *r->total = 0.0;
+
+  MPI_Win_fence(0, r->win);
+  MPI_Accumulate(&value, 1, MPI_DOUBLE, r->root, 0, 1, MPI_DOUBLE, MPI_SUM, r->win);
+  MPI_Win_fence(0, r->win);
+
+  if (rank == r->root)
+    sum = *r->total;
+  return sum;
+}
+
+/*
+** Number the processes from the root, v = (rank - root) mod size.  In
+** round k (mask = 2^k), a process whose bit k is set sends its sum to
+** v - mask and is done; the others add in the sum from v + mask, if there
+** is one.
+*/
+static double binomial(double value, int root, MPI_Comm comm)
+{
+  int rank, size, v, mask;
+  double sum = value, part;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  v = (rank - root + size) % size;
+
+  for (mask = 1; mask < size; mask <<= 1) {
+    if (v & mask) {
+      MPI_Send(&sum, 1, MPI_DOUBLE, (v - mask + root) % size, TAG, comm);
+      return 0.0;
+    }
+    if (v + mask < size) {
+      MPI_Recv(&part, 1, MPI_DOUBLE, (v + mask + root) % size, TAG, comm, MPI_STATUS_IGNORE);
+      sum += part;
+    }
+  }
+  return sum;
+}
+
+/*
+** Recursive doubling needs a power of two, p, of processes.  Of the first
+** 2*(size - p), each even process hands its sum to the odd one above it and
+** sits out; the rest are numbered 0 to p-1 and swap sums with the process
+** 2^k away in round k.  Then the odd processes pass the total back down.
+** a + b == b + a exactly, so both sides of each swap agree on the sum.
+*/
+static double doubling(double value, MPI_Comm comm)
+{
+  int rank, size, p, extra, v, mask, partner;
+  double sum = value, part;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  for (p = 1; 2*p <= size; p *= 2);
+  extra = size - p;
+
+  if (rank < 2*extra) {
+    if (rank % 2 == 0) {
+      MPI_Send(&sum, 1, MPI_DOUBLE, rank + 1, TAG, comm);
+      MPI_Recv(&sum, 1, MPI_DOUBLE, rank + 1, TAG, comm, MPI_STATUS_IGNORE);
+      return sum;
+    }
+    MPI_Recv(&part, 1, MPI_DOUBLE, rank - 1, TAG, comm, MPI_STATUS_IGNORE);
+    sum += part;
+    v = rank/2;
+  }
+  else
+    v = rank - extra;
+
+  for (mask = 1; mask < p; mask <<= 1) {
+    partner = v ^ mask;
+    partner = (partner < extra) ? 2*partner + 1 : partner + extra;
+    MPI_Sendrecv(&sum, 1, MPI_DOUBLE, partner, TAG, &part, 1, MPI_DOUBLE, partner, TAG,
+                 comm, MPI_STATUS_IGNORE);
+    sum += part;
+  }
+
+  if (rank < 2*extra)
+    MPI_Send(&sum, 1, MPI_DOUBLE, rank - 1, TAG, comm);
+  return sum;
+}
+
+void reduce_start(reduce_t* r, double value)
+{
+  int rank;
+
+  MPI_Comm_rank(r->comm, &rank);
+  r->send = value;
+  r->result = 0.0;
+
+  switch (r->strategy) {
+  case REDUCE_LINEAR:
+    r->result = linear(value, r->root, r->comm);
+    break;
+  case REDUCE_REDUCE:
+    MPI_Reduce(&r->send, &r->result, 1, MPI_DOUBLE, MPI_SUM, r->root, r->comm);
+    break;
+  case REDUCE_ACCUMULATE:
+    r->result = accumulate(r, value);
+    break;
+  case REDUCE_BINOMIAL:
+    r->result = binomial(value, r->root, r->comm);
+    break;
+  case REDUCE_DOUBLING:
+    r->result = doubling(value, r->comm);
+    break;
+  case REDUCE_IREDUCE:
+    MPI_Ireduce(&r->send, &r->result, 1, MPI_DOUBLE, MPI_SUM, r->root, r->comm, &r->request);
+    break;
+  }
+
+  /* MPI_Reduce() leaves the result alone away from the root */
+  if (rank != r->root && r->strategy != REDUCE_DOUBLING && r->strategy != REDUCE_IREDUCE)
+    r->result = 0.0;
+}
+
+double reduce_finish(reduce_t* r)
+{
+  int rank;
+
+  if (r->strategy == REDUCE_IREDUCE) {
+    MPI_Wait(&r->request, MPI_STATUS_IGNORE);
+    MPI_Comm_rank(r->comm, &rank);
+    if (rank != r->root)
+      r->result = 0.0;
+  }
+  return r->result;
+}
+
+double reduce_sum(reduce_t* r, double value)
+{
+  reduce_start(r, value);
+  return reduce_finish(r);
+}
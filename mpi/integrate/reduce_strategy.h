@@ -0,0 +1,75 @@
+/*
+** Ways of adding up one double from every process of a communicator.
+**
+** The trapezoid examples each combine their sums in a different way:
+** example3/send_trapezoid.c has the root receive from everyone in turn,
+** example6/reduce_trapezoid.c calls MPI_Reduce() and
+** advanced/example9/rma_trapezoid.c calls MPI_Accumulate() between
+** fences.  Here they are behind one interface, with three more:
+**
+**   linear      everyone sends to the root, which receives from each in turn
+**   reduce      MPI_Reduce()
+**   accumulate  MPI_Accumulate() into a window on the root, between fences
+**   binomial    a binomial tree: in round k, the processes 2^k apart pair
+**               up and one passes its sum to the other, so the root has the
+**               total after log2(size) rounds
+**   doubling    recursive doubling: in round k, the processes 2^k apart
+**               swap sums, so everyone has the total after log2(size)
+**               rounds (plus two for the odd processes out, if size is not
+**               a power of two)
+**   ireduce     MPI_Ireduce(), which can be left to run while we get on
+**               with something else
+**
+**   reduce_t r = reduce_init(REDUCE_BINOMIAL, MASTER, comm);
+**   total = reduce_sum(&r, local_sum);
+**   reduce_free(&r);
+**
+** reduce_sum() returns the total on the root; on the other processes it
+** returns the total for REDUCE_DOUBLING and 0.0 otherwise.  Every process
+** must make the same calls.  reduce_start() and reduce_finish() split
+** reduce_sum() in two, so that work can be done in between while
+** REDUCE_IREDUCE runs; the others do all of their work in reduce_start().
+*/
+
+#ifndef REDUCE_STRATEGY_H
+#define REDUCE_STRATEGY_H
+
+#include <mpi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  REDUCE_LINEAR, REDUCE_REDUCE, REDUCE_ACCUMULATE, REDUCE_BINOMIAL, REDUCE_DOUBLING,
+  REDUCE_IREDUCE, REDUCE_NSTRATEGIES
+};
+
+typedef struct {
+  int strategy;
+  int root;
+  MPI_Comm comm;
+  MPI_Win win;            /* REDUCE_ACCUMULATE: the total, on the root */
+  double* total;
+  MPI_Request request;    /* REDUCE_IREDUCE */
+  double send, result;    /* the buffers of a reduction in progress */
+} reduce_t;
+
+/* the name of a strategy, as in the table above, or NULL if there is none */
+const char* reduce_strategy_name(int strategy);
+/* the strategy with that name, or -1 if there is none */
+int reduce_strategy_find(const char* name);
+
+/* collective over comm, as it may make a window */
+reduce_t reduce_init(int strategy, int root, MPI_Comm comm);
+void reduce_free(reduce_t* r);
+
+double reduce_sum(reduce_t* r, double value);
+void reduce_start(reduce_t* r, double value);
+double reduce_finish(reduce_t* r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+/*
+** Monte Carlo tasks of very different costs, shared out with each of the
+** schedules of taskfarm.h.
+**
+** Task i is a dartboard estimate of pi, as in
+** ../example3/dartboard_pi_send.c, from its own Philox stream i.  The
+** number of darts varies a lot from task to task: BASE_DARTS times a random
+** factor from a Pareto distribution (shape ALPHA, so most tasks are small
+** but a few are up to MAX_FACTOR times bigger), times a factor that grows
+** from 1 to 4 along the tasks, as when a sweep over a parameter gets harder
+** towards one end.  The results are the hits and the darts, which add up
+** exactly in any order, so every schedule must give the same pi.
+**
+** For each schedule the master prints the time, the chunks handed out,
+** the least and most time a worker spent on its tasks, and the efficiency
+** (the time spent on tasks over the workers times the time).
+**
+** Usage: farm_pi.exe [ntasks [chunk]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <mpi.h>
+
+#include "taskfarm.h"
+#include "philox.h"
+
+#define NTASKS 20000
+#define CHUNK 1
+#define BASE_DARTS 20000
+#define ALPHA 1.5
+#define MAX_FACTOR 100.0
+#define BATCH 4096       /* random numbers made at a time, an even number */
+#define SEED 20240607
+#define MASTER 0
+
+#define PI25DT 3.141592653589793238462643
+
+/* the number of darts of task i of ntasks */
+static int64_t task_darts(int64_t i, int64_t ntasks)
+{
+  philox_t rng = philox_init(SEED, i);
+  double factor = pow(1.0 - philox_uniform(&rng), -1.0/ALPHA);
+
+  if (factor > MAX_FACTOR)
+    factor = MAX_FACTOR;
+  return (int64_t)(BASE_DARTS*factor*(1.0 + 3.0*i/ntasks));
+}
+
+/* tasks first to last-1: result[0] += hits, result[1] += darts */
+void throw_tasks(int64_t first, int64_t last, double* result, void* data)
+{
+  int64_t ntasks = *(int64_t*)data;
+  double x[BATCH];
+  int64_t i, d, darts, hits;
+  long j, count;
+
+  for (i = first; i < last; i++) {
+    /* numbers 0 and 1 of the stream gave the number of darts */
+    philox_t rng = philox_init(SEED, i);
+    philox_skip(&rng, 2);
+
+    darts = task_darts(i, ntasks);
+    hits = 0;
+    for (d = 0; d < darts; d += count/2) {
+      count = (darts - d < BATCH/2) ? 2*(darts - d) : BATCH;
+      philox_uniform_batch(&rng, x, count);
+      for (j = 0; j < count; j += 2)
+        if (x[j]*x[j] + x[j + 1]*x[j + 1] <= 1.0)
+          hits++;
+    }
+    result[0] += hits;
+    result[1] += darts;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int rank, size, schedule;
+  int64_t ntasks = NTASKS, chunk = CHUNK;
+  double result[2], first_result[2];
+  taskfarm_stats_t stats;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (argc > 1) ntasks = atoll(argv[1]);
+  if (argc > 2) chunk = atoll(argv[2]);
+  if (argc > 3 || ntasks < 1 || chunk < 1) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s [ntasks [chunk]]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if (rank == MASTER) {
+    printf("%d processes, %" PRId64 " tasks of %d to %.0f darts, chunks of %" PRId64
+           " or more\n\n", size, ntasks, BASE_DARTS, 4.0*MAX_FACTOR*BASE_DARTS, chunk);
+    printf("%-8s %10s %8s %8s %10s %10s %11s %14s\n", "schedule", "time (s)", "chunks",
+           "workers", "min busy", "max busy", "efficiency", "pi");
+  }
+
+  for (schedule = 0; schedule < TASKFARM_NSCHEDULES; schedule++) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    stats = taskfarm_run(throw_tasks, &ntasks, ntasks, 2, result, schedule, chunk, MASTER,
+                         MPI_COMM_WORLD);
+
+    if (rank == MASTER) {
+      printf("%-8s %10.4f %8" PRId64 " %8d %10.4f %10.4f %10.1f%% %14.10f\n",
+             taskfarm_schedule_name(schedule), stats.elapsed, stats.chunks, stats.workers,
+             stats.min_busy, stats.max_busy,
+             100.0*stats.total_busy/(stats.workers*stats.elapsed), 4.0*result[0]/result[1]);
+
+      /* the same darts, whoever threw them */
+      if (schedule == 0) {
+        first_result[0] = result[0];
+        first_result[1] = result[1];
+      }
+      else if (result[0] != first_result[0] || result[1] != first_result[1]) {
+        fprintf(stderr, "Error: %s counted %.0f hits of %.0f darts, not %.0f of %.0f\n",
+                taskfarm_schedule_name(schedule), result[0], result[1], first_result[0],
+                first_result[1]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    }
+  }
+
+  if (rank == MASTER)
+    printf("\n%.0f darts, error %.3e\n", result[1], fabs(4.0*result[0]/result[1] - PI25DT));
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/*
+** The dartboard estimate of pi of ../example3/dartboard_pi_send.c,
+** rebuilt to scale:
+**
+**   - each process throws its darts with all of its OpenMP threads.  Dart
+**     d of process p is numbers 2d and 2d+1 of Philox stream p (philox.h),
+**     and each thread takes a block of the round's darts (partition.h), so
+**     the darts are the same however many threads there are;
+**   - after each round the running counts of hits and darts are added up
+**     over the processes with MPI_Iallreduce(), which goes on while the
+**     next round is thrown, instead of every worker sending to a master
+**     that receives from each of them in turn; and
+**   - rather than a fixed number of rounds, we stop once the standard
+**     error of the estimate, 4 sqrt(p (1 - p) / darts) for a fraction p of
+**     hits, is below a target (or after MAX_DARTS darts).
+**
+** The decision to stop is made from the sums of the rounds before the one
+** just thrown, so every process stops after the same round.  The darts of
+** that last round are then added in with a blocking MPI_Allreduce(), so
+** none of them are wasted.
+**
+** The master prints the estimate, its standard error and the darts per
+** second after 1, 2, 4, 8, ... rounds, and at the end how long the slowest
+** process spent throwing and waiting for the sums.
+**
+** Usage: hybrid_dartboard.exe [target_std_error [darts_per_round]]
+**        (darts_per_round is per process, and may be written as e.g. 1e6)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <mpi.h>
+#include <omp.h>
+
+#include "philox.h"
+#include "partition.h"
+
+#define TARGET 1e-4
+#define ROUND_DARTS 1e6
+#define MAX_DARTS 1e13   /* stop here, whatever the error */
+#define BATCH 4096       /* random numbers made at a time, an even number */
+#define SEED 20240607
+#define MASTER 0
+
+#define PI25DT 3.141592653589793238462643
+
+/* how many of darts first to last-1 of process rank land in the circle */
+static int64_t throw_darts(int rank, int64_t first, int64_t last)
+{
+  philox_t rng = philox_init(SEED, philox_stream_id(rank, 0));
+  double x[BATCH];
+  int64_t d, hits = 0;
+  long i, count;
+
+  philox_skip(&rng, 2*(uint64_t)first);
+  for (d = first; d < last; d += count/2) {
+    count = (last - d < BATCH/2) ? 2*(last - d) : BATCH;
+    philox_uniform_batch(&rng, x, count);
+    for (i = 0; i < count; i += 2)
+      if (x[i]*x[i] + x[i + 1]*x[i + 1] <= 1.0)
+        hits++;
+  }
+  return hits;
+}
+
+/* the standard error of 4 hits/darts */
+static double std_error(int64_t hits, int64_t darts)
+{
+  double p = (double)hits/darts;
+
+  return 4.0*sqrt(p*(1.0 - p)/darts);
+}
+
+static void report(int64_t rounds, const int64_t* total, double elapsed)
+{
+  double pi = 4.0*total[0]/total[1];
+
+  printf("%8" PRId64 " %16" PRId64 " %14.10f %11.3e %11.3e %12.3e\n", rounds, total[1], pi,
+         std_error(total[0], total[1]), fabs(pi - PI25DT), total[1]/elapsed);
+}
+
+int main(int argc, char* argv[])
+{
+  int rank, size, nthreads, provided;
+  double target = TARGET, requested = ROUND_DARTS;
+  int64_t round_darts;             /* darts per process per round */
+  int64_t local[2] = { 0, 0 };     /* our hits and darts so far */
+  int64_t sent[2];                 /* ... as they were when the last sum was started */
+  int64_t total[2];                /* hits and darts of all the processes, from that sum */
+  int64_t round;
+  MPI_Request request = MPI_REQUEST_NULL;
+  int stop = 0;
+  double tic, t, sent_time = 0.0;
+  double times[2] = { 0.0, 0.0 };  /* our time throwing and waiting for the sums */
+  double max_times[2], elapsed;
+
+  /* only the master thread makes MPI calls */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (argc > 1) target = atof(argv[1]);
+  if (argc > 2) requested = atof(argv[2]);
+  if (argc > 3 || !(target > 0.0) || requested < 1.0 || requested > MAX_DARTS ||
+      requested != floor(requested)) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s [target_std_error [darts_per_round]]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  round_darts = (int64_t)requested;
+  nthreads = omp_get_max_threads();
+
+  if (rank == MASTER) {
+    printf("%d processes x %d threads, %" PRId64 " darts per process per round, "
+           "target standard error %.1e\n\n", size, nthreads, round_darts, target);
+    printf("%8s %16s %14s %11s %11s %12s\n", "rounds", "darts", "pi", "std error", "error",
+           "darts/s");
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  tic = MPI_Wtime();
+
+  for (round = 0; !stop; round++) {
+    partition_t mine = { round*round_darts, (round + 1)*round_darts };
+    int64_t hits = 0;
+
+    t = MPI_Wtime();
+#pragma omp parallel reduction(+:hits)
+    {
+      partition_t ours = partition_range(mine, omp_get_num_threads(), omp_get_thread_num());
+      hits += throw_darts(rank, ours.first, ours.last);
+    }
+    local[0] += hits;
+    local[1] += round_darts;
+    times[0] += MPI_Wtime() - t;
+
+    /* the sums of the rounds before this one, which went on while we threw */
+    if (round > 0) {
+      t = MPI_Wtime();
+      MPI_Wait(&request, MPI_STATUS_IGNORE);
+      times[1] += MPI_Wtime() - t;
+
+      stop = (total[0] > 0 && total[0] < total[1] && std_error(total[0], total[1]) < target) ||
+        total[1] >= MAX_DARTS;
+      if (rank == MASTER && (round & (round - 1)) == 0)
+        report(round, total, sent_time);
+    }
+
+    /* the send buffer must not change until the sum is done */
+    if (!stop) {
+      sent[0] = local[0];
+      sent[1] = local[1];
+      sent_time = MPI_Wtime() - tic;
+      MPI_Iallreduce(sent, total, 2, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD, &request);
+    }
+  }
+
+  /* and the last round */
+  t = MPI_Wtime();
+  MPI_Allreduce(local, total, 2, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+  times[1] += MPI_Wtime() - t;
+  elapsed = MPI_Wtime() - tic;
+
+  MPI_Reduce(times, max_times, 2, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+
+  if (rank == MASTER) {
+    report(round, total, elapsed);
+    printf("\npi estimated as %.10f +/- %.1e after %" PRId64 " rounds (error: %.3e)\n",
+           4.0*total[0]/total[1], std_error(total[0], total[1]), round,
+           fabs(4.0*total[0]/total[1] - PI25DT));
+    printf("time %.3f s, %.3e darts/s, %.3e per thread\n", elapsed, total[1]/elapsed,
+           total[1]/elapsed/((double)size*nthreads));
+    printf("slowest process: %.3f s throwing, %.3f s waiting for the sums\n", max_times[0],
+           max_times[1]);
+  }
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/*
+** Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+** 1, 2, 3", SC11): a counter-based random number generator.
+**
+** rand() keeps one hidden state for the whole program.  Every call reads
+** and writes it (under a lock, in glibc), so threads that share it queue up
+** and get each other's numbers in whatever order they happen to call, and
+** srand(rank) gives streams that are just shifted copies of one sequence.
+**
+** Philox has no state to share: random number i of stream s is a fixed,
+** scrambled function of (seed, s, i).  Ten rounds of multiplies and XORs
+** turn the 128-bit counter (i, s) into 128 random bits, which make two
+** doubles.  So
+**
+**   - every process and thread can have its own stream, e.g.
+**     philox_stream_id(rank, thread), and the streams are independent;
+**   - jumping ahead by any amount is free (philox_skip()), so a block of
+**     one stream can be handed to each thread; and
+**   - a batch of numbers is a loop with no dependence from one to the
+**     next, which the compiler can vectorise (philox_uniform_batch()).
+**
+**   philox_t rng = philox_init(seed, philox_stream_id(rank, omp_get_thread_num()));
+**   x = philox_uniform(&rng);
+**
+** Everything is in this header, so that it can be inlined into the loops
+** that use it.
+*/
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stdint.h>
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+typedef struct {
+  uint32_t key[2];     /* the seed */
+  uint64_t stream;     /* the high half of the counter */
+  uint64_t position;   /* the next double: half position%2 of block position/2 */
+} philox_t;
+
+/*
+** The ten rounds, on the counter (c0,c1,c2,c3) in place, with key (k0,k1)
+** (which are changed too).  A macro rather than a function with an output
+** array, so that the compiler can keep everything in vector registers.
+*/
+#define PHILOX4X32_10(c0, c1, c2, c3, k0, k1)                  \
+  do {                                                          \
+    uint64_t philox_p0, philox_p1;                              \
+    int philox_r;                                               \
+    for (philox_r = 0; philox_r < 10; philox_r++) {             \
+      if (philox_r > 0) {                                       \
+        (k0) += PHILOX_W0;                                      \
+        (k1) += PHILOX_W1;                                      \
+      }                                                         \
+      philox_p0 = (uint64_t)PHILOX_M0*(c0);                     \
+      philox_p1 = (uint64_t)PHILOX_M1*(c2);                     \
+      (c0) = (uint32_t)(philox_p1 >> 32) ^ (c1) ^ (k0);         \
+      (c1) = (uint32_t)philox_p1;                               \
+      (c2) = (uint32_t)(philox_p0 >> 32) ^ (c3) ^ (k1);         \
+      (c3) = (uint32_t)philox_p0;                               \
+    }                                                           \
+  } while (0)
+
+/* 128 random bits from the counter (c0,c1,c2,c3) and key (k0,k1), in out[0..3] */
+static inline void philox4x32_10(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3,
+                                 uint32_t k0, uint32_t k1, uint32_t* out)
+{
+  PHILOX4X32_10(c0, c1, c2, c3, k0, k1);
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/* 53 random bits as a double in [0,1) */
+static inline double philox_to_double(uint32_t hi, uint32_t lo)
+{
+  return ((((uint64_t)hi << 32) | lo) >> 11)*(1.0/9007199254740992.0);
+}
+
+/* a stream for each thread of each process */
+static inline uint64_t philox_stream_id(int rank, int thread)
+{
+  return ((uint64_t)(uint32_t)rank << 32) | (uint32_t)thread;
+}
+
+static inline philox_t philox_init(uint64_t seed, uint64_t stream)
+{
+  philox_t p;
+
+  p.key[0] = (uint32_t)seed;
+  p.key[1] = (uint32_t)(seed >> 32);
+  p.stream = stream;
+  p.position = 0;
+  return p;
+}
+
+/* jump over the next n doubles */
+static inline void philox_skip(philox_t* p, uint64_t n)
+{
+  p->position += n;
+}
+
+/* double number i of the stream, whatever the position */
+static inline double philox_at(const philox_t* p, uint64_t i)
+{
+  uint32_t out[4];
+  uint64_t block = i >> 1;
+
+  philox4x32_10((uint32_t)block, (uint32_t)(block >> 32), (uint32_t)p->stream,
+                (uint32_t)(p->stream >> 32), p->key[0], p->key[1], out);
+  return (i & 1) ? philox_to_double(out[2], out[3]) : philox_to_double(out[0], out[1]);
+}
+
+/* the next double in [0,1) */
+static inline double philox_uniform(philox_t* p)
+{
+  return philox_at(p, p->position++);
+}
+
+/*
+** The next n doubles, in x.  Each block of the counter is independent of
+** the others, so the loop over blocks vectorises.
+*/
+static inline void philox_uniform_batch(philox_t* p, double* x, long n)
+{
+  uint64_t first;
+  long nblocks, b, i = 0;
+  uint32_t s0 = (uint32_t)p->stream, s1 = (uint32_t)(p->stream >> 32);
+  uint32_t k0 = p->key[0], k1 = p->key[1];
+
+  /* the second half of a block that has been half used */
+  if (n > 0 && (p->position & 1))
+    x[i++] = philox_uniform(p);
+
+  first = p->position >> 1;
+  nblocks = (n - i)/2;
+
+#pragma omp simd
+  for (b = 0; b < nblocks; b++) {
+    uint64_t block = first + b;
+    uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32), c2 = s0, c3 = s1;
+    uint32_t key0 = k0, key1 = k1;
+    PHILOX4X32_10(c0, c1, c2, c3, key0, key1);
+    x[i + 2*b] = philox_to_double(c0, c1);
+    x[i + 2*b + 1] = philox_to_double(c2, c3);
+  }
+  p->position += 2*nblocks;
+  i += 2*nblocks;
+
+  if (i < n)
+    x[i] = philox_uniform(p);
+}
+
+/*
+** x[i] = double number i of stream of seed, for i < n, filled in by the
+** OpenMP threads: the same numbers however many threads there are, and
+** each page is first touched by the thread that filled it.
+*/
+static inline void philox_fill_uniform(double* x, int64_t n, uint64_t seed, uint64_t stream)
+{
+  int64_t start;
+
+#pragma omp parallel for schedule(static)
+  for (start = 0; start < n; start += 4096) {
+    philox_t p = philox_init(seed, stream);
+    philox_skip(&p, start);
+    philox_uniform_batch(&p, &x[start], (n - start < 4096) ? (long)(n - start) : 4096);
+  }
+}
+
+#endif
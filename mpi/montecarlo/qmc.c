@@ -0,0 +1,129 @@
+/*
+** Monte Carlo and quasi-Monte Carlo integration.  See qmc.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "qmc.h"
+#include "sobol.h"
+#include "philox.h"
+#include "partition.h"
+
+/* the sum of f over points first to last-1 of replicate r */
+static double sum_points(mc_integrand_fn f, void* data, int dim, int quasi, uint64_t seed,
+                         int r, int64_t first, int64_t last)
+{
+  double x[SOBOL_MAX_DIM];
+  double sum = 0.0;
+  int64_t i;
+
+  if (quasi) {
+    sobol_t s;
+
+    sobol_init(&s, dim);
+    sobol_scramble(&s, sobol_hash(seed, r));
+    sobol_seek(&s, first);
+    for (i = first; i < last; i++) {
+      sobol_next(&s, x);
+      sum += f(dim, x, data);
+    }
+  }
+  else {
+    /*
+    ** Replicate r is Philox stream r, and point i its numbers i*dim to
+    ** i*dim + dim-1, so each thread jumps straight to its first point.
+    */
+    philox_t rng = philox_init(seed, r);
+    philox_skip(&rng, (uint64_t)first*dim);
+    for (i = first; i < last; i++) {
+      philox_uniform_batch(&rng, x, dim);
+      sum += f(dim, x, data);
+    }
+  }
+  return sum;
+}
+
+static mc_result_t integrate_replicates(mc_integrand_fn f, void* data, int dim, int64_t n,
+                                        int replicates, uint64_t seed, int root, MPI_Comm comm,
+                                        int quasi)
+{
+  mc_result_t result = { 0.0, 0.0, 0 };
+  double *sums, *totals;
+  double mean, var;
+  partition_t mine;
+  int rank, size, r;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  if (dim < 1 || dim > SOBOL_MAX_DIM || n < 1 || replicates < 1 ||
+      (quasi && n > SOBOL_MAX_POINTS)) {
+    fprintf(stderr, "Error: can't integrate with %lld points in %d dimensions, %d replicates\n",
+            (long long)n, dim, replicates);
+    MPI_Abort(comm, 1);
+  }
+
+  sums = malloc(replicates*sizeof(double));
+  totals = malloc(replicates*sizeof(double));
+  if (sums == NULL || totals == NULL) {
+    fprintf(stderr, "Error: could not allocate the sums of %d replicates\n", replicates);
+    MPI_Abort(comm, 1);
+  }
+
+  /* our block of each replicate's points, and each thread's block of ours */
+  mine = partition(n, size, rank);
+  for (r = 0; r < replicates; r++) {
+    double sum = 0.0;
+#pragma omp parallel reduction(+:sum)
+    {
+      int t = 0, nt = 1;
+      partition_t ours;
+#ifdef _OPENMP
+      t = omp_get_thread_num();
+      nt = omp_get_num_threads();
+#endif
+      ours = partition_range(mine, nt, t);
+      sum += sum_points(f, data, dim, quasi, seed, r, ours.first, ours.last);
+    }
+    sums[r] = sum;
+  }
+
+  MPI_Reduce(sums, totals, replicates, MPI_DOUBLE, MPI_SUM, root, comm);
+
+  if (rank == root) {
+    mean = 0.0;
+    for (r = 0; r < replicates; r++)
+      mean += totals[r]/n;
+    mean /= replicates;
+
+    var = 0.0;
+    for (r = 0; r < replicates; r++)
+      var += (totals[r]/n - mean)*(totals[r]/n - mean);
+
+    result.estimate = mean;
+    result.std_error = (replicates > 1) ? sqrt(var/(replicates - 1)/replicates) : 0.0;
+    result.evals = n*replicates;
+  }
+
+  free(sums);
+  free(totals);
+  return result;
+}
+
+mc_result_t qmc_integrate(mc_integrand_fn f, void* data, int dim, int64_t n, int replicates,
+                          uint64_t seed, int root, MPI_Comm comm)
+{
+  return integrate_replicates(f, data, dim, n, replicates, seed, root, comm, 1);
+}
+
+mc_result_t mc_integrate(mc_integrand_fn f, void* data, int dim, int64_t n, int replicates,
+                         uint64_t seed, int root, MPI_Comm comm)
+{
+  return integrate_replicates(f, data, dim, n, replicates, seed, root, comm, 0);
+}
@@ -0,0 +1,42 @@
+/*
+** Monte Carlo and quasi-Monte Carlo integration of f over the unit cube
+** [0,1)^dim, shared out between the processes of an MPI communicator and
+** their OpenMP threads.
+**
+** Both make replicates independent estimates, each the average of f over
+** n points, and return their mean and its standard error (the standard
+** deviation of the estimates over sqrt(replicates)):
+**
+**   qmc_integrate()  each replicate is the first n points of a Sobol
+**                    sequence with its own random digital shift
+**   mc_integrate()   each replicate is n random points, from its own
+**                    Philox stream (philox.h)
+**
+** The n points of each replicate are split into one block per process,
+** and each block into one per thread (see ../integrate/partition.h), so
+** the points, and the answer, are the same however many processes and
+** threads there are.  The sums of each replicate are added up with
+** MPI_Reduce(), and the result is only returned on root.
+*/
+
+#ifndef QMC_H
+#define QMC_H
+
+#include <stdint.h>
+#include <mpi.h>
+
+/* f at the point x[0] to x[dim-1] */
+typedef double (*mc_integrand_fn)(int dim, const double* x, void* data);
+
+typedef struct {
+  double estimate;      /* the mean of the replicates */
+  double std_error;     /* its standard error (0 for one replicate) */
+  int64_t evals;        /* evaluations of f, over all processes */
+} mc_result_t;
+
+mc_result_t qmc_integrate(mc_integrand_fn f, void* data, int dim, int64_t n, int replicates,
+                          uint64_t seed, int root, MPI_Comm comm);
+mc_result_t mc_integrate(mc_integrand_fn f, void* data, int dim, int64_t n, int replicates,
+                         uint64_t seed, int root, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+** Random doubles per second from rand() and from Philox (philox.h), with
+** OpenMP threads:
+**
+**   rand          one thread calling rand(), as in dartboard_pi_send.c
+**   rand-shared   every thread calling rand(), so they all share its state
+**   rand_r        every thread with its own rand_r() state
+**   philox        every thread with its own stream, one number at a time
+**   philox-batch  ... and a batch of BATCH numbers at a time
+**
+** Each makes n numbers in all and uses them as the coordinates of n/2
+** darts, so as a rough check each prints the mean of the numbers and the
+** dartboard estimate of pi.  First, Philox is checked against the known
+** answers of its authors' Random123 library.
+**
+** Usage: rng_bench.exe [n]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "philox.h"
+
+#define N 100000000L
+#define BATCH 4096
+#define SEED 20240607
+
+enum { RAND, RAND_SHARED, RAND_R, PHILOX, PHILOX_BATCH, NMODES };
+static const char* names[NMODES] = { "rand", "rand-shared", "rand_r", "philox", "philox-batch" };
+
+/* Philox4x32-10 of a counter and key, against the Random123 known answers */
+static int known_answers(void)
+{
+  static const uint32_t tests[3][10] = {
+    { 0, 0, 0, 0, 0, 0, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+    { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+      0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+    { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+      0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }
+  };
+  uint32_t out[4];
+  int t, i;
+
+  for (t = 0; t < 3; t++) {
+    philox4x32_10(tests[t][0], tests[t][1], tests[t][2], tests[t][3], tests[t][4], tests[t][5],
+                  out);
+    for (i = 0; i < 4; i++)
+      if (out[i] != tests[t][6 + i])
+        return 0;
+  }
+  return 1;
+}
+
+/* the sum of the n/2 pairs, and the number of them that land in the circle */
+static void darts(const double* x, long n, double* sum, long* hits)
+{
+  long i;
+
+  for (i = 0; i + 1 < n; i += 2) {
+    *sum += x[i] + x[i + 1];
+    if (x[i]*x[i] + x[i + 1]*x[i + 1] <= 1.0)
+      (*hits)++;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  long n = N;
+  int nthreads = omp_get_max_threads();
+  double tic, toc, sum;
+  long hits;
+  int mode;
+
+  if (argc > 1) n = atol(argv[1]);
+  if (argc > 2 || n < 2) {
+    fprintf(stderr, "Usage: %s [n]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  if (!known_answers()) {
+    fprintf(stderr, "Error: Philox4x32-10 does not match the Random123 known answers\n");
+    exit(EXIT_FAILURE);
+  }
+  printf("Philox4x32-10 matches the Random123 known answers\n\n");
+  printf("%ld numbers, %d threads\n\n", n, nthreads);
+  printf("%-14s %10s %14s %10s %12s\n", "generator", "time (s)", "numbers/s", "mean", "pi");
+
+  for (mode = 0; mode < NMODES; mode++) {
+    sum = 0.0;
+    hits = 0;
+    srand(SEED);
+    tic = omp_get_wtime();
+
+#pragma omp parallel reduction(+:sum,hits) if(mode != RAND)
+    {
+      int t = omp_get_thread_num(), nt = omp_get_num_threads();
+      /* our share of the numbers, an even number of them */
+      long first = 2*((n/2)*t/nt), last = 2*((n/2)*(t + 1)/nt);
+      unsigned int seed = SEED + t;
+      philox_t rng = philox_init(SEED, philox_stream_id(0, t));
+      double x[BATCH];
+      long i, j, count;
+
+      for (i = first; i < last; i += count) {
+        count = (last - i < BATCH) ? last - i : BATCH;
+        switch (mode) {
+        case RAND:
+        case RAND_SHARED:
+          for (j = 0; j < count; j++)
+            x[j] = rand()/(double)RAND_MAX;
+          break;
+        case RAND_R:
+          for (j = 0; j < count; j++)
+            x[j] = rand_r(&seed)/(double)RAND_MAX;
+          break;
+        case PHILOX:
+          for (j = 0; j < count; j++)
+            x[j] = philox_uniform(&rng);
+          break;
+        case PHILOX_BATCH:
+          philox_uniform_batch(&rng, x, count);
+          break;
+        }
+        darts(x, count, &sum, &hits);
+      }
+    }
+
+    toc = omp_get_wtime() - tic;
+    printf("%-14s %10.4f %14.3e %10.6f %12.8f\n", names[mode], toc, (n/2*2)/toc,
+           sum/(n/2*2), 4.0*hits/(n/2));
+  }
+
+  return EXIT_SUCCESS;
+}
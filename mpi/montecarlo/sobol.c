@@ -0,0 +1,135 @@
+/*
+** Sobol sequences.  See sobol.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sobol.h"
+
+/*
+** For dimensions 2 onwards: the degree s and coefficients a of a primitive
+** polynomial over GF(2), and the first s direction numbers m (odd, and
+** m[k] < 2^(k+1)), from Joe and Kuo's new-joe-kuo-6.21201.
+*/
+static const struct {
+  int s;
+  int a;
+  uint32_t m[7];
+} table[SOBOL_MAX_DIM - 1] = {
+  { 1,  0, { 1 } },
+  { 2,  1, { 1, 3 } },
+  { 3,  1, { 1, 3, 1 } },
+  { 3,  2, { 1, 1, 1 } },
+  { 4,  1, { 1, 1, 3, 3 } },
+  { 4,  4, { 1, 3, 5, 13 } },
+  { 5,  2, { 1, 1, 5, 5, 17 } },
+  { 5,  4, { 1, 1, 5, 5, 5 } },
+  { 5,  7, { 1, 1, 7, 11, 19 } },
+  { 5, 11, { 1, 1, 5, 1, 1 } },
+  { 5, 13, { 1, 1, 1, 3, 11 } },
+  { 5, 14, { 1, 3, 5, 5, 31 } },
+  { 6,  1, { 1, 3, 3, 9, 7, 49 } },
+  { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+  { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+  { 6, 19, { 1, 1, 1, 15, 7, 5 } },
+  { 6, 22, { 1, 3, 1, 15, 13, 25 } },
+  { 6, 25, { 1, 1, 5, 5, 19, 61 } },
+  { 7,  1, { 1, 3, 7, 11, 23, 15, 103 } },
+  { 7,  4, { 1, 3, 7, 13, 13, 15, 69 } }
+};
+
+uint64_t sobol_hash(uint64_t seed, uint64_t counter)
+{
+  uint64_t z = seed + (counter + 1)*0x9e3779b97f4a7c15ULL;
+
+  z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void sobol_init(sobol_t* s, int dim)
+{
+  int d, k, i, deg, a;
+  uint32_t* v;
+
+  if (dim < 1 || dim > SOBOL_MAX_DIM) {
+    fprintf(stderr, "Error: Sobol sequences of %d dimensions are not supported (1 to %d)\n",
+            dim, SOBOL_MAX_DIM);
+    exit(EXIT_FAILURE);
+  }
+  s->dim = dim;
+
+  /* the first dimension is the van der Corput sequence */
+  for (k = 0; k < SOBOL_BITS; k++)
+    s->v[0][k] = (uint32_t)1 << (SOBOL_BITS - 1 - k);
+
+  /*
+  ** v[k] = m[k]/2^(k+1), as a binary fraction; after the first s, each is
+  ** made from the s before it by the recurrence of the polynomial.
+  */
+  for (d = 1; d < dim; d++) {
+    v = s->v[d];
+    deg = table[d - 1].s;
+    a = table[d - 1].a;
+    for (k = 0; k < deg && k < SOBOL_BITS; k++)
+      v[k] = table[d - 1].m[k] << (SOBOL_BITS - 1 - k);
+    for (k = deg; k < SOBOL_BITS; k++) {
+      v[k] = v[k - deg] ^ (v[k - deg] >> deg);
+      for (i = 1; i < deg; i++)
+        if ((a >> (deg - 1 - i)) & 1)
+          v[k] ^= v[k - i];
+    }
+  }
+
+  for (d = 0; d < dim; d++)
+    s->shift[d] = 0;
+  sobol_seek(s, 0);
+}
+
+void sobol_scramble(sobol_t* s, uint64_t seed)
+{
+  int d;
+
+  for (d = 0; d < s->dim; d++)
+    s->shift[d] = (uint32_t)(sobol_hash(seed, d) >> 32);
+}
+
+void sobol_seek(sobol_t* s, int64_t index)
+{
+  uint64_t gray;
+  int d, k;
+
+  if (index < 0 || index >= SOBOL_MAX_POINTS) {
+    fprintf(stderr, "Error: Sobol point %lld is out of range (0 to 2^%d - 1)\n",
+            (long long)index, SOBOL_BITS);
+    exit(EXIT_FAILURE);
+  }
+
+  gray = (uint64_t)index ^ ((uint64_t)index >> 1);
+  for (d = 0; d < s->dim; d++) {
+    s->x[d] = 0;
+    for (k = 0; k < SOBOL_BITS; k++)
+      if ((gray >> k) & 1)
+        s->x[d] ^= s->v[d][k];
+  }
+  s->index = index;
+}
+
+void sobol_next(sobol_t* s, double* x)
+{
+  const double scale = 1.0/SOBOL_MAX_POINTS;
+  uint64_t next = s->index + 1;
+  int d, k;
+
+  for (d = 0; d < s->dim; d++)
+    x[d] = (s->x[d] ^ s->shift[d])*scale;
+
+  /* Gray codes of n and n+1 differ in the lowest 0 bit of n */
+  if (next < (uint64_t)SOBOL_MAX_POINTS) {
+    for (k = 0; !((next >> k) & 1); k++);
+    for (d = 0; d < s->dim; d++)
+      s->x[d] ^= s->v[d][k];
+  }
+  s->index = next;
+}
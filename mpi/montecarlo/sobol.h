@@ -0,0 +1,57 @@
+/*
+** Sobol sequences: points in the unit cube [0,1)^dim that fill it far more
+** evenly than random points do.  The error of the average of f over the
+** first n points falls nearly as 1/n for smooth f, rather than the
+** 1/sqrt(n) of random points.
+**
+** Each coordinate of point n is the XOR of the direction numbers picked out
+** by the bits of the Gray code of n, so any point can be made directly
+** (sobol_seek()) and the next one with a single XOR per coordinate
+** (sobol_next()).  A block of points can therefore be handed to each
+** process or thread, and together they make exactly the points of the
+** whole sequence.
+**
+** The points are the same every time, so the error can't be estimated from
+** them.  sobol_scramble() XORs every point with a random shift (a random
+** digital shift): each shifted sequence is still evenly spread, but its
+** average is a random, unbiased estimate, so the spread of the averages of
+** a few independently shifted sequences gives the error.
+**
+** The direction numbers are those of Joe and Kuo (2008) for up to
+** SOBOL_MAX_DIM dimensions, with 32 bits, so up to 2^32 points.
+*/
+
+#ifndef SOBOL_H
+#define SOBOL_H
+
+#include <stdint.h>
+
+#define SOBOL_MAX_DIM 21
+#define SOBOL_BITS 32
+#define SOBOL_MAX_POINTS ((int64_t)1 << SOBOL_BITS)
+
+typedef struct {
+  int dim;
+  uint32_t v[SOBOL_MAX_DIM][SOBOL_BITS];  /* direction numbers */
+  uint32_t shift[SOBOL_MAX_DIM];          /* the digital shift, or 0 */
+  uint32_t x[SOBOL_MAX_DIM];              /* the next point, unshifted */
+  int64_t index;                          /* ... and its number */
+} sobol_t;
+
+/* the first dim dimensions, unscrambled, at point 0 */
+void sobol_init(sobol_t* s, int dim);
+/* shift every point by a random shift made from seed */
+void sobol_scramble(sobol_t* s, uint64_t seed);
+/* make point index the next one */
+void sobol_seek(sobol_t* s, int64_t index);
+/* the next point, in x[0] to x[dim-1] */
+void sobol_next(sobol_t* s, double* x);
+
+/*
+** A random 64-bit number made from seed and counter (splitmix64): the same
+** arguments always give the same number, and different ones numbers that
+** look independent.
+*/
+uint64_t sobol_hash(uint64_t seed, uint64_t counter);
+
+#endif
@@ -0,0 +1,141 @@
+/*
+** Quasi-Monte Carlo (scrambled Sobol points) against Monte Carlo (random
+** points) on integrals over the unit cube with known answers:
+**
+**   dartboard  4 if x^2 + y^2 <= 1, else 0, in 2 dimensions: pi, as in
+**              ../example3/dartboard_pi_send.c
+**   exp        exp(x_1 + x_2/2 + ... + x_d/d), which is smooth
+**   g          Sobol's g function, the product of (|4x_i - 2| + i)/(1 + i),
+**              which has a kink in every dimension; its integral is 1
+**
+** in 5, 10 and 20 dimensions.  For 2^m points per replicate, m = 8, 10,
+** ... up to log2_max_points, each prints the error and the estimated
+** (standard) error of both.  Random points need 4 times as many points to
+** halve the error; Sobol points need far fewer.
+**
+** Usage: sobol_qmc.exe [log2_max_points [replicates]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+
+#include "qmc.h"
+#include "sobol.h"
+
+#define LOG2_MAX_POINTS 16
+#define REPLICATES 16
+#define SEED 20240607
+#define MASTER 0
+
+double dartboard(int dim, const double* x, void* data)
+{
+  return (x[0]*x[0] + x[1]*x[1] <= 1.0) ? 4.0 : 0.0;
+}
+
+double exp_sum(int dim, const double* x, void* data)
+{
+  double sum = 0.0;
+  int i;
+
+  for (i = 0; i < dim; i++)
+    sum += x[i]/(i + 1);
+  return exp(sum);
+}
+
+double exp_sum_exact(int dim)
+{
+  double product = 1.0, c;
+  int i;
+
+  for (i = 0; i < dim; i++) {
+    c = 1.0/(i + 1);
+    product *= (exp(c) - 1.0)/c;
+  }
+  return product;
+}
+
+double g_function(int dim, const double* x, void* data)
+{
+  double product = 1.0;
+  int i;
+
+  for (i = 0; i < dim; i++)
+    product *= (fabs(4.0*x[i] - 2.0) + (i + 1))/(2.0 + i);
+  return product;
+}
+
+typedef struct {
+  const char* name;
+  mc_integrand_fn f;
+  int dim;
+} test_t;
+
+static const test_t tests[] = {
+  { "dartboard", dartboard, 2 },
+  { "exp", exp_sum, 5 }, { "exp", exp_sum, 10 }, { "exp", exp_sum, 20 },
+  { "g", g_function, 5 }, { "g", g_function, 10 }, { "g", g_function, 20 }
+};
+#define NTESTS (sizeof(tests)/sizeof(tests[0]))
+
+int main(int argc, char* argv[])
+{
+  int rank, size;
+  int log2_max = LOG2_MAX_POINTS, replicates = REPLICATES;
+  double exact, tic, t_qmc, t_mc;
+  mc_result_t qmc, mc;
+  int tt, m;
+
+  double PI25DT = 3.141592653589793238462643;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (argc > 1) log2_max = atoi(argv[1]);
+  if (argc > 2) replicates = atoi(argv[2]);
+  if (argc > 3 || log2_max < 8 || log2_max > 31 || replicates < 2) {
+    if (rank == MASTER)
+      fprintf(stderr, "Usage: %s [log2_max_points (8 to 31) [replicates (2 or more)]]\n",
+              argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if (rank == MASTER)
+    printf("%d processes, %d replicates; error and standard error of each\n", size, replicates);
+
+  for (tt = 0; tt < (int)NTESTS; tt++) {
+    exact = (tests[tt].f == dartboard) ? PI25DT : (tests[tt].f == exp_sum)
+      ? exp_sum_exact(tests[tt].dim) : 1.0;
+
+    if (rank == MASTER) {
+      printf("\n%s, %d dimensions (exact %.10f)\n", tests[tt].name, tests[tt].dim, exact);
+      printf("%12s %11s %11s %9s   %11s %11s %9s\n", "evals", "QMC error", "std error",
+             "time (s)", "MC error", "std error", "time (s)");
+    }
+
+    for (m = 8; m <= log2_max; m += 2) {
+      int64_t n = (int64_t)1 << m;
+
+      tic = MPI_Wtime();
+      qmc = qmc_integrate(tests[tt].f, NULL, tests[tt].dim, n, replicates, SEED, MASTER,
+                          MPI_COMM_WORLD);
+      t_qmc = MPI_Wtime() - tic;
+
+      tic = MPI_Wtime();
+      mc = mc_integrate(tests[tt].f, NULL, tests[tt].dim, n, replicates, SEED, MASTER,
+                        MPI_COMM_WORLD);
+      t_mc = MPI_Wtime() - tic;
+
+      if (rank == MASTER)
+        printf("%12lld %11.3e %11.3e %9.4f   %11.3e %11.3e %9.4f\n", (long long)qmc.evals,
+               fabs(qmc.estimate - exact), qmc.std_error, t_qmc,
+               fabs(mc.estimate - exact), mc.std_error, t_mc);
+    }
+  }
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
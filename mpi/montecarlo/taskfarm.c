@@ -0,0 +1,212 @@
+/*
+** A task farm.  See taskfarm.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "taskfarm.h"
+#include "partition.h"
+
+#define TAG_RESULT 1   /* worker to master: the results of a chunk, then the time it took */
+#define TAG_WORK 2     /* master to worker: the first and last+1 tasks of a chunk */
+#define TAG_STOP 3     /* master to worker: there are no more */
+
+static const char* names[TASKFARM_NSCHEDULES] = { "static", "dynamic", "guided" };
+
+const char* taskfarm_schedule_name(int schedule)
+{
+  if (schedule < 0 || schedule >= TASKFARM_NSCHEDULES)
+    return NULL;
+  return names[schedule];
+}
+
+int taskfarm_schedule_find(const char* name)
+{
+  int s;
+
+  for (s = 0; s < TASKFARM_NSCHEDULES; s++)
+    if (strcmp(name, names[s]) == 0)
+      return s;
+  return -1;
+}
+
+/* the results of tasks first to last-1, in result, and the time they took */
+static double run_tasks(taskfarm_fn f, void* data, int64_t first, int64_t last, int nresults,
+                        double* result)
+{
+  double tic = MPI_Wtime();
+  int i;
+
+  for (i = 0; i < nresults; i++)
+    result[i] = 0.0;
+  if (first < last)
+    f(first, last, result, data);
+  return MPI_Wtime() - tic;
+}
+
+/* the size of the next chunk, with remaining tasks left */
+static int64_t chunk_size(int schedule, int64_t chunk, int64_t remaining, int nworkers)
+{
+  int64_t n = chunk;
+
+  if (schedule == TASKFARM_GUIDED) {
+    n = remaining/(2*(int64_t)nworkers);
+    if (n < chunk)
+      n = chunk;
+  }
+  return (n < remaining) ? n : remaining;
+}
+
+static void farm_static(taskfarm_fn f, void* data, int64_t ntasks, int nresults,
+                        double* result, int root, MPI_Comm comm, taskfarm_stats_t* stats)
+{
+  partition_t mine;
+  double* local;
+  double busy;
+  int rank, size;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  local = malloc(nresults*sizeof(double));
+  if (local == NULL) {
+    fprintf(stderr, "Error: could not allocate %d results\n", nresults);
+    MPI_Abort(comm, 1);
+  }
+
+  mine = partition(ntasks, size, rank);
+  busy = run_tasks(f, data, mine.first, mine.last, nresults, local);
+
+  MPI_Reduce(local, result, nresults, MPI_DOUBLE, MPI_SUM, root, comm);
+  MPI_Reduce(&busy, &stats->min_busy, 1, MPI_DOUBLE, MPI_MIN, root, comm);
+  MPI_Reduce(&busy, &stats->max_busy, 1, MPI_DOUBLE, MPI_MAX, root, comm);
+  MPI_Reduce(&busy, &stats->total_busy, 1, MPI_DOUBLE, MPI_SUM, root, comm);
+  stats->chunks = size;
+  stats->workers = size;
+
+  free(local);
+}
+
+static void farm_master(int64_t ntasks, int nresults, double* result, int schedule,
+                        int64_t chunk, MPI_Comm comm, taskfarm_stats_t* stats)
+{
+  double *buffer, *busy;
+  int64_t next = 0, range[2] = { 0, 0 };
+  int rank, size, active, i;
+  MPI_Status status;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  buffer = malloc((nresults + 1)*sizeof(double));
+  busy = calloc(size, sizeof(double));
+  if (buffer == NULL || busy == NULL) {
+    fprintf(stderr, "Error: could not allocate the master's buffers\n");
+    MPI_Abort(comm, 1);
+  }
+
+  for (i = 0; i < nresults; i++)
+    result[i] = 0.0;
+
+  /* a request from whoever is ready, with the results of its last chunk */
+  active = size - 1;
+  while (active > 0) {
+    MPI_Recv(buffer, nresults + 1, MPI_DOUBLE, MPI_ANY_SOURCE, TAG_RESULT, comm, &status);
+    for (i = 0; i < nresults; i++)
+      result[i] += buffer[i];
+    busy[status.MPI_SOURCE] += buffer[nresults];
+
+    if (next < ntasks) {
+      range[0] = next;
+      range[1] = next + chunk_size(schedule, chunk, ntasks - next, size - 1);
+      next = range[1];
+      MPI_Send(range, 2, MPI_INT64_T, status.MPI_SOURCE, TAG_WORK, comm);
+      stats->chunks++;
+    }
+    else {
+      MPI_Send(range, 0, MPI_INT64_T, status.MPI_SOURCE, TAG_STOP, comm);
+      active--;
+    }
+  }
+
+  stats->workers = size - 1;
+  stats->min_busy = -1.0;
+  stats->max_busy = 0.0;
+  stats->total_busy = 0.0;
+  for (i = 0; i < size; i++) {
+    if (i == rank)
+      continue;
+    if (stats->min_busy < 0.0 || busy[i] < stats->min_busy)
+      stats->min_busy = busy[i];
+    if (busy[i] > stats->max_busy)
+      stats->max_busy = busy[i];
+    stats->total_busy += busy[i];
+  }
+
+  free(buffer);
+  free(busy);
+}
+
+static void farm_worker(taskfarm_fn f, void* data, int nresults, int root, MPI_Comm comm)
+{
+  double* buffer;
+  int64_t range[2];
+  int i;
+  MPI_Status status;
+
+  buffer = malloc((nresults + 1)*sizeof(double));
+  if (buffer == NULL) {
+    fprintf(stderr, "Error: could not allocate %d results\n", nresults);
+    MPI_Abort(comm, 1);
+  }
+
+  /* the first request has no results */
+  for (i = 0; i <= nresults; i++)
+    buffer[i] = 0.0;
+
+  for (;;) {
+    MPI_Send(buffer, nresults + 1, MPI_DOUBLE, root, TAG_RESULT, comm);
+    MPI_Recv(range, 2, MPI_INT64_T, root, MPI_ANY_TAG, comm, &status);
+    if (status.MPI_TAG == TAG_STOP)
+      break;
+    buffer[nresults] = run_tasks(f, data, range[0], range[1], nresults, buffer);
+  }
+
+  free(buffer);
+}
+
+taskfarm_stats_t taskfarm_run(taskfarm_fn f, void* data, int64_t ntasks, int nresults,
+                              double* result, int schedule, int64_t chunk, int root,
+                              MPI_Comm comm)
+{
+  taskfarm_stats_t stats = { 0, 0, 0.0, 0.0, 0.0, 0.0 };
+  MPI_Comm farm;
+  double tic;
+  int rank, size;
+
+  if (taskfarm_schedule_name(schedule) == NULL || ntasks < 0 || nresults < 1 || chunk < 1) {
+    fprintf(stderr, "Error: can't farm out %lld tasks with %d results, schedule %d, chunk %lld\n",
+            (long long)ntasks, nresults, schedule, (long long)chunk);
+    MPI_Abort(comm, 1);
+  }
+
+  /* our own communicator, so that our messages can't be mixed up with the caller's */
+  MPI_Comm_dup(comm, &farm);
+  MPI_Comm_rank(farm, &rank);
+  MPI_Comm_size(farm, &size);
+
+  tic = MPI_Wtime();
+  if (schedule == TASKFARM_STATIC || size == 1)
+    farm_static(f, data, ntasks, nresults, result, root, farm, &stats);
+  else if (rank == root)
+    farm_master(ntasks, nresults, result, schedule, chunk, farm, &stats);
+  else
+    farm_worker(f, data, nresults, root, farm);
+  stats.elapsed = MPI_Wtime() - tic;
+
+  MPI_Comm_free(&farm);
+  return stats;
+}
@@ -0,0 +1,62 @@
+/*
+** A task farm: tasks 0 to ntasks-1, of any cost, shared out between the
+** processes of a communicator, with their results added up.
+**
+** dartboard_pi_send.c and the trapezoid examples split their work into
+** equal blocks, one per process, in advance.  That is fine when every
+** piece of work costs the same, but when the costs vary a lot most of the
+** processes finish early and wait for the slowest.  A farm hands the work
+** out as it goes instead:
+**
+**   static   each process does its block of the tasks (partition.h) and
+**            the results are added up with MPI_Reduce(), for comparison
+**   dynamic  the root is a master that does no tasks itself: every other
+**            process asks it for a chunk of chunk tasks, does them, sends
+**            back their results with its next request (received with
+**            MPI_ANY_SOURCE, so whoever finishes first is served first),
+**            and so on until the tasks run out.  The master adds each
+**            result to the total as it arrives
+**   guided   ... with chunks of the remaining tasks over twice the number of
+**            workers, but no fewer than chunk: big chunks to begin with,
+**            for few messages, and small ones near the end, so the workers
+**            finish together (as OpenMP's schedule(guided))
+**
+**   taskfarm_stats_t s = taskfarm_run(f, data, ntasks, nresults, result,
+**                                     TASKFARM_GUIDED, 1, MASTER, comm);
+**
+** f(first, last, result, data) adds the results of tasks first to last-1
+** to result[0] to result[nresults-1].  The totals are returned in result,
+** and the statistics in s, on the root only.  With one process, the root
+** does every task itself, whatever the schedule.
+*/
+
+#ifndef TASKFARM_H
+#define TASKFARM_H
+
+#include <stdint.h>
+#include <mpi.h>
+
+enum { TASKFARM_STATIC, TASKFARM_DYNAMIC, TASKFARM_GUIDED, TASKFARM_NSCHEDULES };
+
+typedef void (*taskfarm_fn)(int64_t first, int64_t last, double* result, void* data);
+
+typedef struct {
+  int64_t chunks;       /* chunks handed out (one per process for static) */
+  int workers;          /* processes that did tasks */
+  double min_busy;      /* the least and most time a worker spent in f */
+  double max_busy;
+  double total_busy;    /* ... and all of them together */
+  double elapsed;       /* from the start to the last result */
+} taskfarm_stats_t;
+
+/* the name of a schedule, as in the table above, or NULL if there is none */
+const char* taskfarm_schedule_name(int schedule);
+/* the schedule with that name, or -1 if there is none */
+int taskfarm_schedule_find(const char* name);
+
+/* collective over comm */
+taskfarm_stats_t taskfarm_run(taskfarm_fn f, void* data, int64_t ntasks, int nresults,
+                              double* result, int schedule, int64_t chunk, int root,
+                              MPI_Comm comm);
+
+#endif
@@ -0,0 +1,172 @@
+/*
+** How should threads add up into one total?  Each of these estimates pi
+** as in serial_pi.c, with the partial sums kept in a different way:
+**
+**   critical    one shared sum, updated in an omp critical region, as in
+**               parallel_shared_pi.c
+**   atomic      one shared sum, updated with omp atomic
+**   array-s     an array of partial sums, one per thread, s doubles apart:
+**               array-1 is parallel_array_pi.c, and from s = 8 (64 bytes)
+**               each sum has a cache line of its own
+**   padded      a padded_double_t per thread (see padded.h)
+**   reduction   a reduction clause, as in reduction_pi.c
+**
+** The array sums are updated through a volatile pointer, so that each
+** update really goes to memory, as it would in a kernel with more going
+** on, rather than being kept in a register until the end of the loop.
+**
+** Each is run with 1, 2, 4, ... threads up to max_threads, and the table
+** gives the best time of repeats runs.
+**
+** Usage: false_sharing.exe [num_steps [max_threads [repeats]]]
+*/
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include<omp.h>
+
+#include "padded.h"
+
+#define NUM_STEPS 10000000
+#define REPEATS 3
+#define MAX_STRIDE 16   /* doubles between the array sums, at most */
+
+enum { CRITICAL, ATOMIC, ARRAY, PADDED, REDUCTION };
+
+/* step times the sum of the terms, with the sums kept by mode */
+static double estimate(int mode, int stride, long num_steps, double step, int nthreads)
+{
+  double sum = 0.0;
+  double* array = NULL;
+  padded_double_t* padded = NULL;
+  long ii;
+
+  if (mode == ARRAY) {
+    array = calloc(nthreads*stride, sizeof(double));
+    if (array == NULL) {
+      fprintf(stderr, "Error: could not allocate the partial sums\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (mode == PADDED)
+    padded = padded_alloc(nthreads);
+
+  switch (mode) {
+  case CRITICAL:
+#pragma omp parallel for num_threads(nthreads)
+    for (ii = 0; ii < num_steps; ii++) {
+      double x = (ii + 0.5)*step;
+#pragma omp critical
+      sum += 4.0/(1.0 + x*x);
+    }
+    break;
+
+  case ATOMIC:
+#pragma omp parallel for num_threads(nthreads)
+    for (ii = 0; ii < num_steps; ii++) {
+      double x = (ii + 0.5)*step;
+#pragma omp atomic
+      sum += 4.0/(1.0 + x*x);
+    }
+    break;
+
+  case ARRAY:
+  case PADDED:
+#pragma omp parallel num_threads(nthreads)
+    {
+      int t = omp_get_thread_num();
+      volatile double* mine = (mode == ARRAY) ? &array[t*stride] : &padded[t].value;
+      long jj;
+
+#pragma omp for
+      for (jj = 0; jj < num_steps; jj++) {
+        double x = (jj + 0.5)*step;
+        *mine += 4.0/(1.0 + x*x);
+      }
+    }
+    if (mode == ARRAY)
+      for (ii = 0; ii < nthreads; ii++)
+        sum += array[ii*stride];
+    else
+      sum = padded_sum(padded, nthreads);
+    break;
+
+  case REDUCTION:
+#pragma omp parallel for num_threads(nthreads) reduction(+:sum)
+    for (ii = 0; ii < num_steps; ii++) {
+      double x = (ii + 0.5)*step;
+      sum += 4.0/(1.0 + x*x);
+    }
+    break;
+  }
+
+  free(array);
+  if (padded != NULL)
+    padded_free(padded);
+
+  return step*sum;
+}
+
+int main(int argc, char* argv[])
+{
+  long num_steps = NUM_STEPS;     /* number of steps over which to estimate pi */
+  int max_threads = omp_get_max_threads();
+  int repeats = REPEATS;
+  double step;                    /* the step size */
+  double pi, best, tic, toc;
+  char name[32];
+  int mode, stride, nthreads, rr;
+
+  double PI25DT = 3.141592653589793238462643;
+
+  if (argc > 1) num_steps = atol(argv[1]);
+  if (argc > 2) max_threads = atoi(argv[2]);
+  if (argc > 3) repeats = atoi(argv[3]);
+  if (argc > 4 || num_steps < 1 || max_threads < 1 || repeats < 1) {
+    fprintf(stderr, "Usage: %s [num_steps [max_threads [repeats]]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  /* step size is dependent upon the number of steps */
+  step = 1.0/(double) num_steps;
+
+  printf("%ld steps, best time (s) of %d runs, %d byte cache lines\n\n", num_steps, repeats,
+         CACHE_LINE);
+  printf("%-12s", "threads");
+  for (nthreads = 1; nthreads < 2*max_threads; nthreads *= 2)
+    printf(" %9d", nthreads < max_threads ? nthreads : max_threads);
+  printf("   %s\n", "error");
+
+  for (mode = CRITICAL; mode <= REDUCTION; mode++) {
+    for (stride = 1; stride <= (mode == ARRAY ? MAX_STRIDE : 1); stride *= 2) {
+      switch (mode) {
+      case CRITICAL:  sprintf(name, "critical"); break;
+      case ATOMIC:    sprintf(name, "atomic"); break;
+      case ARRAY:     sprintf(name, "array-%d", stride); break;
+      case PADDED:    sprintf(name, "padded"); break;
+      case REDUCTION: sprintf(name, "reduction"); break;
+      }
+      printf("%-12s", name);
+
+      pi = 0.0;
+      for (nthreads = 1; nthreads < 2*max_threads; nthreads *= 2) {
+        /* the last column is always max_threads, power of two or not */
+        int nt = nthreads < max_threads ? nthreads : max_threads;
+
+        best = 0.0;
+        for (rr = 0; rr < repeats; rr++) {
+          tic = omp_get_wtime();
+          pi = estimate(mode, stride, num_steps, step, nt);
+          toc = omp_get_wtime() - tic;
+          if (rr == 0 || toc < best) best = toc;
+        }
+        printf(" %9.4f", best);
+        fflush(stdout);
+      }
+      printf("   %.1e\n", fabs(pi - PI25DT));
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/*
+** Per-thread accumulators that don't share cache lines.
+**
+** In parallel_array_pi.c the partial sums are side by side in one small
+** array, so several of them sit in each cache line.  Whenever one thread
+** writes its sum, the line has to be taken away from every other core that
+** holds it, even though no other thread ever reads that sum: false sharing.
+**
+** A padded_double_t fills a whole cache line, and padded_alloc() puts each
+** one at the start of a line, so each thread has a line of its own:
+**
+**   padded_double_t* sum = padded_alloc(omp_get_max_threads());
+**   ...
+**   sum[omp_get_thread_num()].value += x;
+**   ...
+**   total = padded_sum(sum, omp_get_max_threads());
+**   padded_free(sum);
+*/
+
+#ifndef PADDED_H
+#define PADDED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* 64 bytes on x86 and most ARM; some CPUs fetch lines in pairs, so try 128 */
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+typedef struct {
+  double value;
+  char pad[CACHE_LINE - sizeof(double)];
+} padded_double_t;
+
+/* n accumulators, set to zero, each at the start of its own cache line */
+static inline padded_double_t* padded_alloc(int n)
+{
+  void* p = NULL;
+  int ii;
+
+  if (posix_memalign(&p, CACHE_LINE, n*sizeof(padded_double_t)) != 0) {
+    fprintf(stderr, "Error: could not allocate %d padded accumulators\n", n);
+    exit(EXIT_FAILURE);
+  }
+  for (ii = 0; ii < n; ii++)
+    ((padded_double_t*)p)[ii].value = 0.0;
+  return (padded_double_t*)p;
+}
+
+static inline void padded_free(padded_double_t* p)
+{
+  free(p);
+}
+
+/* the total of the n accumulators */
+static inline double padded_sum(const padded_double_t* p, int n)
+{
+  double total = 0.0;
+  int ii;
+
+  for (ii = 0; ii < n; ii++)
+    total += p[ii].value;
+  return total;
+}
+
+#endif
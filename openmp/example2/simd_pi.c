@@ -0,0 +1,324 @@
+/*
+** The reduction of reduction_pi.c adds every term into one double per
+** thread.  Each add has to wait for the one before it, so the loop runs at
+** one add per add latency (several cycles) however wide the vector units
+** are, and the rounding error of each add builds up over num_steps terms.
+**
+** Here each thread works through its share of the steps with one of these
+** kernels:
+**
+**   naive     one accumulator, as in reduction_pi.c
+**   simd      omp simd reduction: one accumulator per vector lane
+**   lanes     LANES independent accumulators, enough to fill the pipeline
+**   kahan     LANES accumulators, each with Kahan's compensation
+**   neumaier  LANES accumulators, each with Neumaier's compensation
+**   pairwise  LANES accumulators over blocks of BLOCK terms, and the block
+**             sums added pairwise
+**
+** The threads' sums are added up in thread order with Neumaier's
+** compensation, so the answer doesn't depend on which thread finishes
+** first.  Each kernel is run repeats times and the best time is reported,
+** with the error against PI25DT.
+**
+** Usage: simd_pi.exe [num_steps [repeats]]
+*/
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include<omp.h>
+
+#define NUM_STEPS 100000000
+#define REPEATS 5
+#define LANES 16      /* independent accumulators per thread */
+#define BLOCK 1024    /* terms per block for pairwise summation */
+#define MAX_LEVELS 64 /* enough for 2^64 blocks */
+
+/*
+** The integrand at x.  The vector loops below work out x from a double
+** base and an int offset, (base + jj)*step: x86 can convert a vector of
+** ints to doubles, but not a vector of longs before AVX-512, and a loop
+** that needs that conversion in every lane doesn't vectorise.
+*/
+#define TERM(x) (4.0/(1.0 + (x)*(x)))
+
+/* add v to the compensated sum (*s, *c) */
+static void neumaier_add(double* s, double* c, double v)
+{
+  double t = *s + v;
+
+  if (fabs(*s) >= fabs(v))
+    *c += (*s - t) + v;
+  else
+    *c += (v - t) + *s;
+  *s = t;
+}
+
+/*
+** Each kernel adds up the terms first to last-1, into a sum and a
+** correction to it.
+*/
+typedef void (*kernel_fn)(long first, long last, double step, double* sum, double* comp);
+
+static void naive(long first, long last, double step, double* sum, double* comp)
+{
+  double s = 0.0;
+  long ii;
+
+  for (ii = first; ii < last; ii++)
+    s += TERM((ii + 0.5)*step);
+  *sum = s;
+  *comp = 0.0;
+}
+
+/* in blocks of BLOCK terms, so that the offset in a block fits in an int */
+static void simd(long first, long last, double step, double* sum, double* comp)
+{
+  double s = 0.0, base;
+  long ii;
+  int jj, n;
+
+  for (ii = first; ii < last; ii += BLOCK) {
+    n = (last - ii < BLOCK) ? (int)(last - ii) : BLOCK;
+    base = ii + 0.5;
+#pragma omp simd reduction(+:s)
+    for (jj = 0; jj < n; jj++)
+      s += TERM((base + jj)*step);
+  }
+  *sum = s;
+  *comp = 0.0;
+}
+
+/* the sum of the lanes, added pairwise */
+static double fold(double* acc)
+{
+  int width, jj;
+
+  for (width = LANES/2; width > 0; width /= 2)
+    for (jj = 0; jj < width; jj++)
+      acc[jj] += acc[jj + width];
+  return acc[0];
+}
+
+/*
+** Term ii goes into accumulator ii%LANES.  The inner loop is over the
+** accumulators, which are independent, so the compiler can keep them in
+** LANES/(vector width) registers and start a new vector add every cycle.
+*/
+static double lanes_sum(long first, long last, double step)
+{
+  double acc[LANES] = { 0.0 };
+  double base;
+  long ii;
+  int jj;
+
+  for (ii = first; ii + LANES <= last; ii += LANES) {
+    base = ii + 0.5;
+#pragma omp simd
+    for (jj = 0; jj < LANES; jj++)
+      acc[jj] += TERM((base + jj)*step);
+  }
+  for (jj = 0; ii < last; ii++, jj++)
+    acc[jj] += TERM((ii + 0.5)*step);
+
+  return fold(acc);
+}
+
+static void lanes(long first, long last, double step, double* sum, double* comp)
+{
+  *sum = lanes_sum(first, last, step);
+  *comp = 0.0;
+}
+
+/*
+** Kahan: c is the part of the last term that was lost when it was added
+** to s, and is taken off the next one.  The compiler must not simplify
+** (t - s) - y to 0, so don't build this with -ffast-math.
+*/
+static void kahan(long first, long last, double step, double* sum, double* comp)
+{
+  double s[LANES] = { 0.0 }, c[LANES] = { 0.0 };
+  double y, t, base;
+  long ii;
+  int jj;
+
+  for (ii = first; ii + LANES <= last; ii += LANES) {
+    base = ii + 0.5;
+#pragma omp simd private(y,t)
+    for (jj = 0; jj < LANES; jj++) {
+      y = TERM((base + jj)*step) - c[jj];
+      t = s[jj] + y;
+      c[jj] = (t - s[jj]) - y;
+      s[jj] = t;
+    }
+  }
+  for (jj = 0; ii < last; ii++, jj++) {
+    y = TERM((ii + 0.5)*step) - c[jj];
+    t = s[jj] + y;
+    c[jj] = (t - s[jj]) - y;
+    s[jj] = t;
+  }
+
+  *sum = *comp = 0.0;
+  for (jj = 0; jj < LANES; jj++) {
+    neumaier_add(sum, comp, s[jj]);
+    neumaier_add(sum, comp, -c[jj]);
+  }
+}
+
+/*
+** Neumaier: the lost parts are added up separately and added on at the
+** end, and the lost part is right even when the term is bigger than the
+** sum so far.
+*/
+static void neumaier(long first, long last, double step, double* sum, double* comp)
+{
+  double s[LANES] = { 0.0 }, c[LANES] = { 0.0 };
+  double y, t, big, small, base;
+  long ii;
+  int jj;
+
+  /* choosing the operands, not the expression, leaves no branch in the loop */
+  for (ii = first; ii + LANES <= last; ii += LANES) {
+    base = ii + 0.5;
+#pragma omp simd private(y,t,big,small)
+    for (jj = 0; jj < LANES; jj++) {
+      y = TERM((base + jj)*step);
+      t = s[jj] + y;
+      big = (fabs(s[jj]) >= fabs(y)) ? s[jj] : y;
+      small = (fabs(s[jj]) >= fabs(y)) ? y : s[jj];
+      c[jj] += (big - t) + small;
+      s[jj] = t;
+    }
+  }
+  for (; ii < last; ii++)
+    neumaier_add(&s[0], &c[0], TERM((ii + 0.5)*step));
+
+  *sum = *comp = 0.0;
+  for (jj = 0; jj < LANES; jj++) {
+    neumaier_add(sum, comp, s[jj]);
+    neumaier_add(sum, comp, c[jj]);
+  }
+}
+
+/*
+** Each block of BLOCK terms is added up by lanes_sum(), and the blocks are
+** added pairwise: the stack holds the sums of 2^k blocks for the 1 bits k
+** of the number of blocks so far, so the error grows as log(num_steps)
+** rather than num_steps, with no more than MAX_LEVELS doubles of storage.
+*/
+static void pairwise(long first, long last, double step, double* sum, double* comp)
+{
+  double stack[MAX_LEVELS];
+  double v;
+  long ii, count = 0, kk;
+  int top = 0;
+
+  for (ii = first; ii < last; ii += BLOCK) {
+    v = lanes_sum(ii, (last - ii < BLOCK) ? last : ii + BLOCK, step);
+    count++;
+    for (kk = count; (kk & 1) == 0; kk >>= 1)
+      v += stack[--top];
+    stack[top++] = v;
+  }
+
+  /* the smallest sums first */
+  v = 0.0;
+  while (top > 0)
+    v += stack[--top];
+  *sum = v;
+  *comp = 0.0;
+}
+
+typedef struct {
+  const char* name;
+  kernel_fn kernel;
+} sum_mode_t;
+
+static const sum_mode_t modes[] = {
+  { "naive", naive }, { "simd", simd }, { "lanes", lanes },
+  { "kahan", kahan }, { "neumaier", neumaier }, { "pairwise", pairwise }
+};
+#define NMODES (sizeof(modes)/sizeof(modes[0]))
+
+/* step times the sum of all the terms, shared out between the threads */
+static double estimate(kernel_fn kernel, long num_steps, double step, int nthreads,
+                       double* sums, double* comps)
+{
+  double sum = 0.0, comp = 0.0;
+  int tt;
+
+  /* in case we are given fewer threads than we asked for */
+  for (tt = 0; tt < nthreads; tt++)
+    sums[tt] = comps[tt] = 0.0;
+
+#pragma omp parallel num_threads(nthreads)
+  {
+    long t = omp_get_thread_num();
+    long nt = omp_get_num_threads();
+    /* the first num_steps%nt threads get one extra step */
+    long first = num_steps/nt*t + (t < num_steps%nt ? t : num_steps%nt);
+    long last = first + num_steps/nt + (t < num_steps%nt ? 1 : 0);
+
+    kernel(first, last, step, &sums[t], &comps[t]);
+  }
+
+  for (tt = 0; tt < nthreads; tt++) {
+    neumaier_add(&sum, &comp, sums[tt]);
+    neumaier_add(&sum, &comp, comps[tt]);
+  }
+  return step*(sum + comp);
+}
+
+int main(int argc, char* argv[])
+{
+  long num_steps = NUM_STEPS;     /* number of steps over which to estimate pi */
+  int repeats = REPEATS;
+  int nthreads = omp_get_max_threads();
+  double step;                    /* the step size */
+  double pi, best, tic, toc;
+  double* sums;                   /* each thread's sum ... */
+  double* comps;                  /* ... and the correction to it */
+  int mm, rr;
+
+  double PI25DT = 3.141592653589793238462643;
+
+  if (argc > 1) num_steps = atol(argv[1]);
+  if (argc > 2) repeats = atoi(argv[2]);
+  if (argc > 3 || num_steps < 1 || repeats < 1) {
+    fprintf(stderr, "Usage: %s [num_steps [repeats]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  sums = malloc(nthreads*sizeof(double));
+  comps = malloc(nthreads*sizeof(double));
+  if (sums == NULL || comps == NULL) {
+    fprintf(stderr, "Error: could not allocate the partial sums\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* step size is dependent upon the number of steps */
+  step = 1.0/(double) num_steps;
+
+  printf("%ld steps, %d threads, %d accumulators per thread, best of %d\n\n",
+         num_steps, nthreads, LANES, repeats);
+  printf("%-10s %20s %12s %10s %12s\n", "mode", "pi", "error", "time (s)", "Gsteps/s");
+
+  for (mm = 0; mm < (int)NMODES; mm++) {
+    best = 0.0;
+    pi = 0.0;
+    for (rr = 0; rr < repeats; rr++) {
+      tic = omp_get_wtime();
+      pi = estimate(modes[mm].kernel, num_steps, step, nthreads, sums, comps);
+      toc = omp_get_wtime() - tic;
+      if (rr == 0 || toc < best) best = toc;
+    }
+    printf("%-10s %20.16f %12.3e %10.4f %12.3f\n", modes[mm].name, pi, fabs(pi - PI25DT),
+           best, num_steps/best*1e-9);
+  }
+
+  free(sums);
+  free(comps);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/*
+** Batched GEMM for many small matrices, with kernels specialised on their
+** size at compile-time.
+**
+** For a 4x4 or 8x8 multiply, the loop overhead of a general kernel, or the
+** cost of a call to dgemm_ and its argument checking, is as large as the
+** arithmetic.  Here M, N and K are template parameters, so the compiler
+** knows every trip count: the loops are unrolled, a block of C is kept in
+** vector registers and nothing is checked at run-time.
+**
+** All matrices are column-major, C = alpha*A*B + beta*C, and a batch is
+** given either as:
+**
+**   strided  - one array, with matrix b at offset b*stride
+**   pointers - an array of pointers, one per matrix
+**
+** The matrices of a batch are shared out between OpenMP threads.
+** gemm_batch_strided() and gemm_batch_pointers() with run-time sizes pick a
+** specialised kernel when there is one, and fall back to a plain loop.
+*/
+
+#ifndef BATCHED_GEMM_HPP
+#define BATCHED_GEMM_HPP
+
+namespace batched {
+
+/* JB columns of C, starting at column j, each column held in registers */
+template <int M, int JB, int K, typename T>
+inline void gemm_columns(int j, T alpha, const T* __restrict A, int lda, const T* __restrict B, int ldb,
+                         T beta, T* __restrict C, int ldc)
+{
+  T c[JB][M] = {};
+
+  for (int p = 0; p < K; ++p) {
+    for (int jj = 0; jj < JB; ++jj) {
+      const T b = B[p + (j + jj) * ldb];
+#pragma omp simd
+      for (int i = 0; i < M; ++i)
+        c[jj][i] += A[i + p * lda] * b;
+    }
+  }
+
+  for (int jj = 0; jj < JB; ++jj) {
+    T* cj = C + (j + jj) * ldc;
+    if (beta == T(0)) {
+#pragma omp simd
+      for (int i = 0; i < M; ++i)
+        cj[i] = alpha * c[jj][i];
+    }
+    else {
+#pragma omp simd
+      for (int i = 0; i < M; ++i)
+        cj[i] = alpha * c[jj][i] + beta * cj[i];
+    }
+  }
+}
+
+/*
+** One M x N x K multiply, fully unrolled.  Columns of C are done JB at a
+** time, so that each element of A loaded is used JB times; JB is chosen to
+** keep about 64 elements of C in registers.
+*/
+template <int M, int N, int K, typename T>
+inline void gemm_fixed(T alpha, const T* __restrict A, int lda, const T* __restrict B, int ldb,
+                       T beta, T* __restrict C, int ldc)
+{
+  constexpr int JB = (64 / M < 1) ? 1 : (64 / M > N) ? N : 64 / M;
+  constexpr int NMAIN = N - N % JB;
+
+  for (int j = 0; j < NMAIN; j += JB)
+    gemm_columns<M, JB, K>(j, alpha, A, lda, B, ldb, beta, C, ldc);
+  for (int j = NMAIN; j < N; ++j)
+    gemm_columns<M, 1, K>(j, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+/* the same with run-time sizes, for shapes without a specialisation */
+template <typename T>
+inline void gemm_any(int m, int n, int k, T alpha, const T* __restrict A, int lda,
+                     const T* __restrict B, int ldb, T beta, T* __restrict C, int ldc)
+{
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < m; ++i)
+      C[i + j * ldc] = (beta == T(0)) ? T(0) : beta * C[i + j * ldc];
+    for (int p = 0; p < k; ++p) {
+      const T b = alpha * B[p + j * ldb];
+      for (int i = 0; i < m; ++i)
+        C[i + j * ldc] += A[i + p * lda] * b;
+    }
+  }
+}
+
+template <int M, int N, int K, typename T>
+void gemm_batch_strided(long batch, T alpha, const T* A, int lda, long stride_a,
+                        const T* B, int ldb, long stride_b, T beta, T* C, int ldc, long stride_c)
+{
+#pragma omp parallel for schedule(static)
+  for (long b = 0; b < batch; ++b)
+    gemm_fixed<M, N, K>(alpha, A + b * stride_a, lda, B + b * stride_b, ldb,
+                        beta, C + b * stride_c, ldc);
+}
+
+template <int M, int N, int K, typename T>
+void gemm_batch_pointers(long batch, T alpha, const T* const* A, int lda, const T* const* B, int ldb,
+                         T beta, T* const* C, int ldc)
+{
+#pragma omp parallel for schedule(static)
+  for (long b = 0; b < batch; ++b)
+    gemm_fixed<M, N, K>(alpha, A[b], lda, B[b], ldb, beta, C[b], ldc);
+}
+
+/*
+** The run-time interface: square sizes 4, 8, 12, 16, 24 and 32 go to a
+** specialised kernel and anything else to gemm_any().
+*/
+#define BATCHED_SIZES(X) X(4) X(8) X(12) X(16) X(24) X(32)
+
+template <typename T>
+void gemm_batch_strided(int m, int n, int k, long batch, T alpha, const T* A, int lda, long stride_a,
+                        const T* B, int ldb, long stride_b, T beta, T* C, int ldc, long stride_c)
+{
+  if (m == n && n == k) {
+    switch (m) {
+#define BATCHED_CASE(S)                                                               \
+    case S:                                                                           \
+      gemm_batch_strided<S, S, S>(batch, alpha, A, lda, stride_a, B, ldb, stride_b,   \
+                                  beta, C, ldc, stride_c);                            \
+      return;
+      BATCHED_SIZES(BATCHED_CASE)
+#undef BATCHED_CASE
+    }
+  }
+#pragma omp parallel for schedule(static)
+  for (long b = 0; b < batch; ++b)
+    gemm_any(m, n, k, alpha, A + b * stride_a, lda, B + b * stride_b, ldb,
+             beta, C + b * stride_c, ldc);
+}
+
+template <typename T>
+void gemm_batch_pointers(int m, int n, int k, long batch, T alpha, const T* const* A, int lda,
+                         const T* const* B, int ldb, T beta, T* const* C, int ldc)
+{
+  if (m == n && n == k) {
+    switch (m) {
+#define BATCHED_CASE(S)                                                               \
+    case S:                                                                           \
+      gemm_batch_pointers<S, S, S>(batch, alpha, A, lda, B, ldb, beta, C, ldc);       \
+      return;
+      BATCHED_SIZES(BATCHED_CASE)
+#undef BATCHED_CASE
+    }
+  }
+#pragma omp parallel for schedule(static)
+  for (long b = 0; b < batch; ++b)
+    gemm_any(m, n, k, alpha, A[b], lda, B[b], ldb, beta, C[b], ldc);
+}
+
+}  // namespace batched
+
+#endif
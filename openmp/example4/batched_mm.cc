@@ -0,0 +1,188 @@
+/*
+** Throughput of many small matrix multiplies, C = A B, for:
+**
+**   fixed    - the kernels of batched_gemm.hpp, specialised on the size,
+**              with the batch in one strided array
+**   pointers - the same kernels, with the batch given as arrays of pointers
+**   loop     - the naive loop of serial_naive_mm.c, with run-time sizes
+**   blas     - a call to dgemm_ for each matrix (OpenBLAS, or MM_BLAS)
+**
+** Each size gets a batch of about 32MB per matrix.  The batch is shared out
+** between the OpenMP threads in every case, and the BLAS is asked for one
+** thread per call.  C is filled with NaNs before each variant, and every
+** variant is checked against the same reference, summed in long double, so
+** a variant that skips part of C, or shares a bug with the naive loop,
+** shows up in the max error.
+**
+** Usage: batched_mm.exe [size ...]
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <omp.h>
+
+#include "batched_gemm.hpp"
+#include "blas_loader.h"
+#include "philox.h"
+
+#define BATCH_BYTES (32L << 20)    /* size of each batched matrix array */
+#define REPEATS 5                  /* timed runs; we keep the fastest */
+
+static const int default_sizes[] = { 4, 8, 16, 32 };
+
+/* the naive loop of serial_naive_mm.c */
+void naive_mm(int n, const double* A, const double* B, double* C)
+{
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < n; i++)
+      C[i + j * n] = 0.0;
+    for (int k = 0; k < n; k++)
+      for (int i = 0; i < n; i++)
+        C[i + j * n] += A[i + k * n] * B[k + j * n];
+  }
+}
+
+/* the reference: each element of C as a dot product, summed in long double */
+void reference_mm(int n, const double* A, const double* B, double* C)
+{
+  for (int j = 0; j < n; j++)
+    for (int i = 0; i < n; i++) {
+      long double sum = 0.0L;
+      for (int k = 0; k < n; k++)
+        sum += (long double)A[i + k * n] * B[k + j * n];
+      C[i + j * n] = (double)sum;
+    }
+}
+
+/* the fastest of REPEATS runs, after a warm-up */
+template <typename F>
+double best_time(F f)
+{
+  double best = 0.0;
+  f();
+  for (int r = 0; r < REPEATS; r++) {
+    double tic = omp_get_wtime();
+    f();
+    double elapsed = omp_get_wtime() - tic;
+    if (r == 0 || elapsed < best) best = elapsed;
+  }
+  return best;
+}
+
+int main(int argc, char* argv[])
+{
+  int nsizes = (argc > 1) ? argc - 1 : (int)(sizeof(default_sizes) / sizeof(default_sizes[0]));
+  const char* name = getenv("MM_BLAS");
+  blas_backend_t blas;
+  bool have_blas;
+
+  have_blas = (blas_load(name != NULL ? name : "openblas", &blas) == 0);
+  if (have_blas)
+    blas_set_threads(&blas, 1);
+
+  printf("%d threads, %ldMB per matrix array, fastest of %d runs (GFLOP/s)\n\n",
+         omp_get_max_threads(), BATCH_BYTES >> 20, REPEATS);
+  printf("%6s %10s %10s %10s %10s %10s %12s\n",
+         "size", "batch", "fixed", "pointers", "loop", "blas", "max error");
+
+  for (int s = 0; s < nsizes; s++) {
+    int n = (argc > 1) ? atoi(argv[s + 1]) : default_sizes[s];
+    if (n < 1) {
+      fprintf(stderr, "Error: sizes must be positive\n");
+      exit(EXIT_FAILURE);
+    }
+    long nn = (long)n * n;
+    long batch = BATCH_BYTES / (sizeof(double) * nn);
+    if (batch < 1) batch = 1;
+
+    double* A = new double[batch * nn];
+    double* B = new double[batch * nn];
+    double* C = new double[batch * nn];
+    double* Cref = new double[batch * nn];
+    const double** Ap = new const double*[batch];
+    const double** Bp = new const double*[batch];
+    double** Cp = new double*[batch];
+
+    /* one Philox stream for each matrix array, filled in by all the threads */
+    philox_fill_uniform(A, batch * nn, 86456, 0);
+    philox_fill_uniform(B, batch * nn, 86456, 1);
+    for (long b = 0; b < batch; b++) {
+      Ap[b] = A + b * nn;
+      Bp[b] = B + b * nn;
+      Cp[b] = C + b * nn;
+    }
+    for (long b = 0; b < batch; b++)
+      reference_mm(n, A + b * nn, B + b * nn, Cref + b * nn);
+
+    /* NaNs, so that any element a variant fails to write is an error */
+    auto reset = [&] {
+#pragma omp parallel for schedule(static)
+      for (long i = 0; i < batch * nn; i++)
+        C[i] = std::numeric_limits<double>::quiet_NaN();
+    };
+
+    /* fmax() ignores NaNs, so count them as an infinite error */
+    double maxerr = 0.0;
+    auto check = [&] {
+      for (long i = 0; i < batch * nn; i++) {
+        double err = std::fabs(C[i] - Cref[i]) / std::fabs(Cref[i]);
+        maxerr = std::fmax(maxerr, std::isnan(err) ? INFINITY : err);
+      }
+    };
+
+    reset();
+    double t_fixed = best_time([&] {
+      batched::gemm_batch_strided(n, n, n, batch, 1.0, A, n, nn, B, n, nn, 0.0, C, n, nn);
+    });
+    check();
+
+    reset();
+    double t_pointers = best_time([&] {
+      batched::gemm_batch_pointers(n, n, n, batch, 1.0, Ap, n, Bp, n, 0.0, Cp, n);
+    });
+    check();
+
+    reset();
+    double t_loop = best_time([&] {
+#pragma omp parallel for schedule(static)
+      for (long b = 0; b < batch; b++)
+        naive_mm(n, A + b * nn, B + b * nn, C + b * nn);
+    });
+    check();
+
+    double t_blas = 0.0;
+    if (have_blas) {
+      reset();
+      t_blas = best_time([&] {
+        char trans = 'N';
+        double one = 1.0, zero = 0.0;
+#pragma omp parallel for schedule(static)
+        for (long b = 0; b < batch; b++)
+          blas.dgemm(&trans, &trans, &n, &n, &n, &one, A + b * nn, &n, B + b * nn, &n,
+                     &zero, C + b * nn, &n);
+      });
+      check();
+    }
+
+    double flops = 2.0 * n * n * (double)n * batch;
+    printf("%6d %10ld %10.2f %10.2f %10.2f ", n, batch, flops / t_fixed / 1.0e9,
+           flops / t_pointers / 1.0e9, flops / t_loop / 1.0e9);
+    if (have_blas)
+      printf("%10.2f ", flops / t_blas / 1.0e9);
+    else
+      printf("%10s ", "-");
+    printf("%12.2e\n", maxerr);
+
+    delete[] A;
+    delete[] B;
+    delete[] C;
+    delete[] Cref;
+    delete[] Ap;
+    delete[] Bp;
+    delete[] Cp;
+  }
+
+  return EXIT_SUCCESS;
+}
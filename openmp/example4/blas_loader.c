@@ -0,0 +1,90 @@
+/*
+** Load a BLAS library at run-time.  See blas_loader.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dlfcn.h>
+
+#include "blas_loader.h"
+
+#define MAXNAMES 3
+
+/* the sonames tried for each of the well-known backends, in order */
+static const struct {
+  const char* alias;
+  const char* sonames[MAXNAMES];
+} known[] = {
+  { "openblas",  { "libopenblas.so.0", "libopenblas.so", NULL } },
+  { "blis",      { "libblis.so.4", "libblis.so.3", "libblis.so" } },
+  { "mkl",       { "libmkl_rt.so.2", "libmkl_rt.so", NULL } },
+  { "reference", { "libblas.so.3", "libblas.so", NULL } },
+};
+#define NKNOWN (int)(sizeof(known)/sizeof(known[0]))
+
+/* how each backend lets us choose its number of threads */
+static const struct {
+  const char* symbol;
+  int is64;
+} setters[] = {
+  { "openblas_set_num_threads", 0 },
+  { "bli_thread_set_num_threads", 1 },
+  { "MKL_Set_Num_Threads", 0 },
+};
+#define NSETTERS (int)(sizeof(setters)/sizeof(setters[0]))
+
+int blas_load(const char* name, blas_backend_t* backend)
+{
+  const char* try[MAXNAMES] = { name, NULL, NULL };
+  int i, s;
+
+  memset(backend, 0, sizeof(*backend));
+  strncpy(backend->name, name, sizeof(backend->name) - 1);
+
+  for (i = 0; i < NKNOWN; i++)
+    if (!strcmp(name, known[i].alias))
+      memcpy(try, known[i].sonames, sizeof(try));
+
+  /*
+  ** RTLD_LOCAL keeps the dgemm_ of one library from being bound to
+  ** another.  Libraries are never closed: OpenBLAS, for one, does not
+  ** like being unloaded with its worker threads alive.
+  */
+  for (i = 0; i < MAXNAMES && try[i] != NULL && backend->handle == NULL; i++) {
+    backend->handle = dlopen(try[i], RTLD_NOW | RTLD_LOCAL);
+    if (backend->handle != NULL)
+      strncpy(backend->path, try[i], sizeof(backend->path) - 1);
+  }
+  if (backend->handle == NULL) {
+    fprintf(stderr, "Error: could not load BLAS backend %s: %s\n", name, dlerror());
+    return -1;
+  }
+
+  backend->dgemm = (dgemm_fn)dlsym(backend->handle, "dgemm_");
+  if (backend->dgemm == NULL) {
+    fprintf(stderr, "Error: %s does not export dgemm_\n", backend->path);
+    return -1;
+  }
+
+  for (s = 0; s < NSETTERS && backend->set_threads == NULL; s++) {
+    backend->set_threads = dlsym(backend->handle, setters[s].symbol);
+    backend->set_threads_64 = setters[s].is64;
+  }
+
+  return 0;
+}
+
+int blas_set_threads(const blas_backend_t* backend, int nthreads)
+{
+  if (backend->set_threads == NULL)
+    return 0;
+
+  if (backend->set_threads_64)
+    ((void (*)(int64_t))backend->set_threads)((int64_t)nthreads);
+  else
+    ((void (*)(int))backend->set_threads)(nthreads);
+
+  return 1;
+}
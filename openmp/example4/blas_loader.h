@@ -0,0 +1,43 @@
+/*
+** Load a BLAS library at run-time, so that one executable can compare
+** OpenBLAS, BLIS, MKL and the reference BLAS without being relinked.
+*/
+
+#ifndef BLAS_LOADER_H
+#define BLAS_LOADER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the Fortran interface to dgemm, as exported by every BLAS */
+typedef void (*dgemm_fn)(const char* transa, const char* transb,
+                         const int* m, const int* n, const int* k,
+                         const double* alpha, const double* A, const int* lda,
+                         const double* B, const int* ldb,
+                         const double* beta, double* C, const int* ldc);
+
+typedef struct {
+  char name[256];       /* as given to blas_load() */
+  char path[256];       /* the library that was opened */
+  void* handle;
+  dgemm_fn dgemm;
+  void* set_threads;    /* the library's own thread count setter, or NULL */
+  int set_threads_64;   /* does the setter take a 64-bit int (BLIS)? */
+} blas_backend_t;
+
+/*
+** Open a backend: one of openblas, blis, mkl or reference, or else the
+** file name of any library that exports dgemm_.  Returns 0 on success;
+** otherwise prints why and returns -1.
+*/
+int blas_load(const char* name, blas_backend_t* backend);
+
+/* ask the backend for nthreads threads; returns 0 if it has no way to */
+int blas_set_threads(const blas_backend_t* backend, int nthreads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
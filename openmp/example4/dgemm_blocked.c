@@ -0,0 +1,393 @@
+/*
+** A cache-blocked, register-tiled GEMM.  See dgemm_blocked.h.
+**
+** The code itself is in gemm_blocked_template.h, which is included once for
+** each precision, and for DGEMM once for each register block.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "dgemm_blocked.h"
+
+#define ALIGNMENT 64
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+#define TUNE_FILE ".dgemm_tune"    /* in $HOME, unless DGEMM_TUNE_FILE is set */
+#define MAX_LINE 512
+#define MAX_MODELS 256
+
+void* gemm_alloc(long bytes)
+{
+  void* p;
+
+  /* aligned_alloc() wants a whole number of alignments */
+  bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  p = aligned_alloc(ALIGNMENT, bytes > 0 ? bytes : ALIGNMENT);
+  if (p == NULL) {
+    fprintf(stderr, "Error: could not allocate %ld bytes\n", bytes);
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+double* dgemm_alloc(long n)
+{
+  return (double*)gemm_alloc(sizeof(double)*n);
+}
+
+float* sgemm_alloc(long n)
+{
+  return (float*)gemm_alloc(sizeof(float)*n);
+}
+
+/*
+** double, with a choice of register blocks for the autotuner: they trade
+** the number of vector registers used for C against the loads of A and B
+** per FMA, and which is best depends on the vector length and the number
+** of registers.
+*/
+#define GEMM_IN double
+#define GEMM_ACC double
+#define GEMM_OUT double
+
+#define GEMM_PREFIX dgemm_default
+#define GEMM_MR MR
+#define GEMM_NR NR
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_MR
+#undef GEMM_NR
+
+#define GEMM_PREFIX dgemm_8x4
+#define GEMM_MR 8
+#define GEMM_NR 4
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_MR
+#undef GEMM_NR
+
+#define GEMM_PREFIX dgemm_8x8
+#define GEMM_MR 8
+#define GEMM_NR 8
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_MR
+#undef GEMM_NR
+
+#define GEMM_PREFIX dgemm_4x12
+#define GEMM_MR 4
+#define GEMM_NR 12
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_MR
+#undef GEMM_NR
+
+#define GEMM_PREFIX dgemm_16x4
+#define GEMM_MR 16
+#define GEMM_NR 4
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_MR
+#undef GEMM_NR
+
+#define GEMM_PREFIX dgemm_16x6
+#define GEMM_MR 16
+#define GEMM_NR 6
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_MR
+#undef GEMM_NR
+
+#undef GEMM_IN
+#undef GEMM_ACC
+#undef GEMM_OUT
+
+typedef void (*dgemm_kernel_fn)(const dgemm_params_t*, int, int, int, double,
+                                const double*, int, const double*, int, double, double*, int);
+typedef void (*dgemm_ws_fn)(const dgemm_params_t*, int, int, int, double, const double*, int,
+                            const double*, int, double, double*, int, double*, long);
+typedef long (*dgemm_ws_size_fn)(const dgemm_params_t*, int, int, int, int);
+
+#define KERNEL(name, prefix) \
+  { name, prefix##_blocked_params, prefix##_blocked_ws, prefix##_blocked_ws_size }
+
+static const struct {
+  const char* name;
+  dgemm_kernel_fn fn;
+  dgemm_ws_fn ws;
+  dgemm_ws_size_fn ws_size;
+} kernels[] = {
+  KERNEL(STR(MR) "x" STR(NR), dgemm_default),
+  KERNEL("8x4", dgemm_8x4),
+  KERNEL("8x8", dgemm_8x8),
+  KERNEL("4x12", dgemm_4x12),
+  KERNEL("16x4", dgemm_16x4),
+  KERNEL("16x6", dgemm_16x6),
+};
+#define NKERNELS ((int)(sizeof(kernels)/sizeof(kernels[0])))
+
+static const char* orders[DGEMM_NORDERS] = {
+  "jc-pc-ic-jr-ir", "pc-jc-ic-jr-ir", "jc-pc-ic-ir-jr", "pc-jc-ic-ir-jr"
+};
+
+/* float: twice as many elements in each vector */
+#define GEMM_PREFIX sgemm
+#define GEMM_IN float
+#define GEMM_ACC float
+#define GEMM_OUT float
+#define GEMM_MR SGEMM_MR
+#define GEMM_NR NR
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_IN
+#undef GEMM_ACC
+#undef GEMM_OUT
+#undef GEMM_MR
+#undef GEMM_NR
+
+/* float panels, for half the memory traffic, with double sums */
+#define GEMM_PREFIX dsgemm
+#define GEMM_IN float
+#define GEMM_ACC double
+#define GEMM_OUT double
+#define GEMM_MR MR
+#define GEMM_NR NR
+#include "gemm_blocked_template.h"
+#undef GEMM_PREFIX
+#undef GEMM_IN
+#undef GEMM_ACC
+#undef GEMM_OUT
+#undef GEMM_MR
+#undef GEMM_NR
+
+/* the register block of params, which must be one we have */
+static int params_kernel(const dgemm_params_t* params)
+{
+  int kernel = (params != NULL) ? params->kernel : 0;
+
+  if (kernel < 0 || kernel >= NKERNELS) {
+    fprintf(stderr, "Error: there is no DGEMM kernel %d\n", kernel);
+    exit(EXIT_FAILURE);
+  }
+  return kernel;
+}
+
+void dgemm_blocked_params(const dgemm_params_t* params, int m, int n, int k, double alpha,
+                          const double* A, int lda, const double* B, int ldb,
+                          double beta, double* C, int ldc)
+{
+  kernels[params_kernel(params)].fn(params, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void dgemm_blocked_ws(const dgemm_params_t* params, int m, int n, int k, double alpha,
+                      const double* A, int lda, const double* B, int ldb,
+                      double beta, double* C, int ldc, double* work, long lwork)
+{
+  kernels[params_kernel(params)].ws(params, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+                                    work, lwork);
+}
+
+long dgemm_blocked_ws_size(const dgemm_params_t* params, int m, int n, int k, int nthreads)
+{
+  return kernels[params_kernel(params)].ws_size(params, m, n, k, nthreads);
+}
+
+void dgemm_blocked(int m, int n, int k, double alpha,
+                   const double* A, int lda, const double* B, int ldb,
+                   double beta, double* C, int ldc)
+{
+  dgemm_params_t params;
+
+  dgemm_default_params(&params);
+  dgemm_blocked_params(&params, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void sgemm_blocked(int m, int n, int k, float alpha,
+                   const float* A, int lda, const float* B, int ldb,
+                   float beta, float* C, int ldc)
+{
+  sgemm_blocked_params(NULL, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void dsgemm_blocked(int m, int n, int k, double alpha,
+                    const float* A, int lda, const float* B, int ldb,
+                    double beta, double* C, int ldc)
+{
+  dsgemm_blocked_params(NULL, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+int dgemm_nkernels(void)
+{
+  return NKERNELS;
+}
+
+const char* dgemm_kernel_name(int kernel)
+{
+  return (kernel >= 0 && kernel < NKERNELS) ? kernels[kernel].name : "?";
+}
+
+int dgemm_find_kernel(const char* name)
+{
+  int kernel;
+
+  for (kernel = 0; kernel < NKERNELS; kernel++)
+    if (!strcmp(name, kernels[kernel].name))
+      return kernel;
+  return -1;
+}
+
+const char* dgemm_order_name(int order)
+{
+  return (order >= 0 && order < DGEMM_NORDERS) ? orders[order] : "?";
+}
+
+void dgemm_builtin_params(dgemm_params_t* params)
+{
+  params->mc = DEFAULT_MC;
+  params->kc = DEFAULT_KC;
+  params->nc = DEFAULT_NC;
+  params->kernel = 0;
+  params->order = 0;
+  params->nthreads = 0;
+}
+
+/*
+** The cache is read once, on the first call; the critical section is for
+** callers, like omp_strassen_mm.c, that multiply from inside OpenMP tasks.
+** The saved thread count is dropped: it was the best for the tuning run's
+** OMP_NUM_THREADS and matrix size, and a later run with more threads, or
+** a bigger matrix, would be silently held back by it.
+*/
+void dgemm_default_params(dgemm_params_t* params)
+{
+  static dgemm_params_t tuned;
+  static int loaded = 0;
+
+#pragma omp critical(dgemm_default_params)
+  {
+    if (!loaded) {
+      char model[MAX_LINE];
+      dgemm_cpu_model(model, sizeof(model));
+      if (dgemm_load_params(model, &tuned) != 0)
+        dgemm_builtin_params(&tuned);
+      tuned.nthreads = 0;
+      loaded = 1;
+    }
+    *params = tuned;
+  }
+}
+
+/* the "model name" from /proc/cpuinfo, or "unknown" on CPUs that don't give one */
+void dgemm_cpu_model(char* model, int len)
+{
+  char line[MAX_LINE];
+  FILE* fp;
+
+  snprintf(model, len, "unknown");
+  fp = fopen("/proc/cpuinfo", "r");
+  if (fp == NULL)
+    return;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char* colon = strchr(line, ':');
+    if (!strncmp(line, "model name", 10) && colon != NULL) {
+      colon += strspn(colon + 1, " \t") + 1;
+      colon[strcspn(colon, "\n")] = '\0';
+      snprintf(model, len, "%s", colon);
+      break;
+    }
+  }
+  fclose(fp);
+}
+
+const char* dgemm_tune_file(void)
+{
+  static char path[MAX_LINE];
+  const char* file = getenv("DGEMM_TUNE_FILE");
+  const char* home = getenv("HOME");
+
+  if (file != NULL)
+    return file;
+  snprintf(path, sizeof(path), "%s/%s", home != NULL ? home : ".", TUNE_FILE);
+  return path;
+}
+
+/* split "<model>\t<values>" at the tab; returns the values, or NULL */
+static char* split_line(char* line)
+{
+  char* tab = strchr(line, '\t');
+
+  if (tab == NULL)
+    return NULL;
+  *tab = '\0';
+  return tab + 1;
+}
+
+int dgemm_load_params(const char* model, dgemm_params_t* params)
+{
+  char line[MAX_LINE], kernel[MAX_LINE];
+  dgemm_params_t p;
+  int found = -1;
+  FILE* fp;
+
+  fp = fopen(dgemm_tune_file(), "r");
+  if (fp == NULL)
+    return -1;
+  while (found != 0 && fgets(line, sizeof(line), fp) != NULL) {
+    char* values = split_line(line);
+    if (values == NULL || strcmp(line, model))
+      continue;
+    /* the kernel is saved by name, since the table may change between builds */
+    if (sscanf(values, "%d %d %d %s %d %d", &p.mc, &p.kc, &p.nc, kernel,
+               &p.order, &p.nthreads) == 6 &&
+        (p.kernel = dgemm_find_kernel(kernel)) >= 0 &&
+        p.mc > 0 && p.kc > 0 && p.nc > 0 && p.order >= 0 && p.order < DGEMM_NORDERS &&
+        p.nthreads >= 0) {
+      *params = p;
+      found = 0;
+    }
+  }
+  fclose(fp);
+  return found;
+}
+
+int dgemm_save_params(const char* model, const dgemm_params_t* params)
+{
+  const char* file = dgemm_tune_file();
+  static char lines[MAX_MODELS][MAX_LINE];
+  int nlines = 0, i;
+  FILE* fp;
+
+  /* keep the lines for every other model */
+  fp = fopen(file, "r");
+  if (fp != NULL) {
+    while (nlines < MAX_MODELS && fgets(lines[nlines], MAX_LINE, fp) != NULL) {
+      char copy[MAX_LINE];
+      strcpy(copy, lines[nlines]);
+      if (split_line(copy) != NULL && strcmp(copy, model))
+        nlines++;
+    }
+    fclose(fp);
+  }
+
+  fp = fopen(file, "w");
+  if (fp == NULL) {
+    perror(file);
+    return -1;
+  }
+  for (i = 0; i < nlines; i++)
+    fputs(lines[i], fp);
+  fprintf(fp, "%s\t%d %d %d %s %d %d\n", model, params->mc, params->kc, params->nc,
+          dgemm_kernel_name(params->kernel), params->order, params->nthreads);
+  if (fclose(fp) != 0) {
+    perror(file);
+    return -1;
+  }
+  return 0;
+}
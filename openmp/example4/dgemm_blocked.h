@@ -0,0 +1,140 @@
+/*
+** A cache-blocked, register-tiled DGEMM, in the style of GotoBLAS and BLIS.
+**
+** C = alpha*A*B + beta*C for column-major A (m x k), B (k x n) and C (m x n),
+** with the same argument order as the BLAS (without the transpose flags).
+**
+** The loops are blocked three times, one level for each cache:
+**
+**   - a kc x nc panel of B is packed once and stays in L3,
+**   - an mc x kc block of A is packed by each thread and stays in L2,
+**   - a kc x NR sliver of the packed B stays in L1 while the micro-kernel
+**     streams MR x kc slivers of A past it,
+**
+** and the micro-kernel holds an MR x NR block of C in registers for the
+** whole of the kc loop.  Threads share the packed B and take mc x nc
+** macro-tiles of C in turn.
+**
+** The best tile sizes, register block, loop order and number of threads
+** depend on the CPU.  omp_autotune_mm.c searches for them and saves them
+** in a cache file, keyed by the CPU model; dgemm_blocked() then uses the
+** saved values whenever it runs on that kind of CPU.
+**
+** The same code also gives sgemm_blocked(), in single precision, and
+** dsgemm_blocked(), which takes float A and B but sums in double.
+*/
+
+#ifndef DGEMM_BLOCKED_H
+#define DGEMM_BLOCKED_H
+
+/* the register block: MR is a multiple of the vector length */
+#ifndef MR
+#define MR 8
+#endif
+#ifndef NR
+#define NR 6
+#endif
+/* a float vector holds twice as many elements */
+#define SGEMM_MR (2*MR)
+
+/* default tile sizes, in elements */
+#define DEFAULT_MC 96
+#define DEFAULT_KC 256
+#define DEFAULT_NC 4096
+
+/*
+** The loop order, as a pair of flags.  The ic loop over blocks of A is
+** always the one shared between the threads; the flags choose whether the
+** panels of B are taken column by column (jc, then pc) or depth first
+** (pc, then jc), and which of the two loops around the micro-kernel is the
+** outer one.
+*/
+#define DGEMM_ORDER_PC_OUTER 1
+#define DGEMM_ORDER_IR_OUTER 2
+#define DGEMM_NORDERS 4
+
+typedef struct {
+  int mc;          /* rows of the block of A held in L2 */
+  int kc;          /* depth of the panels of A and B */
+  int nc;          /* columns of the panel of B held in L3 */
+  int kernel;      /* register block, see dgemm_kernel_name() (DGEMM only) */
+  int order;       /* loop order, DGEMM_ORDER_* flags */
+  int nthreads;    /* at most this many threads; 0 for all of them */
+} dgemm_params_t;
+
+/* the blocked multiply, with the tuned parameters for this CPU */
+void dgemm_blocked(int m, int n, int k, double alpha,
+                   const double* A, int lda, const double* B, int ldb,
+                   double beta, double* C, int ldc);
+
+/* as above, with the parameters given (NULL for the built-in defaults) */
+void dgemm_blocked_params(const dgemm_params_t* params, int m, int n, int k, double alpha,
+                          const double* A, int lda, const double* B, int ldb,
+                          double beta, double* C, int ldc);
+
+/*
+** as above, but packing into work, which holds lwork doubles, rather than
+** into buffers of its own, for callers like omp_strassen_mm.c that make
+** many multiplies and want no malloc() on the way.  A workspace of
+** dgemm_blocked_ws_size() doubles is enough for nthreads threads; a smaller
+** one gets fewer threads, down to one.
+*/
+void dgemm_blocked_ws(const dgemm_params_t* params, int m, int n, int k, double alpha,
+                      const double* A, int lda, const double* B, int ldb,
+                      double beta, double* C, int ldc, double* work, long lwork);
+long dgemm_blocked_ws_size(const dgemm_params_t* params, int m, int n, int k, int nthreads);
+
+/* single precision (with the built-in MR x NR register block) */
+void sgemm_blocked(int m, int n, int k, float alpha,
+                   const float* A, int lda, const float* B, int ldb,
+                   float beta, float* C, int ldc);
+void sgemm_blocked_params(const dgemm_params_t* params, int m, int n, int k, float alpha,
+                          const float* A, int lda, const float* B, int ldb,
+                          float beta, float* C, int ldc);
+
+/* mixed precision: float inputs, double sums and C */
+void dsgemm_blocked(int m, int n, int k, double alpha,
+                    const float* A, int lda, const float* B, int ldb,
+                    double beta, double* C, int ldc);
+void dsgemm_blocked_params(const dgemm_params_t* params, int m, int n, int k, double alpha,
+                           const float* A, int lda, const float* B, int ldb,
+                           double beta, double* C, int ldc);
+
+/* the DGEMM register blocks; kernel 0 is the built-in MR x NR */
+int dgemm_nkernels(void);
+const char* dgemm_kernel_name(int kernel);    /* e.g. "8x6" */
+int dgemm_find_kernel(const char* name);      /* -1 if there is none */
+const char* dgemm_order_name(int order);      /* e.g. "jc-pc-ic-jr-ir" */
+
+/* the built-in defaults */
+void dgemm_builtin_params(dgemm_params_t* params);
+/*
+** the saved parameters for this CPU if there are any, else the built-in
+** ones; either way with nthreads 0, so every thread OpenMP gives us is used
+*/
+void dgemm_default_params(dgemm_params_t* params);
+
+/*
+** The tuning cache.  It is the file named by DGEMM_TUNE_FILE, or else
+** ~/.dgemm_tune, with one line for each CPU model:
+**
+**   <model name>\t<mc> <kc> <nc> <kernel> <order> <nthreads>
+**
+** The thread count is the fastest the tuner found, for the record; only
+** dgemm_load_params() returns it, and dgemm_default_params() ignores it.
+**
+** dgemm_load_params() returns 0 if it found the model (and -1 if not);
+** dgemm_save_params() adds or replaces the model's line and returns 0, or
+** prints why it could not and returns -1.
+*/
+void dgemm_cpu_model(char* model, int len);
+const char* dgemm_tune_file(void);
+int dgemm_load_params(const char* model, dgemm_params_t* params);
+int dgemm_save_params(const char* model, const dgemm_params_t* params);
+
+/* 64-byte aligned storage, released with free() */
+void* gemm_alloc(long bytes);
+double* dgemm_alloc(long n);
+float* sgemm_alloc(long n);
+
+#endif
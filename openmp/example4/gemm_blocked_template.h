@@ -0,0 +1,263 @@
+/*
+** The body of the blocked GEMM, written once for every precision.
+**
+** dgemm_blocked.c includes this file several times, each time defining:
+**
+**   GEMM_PREFIX  the prefix of the generated names, e.g. dgemm
+**   GEMM_IN      the type of A, B and the packed panels
+**   GEMM_ACC     the type of the register accumulator
+**   GEMM_OUT     the type of C, alpha and beta
+**   GEMM_MR      the rows of the register block (a multiple of the
+**                vector length of GEMM_ACC)
+**   GEMM_NR      the columns of the register block
+**
+** and gets GEMM_PREFIX_blocked_params(), GEMM_PREFIX_blocked_ws() and
+** GEMM_PREFIX_blocked_ws_size() with the interfaces described in
+** dgemm_blocked.h (the kernel field of the parameters is ignored: the
+** register block is fixed by GEMM_MR and GEMM_NR).
+*/
+
+#define GEMM_CAT_(a, b) a##b
+#define GEMM_CAT(a, b) GEMM_CAT_(a, b)
+#define GEMM_FN(name) GEMM_CAT(GEMM_PREFIX, name)
+
+/*
+** Pack an mb x kb block of A into slivers of MR rows.  Each sliver is
+** stored column by column, so the micro-kernel reads it contiguously;
+** the last sliver is padded with zeros.
+*/
+static void GEMM_FN(_pack_A)(int mb, int kb, const GEMM_IN* A, int lda, GEMM_IN* Ap)
+{
+  int i, ir, p;
+
+  for (ir = 0; ir < mb; ir += GEMM_MR) {
+    int mr = MIN(GEMM_MR, mb - ir);
+    for (p = 0; p < kb; p++) {
+      for (i = 0; i < mr; i++)
+        Ap[i] = A[(ir + i) + (long)p*lda];
+      for (; i < GEMM_MR; i++)
+        Ap[i] = 0;
+      Ap += GEMM_MR;
+    }
+  }
+}
+
+/*
+** Pack a kb x nb panel of B into slivers of NR columns, each stored row by
+** row and padded with zeros.  The slivers are shared out between the
+** threads of the enclosing parallel region.
+*/
+static void GEMM_FN(_pack_B)(int kb, int nb, const GEMM_IN* B, int ldb, GEMM_IN* Bp)
+{
+  int j, jr, p;
+
+#pragma omp for schedule(static)
+  for (jr = 0; jr < nb; jr += GEMM_NR) {
+    int nr = MIN(GEMM_NR, nb - jr);
+    GEMM_IN* b = Bp + (long)jr*kb;
+    for (p = 0; p < kb; p++) {
+      for (j = 0; j < nr; j++)
+        b[j] = B[p + (long)(jr + j)*ldb];
+      for (; j < GEMM_NR; j++)
+        b[j] = 0;
+      b += GEMM_NR;
+    }
+  }
+}
+
+/*
+** C(mr x nr) = alpha * a*b + beta * C, where a is an MR x kb sliver of A and
+** b a kb x NR sliver of B.  The MR x NR accumulator is small enough to live
+** in vector registers and the inner loop is one vector FMA per column of it.
+*/
+static void GEMM_FN(_micro_kernel)(int kb, const GEMM_IN* restrict a, const GEMM_IN* restrict b,
+                                   GEMM_OUT alpha, GEMM_OUT beta, GEMM_OUT* restrict C, int ldc,
+                                   int mr, int nr)
+{
+  GEMM_ACC ab[GEMM_NR][GEMM_MR];
+  int i, j, p;
+
+  for (j = 0; j < GEMM_NR; j++)
+    for (i = 0; i < GEMM_MR; i++)
+      ab[j][i] = 0;
+
+  for (p = 0; p < kb; p++) {
+    for (j = 0; j < GEMM_NR; j++) {
+#pragma omp simd
+      for (i = 0; i < GEMM_MR; i++)
+        ab[j][i] += (GEMM_ACC)a[i]*(GEMM_ACC)b[j];
+    }
+    a += GEMM_MR;
+    b += GEMM_NR;
+  }
+
+  /* beta = 0 must not read C, which may hold anything */
+  if (beta == 0) {
+    for (j = 0; j < nr; j++)
+      for (i = 0; i < mr; i++)
+        C[i + (long)j*ldc] = alpha*ab[j][i];
+  }
+  else {
+    for (j = 0; j < nr; j++)
+      for (i = 0; i < mr; i++)
+        C[i + (long)j*ldc] = alpha*ab[j][i] + beta*C[i + (long)j*ldc];
+  }
+}
+
+/*
+** One mb x nb macro-tile of C, from a packed block of A and panel of B.
+** With jr outermost, a sliver of B stays in L1 while the slivers of A
+** stream past it from L2; with ir outermost, the other way around.
+*/
+static void GEMM_FN(_macro_kernel)(int mb, int nb, int kb, GEMM_OUT alpha, const GEMM_IN* Ap,
+                                   const GEMM_IN* Bp, GEMM_OUT beta, GEMM_OUT* C, int ldc,
+                                   int ir_outer)
+{
+  int ir, jr;
+
+  if (ir_outer) {
+    for (ir = 0; ir < mb; ir += GEMM_MR)
+      for (jr = 0; jr < nb; jr += GEMM_NR)
+        GEMM_FN(_micro_kernel)(kb, Ap + (long)ir*kb, Bp + (long)jr*kb, alpha, beta,
+                               C + ir + (long)jr*ldc, ldc,
+                               MIN(GEMM_MR, mb - ir), MIN(GEMM_NR, nb - jr));
+  }
+  else {
+    for (jr = 0; jr < nb; jr += GEMM_NR)
+      for (ir = 0; ir < mb; ir += GEMM_MR)
+        GEMM_FN(_micro_kernel)(kb, Ap + (long)ir*kb, Bp + (long)jr*kb, alpha, beta,
+                               C + ir + (long)jr*ldc, ldc,
+                               MIN(GEMM_MR, mb - ir), MIN(GEMM_NR, nb - jr));
+  }
+}
+
+/* n elements, rounded up to whole cache lines, so no two buffers share one */
+static long GEMM_FN(_lines)(long n)
+{
+  long line = ALIGNMENT / sizeof(GEMM_IN);
+
+  return (n + line - 1) / line * line;
+}
+
+/* the tile sizes, loop order and threads of a multiply, from params or the defaults */
+static void GEMM_FN(_tiles)(const dgemm_params_t* params, int m, int n, int k, int* mc, int* kc,
+                            int* nc, int* order, int* nthreads)
+{
+  *mc = DEFAULT_MC;
+  *kc = DEFAULT_KC;
+  *nc = DEFAULT_NC;
+  *order = 0;
+  *nthreads = omp_get_max_threads();
+
+  if (params != NULL) {
+    *mc = params->mc;
+    *kc = params->kc;
+    *nc = params->nc;
+    *order = params->order;
+    if (params->nthreads > 0 && params->nthreads < *nthreads)
+      *nthreads = params->nthreads;
+  }
+  /* round to whole register blocks */
+  *mc = (*mc + GEMM_MR - 1) / GEMM_MR * GEMM_MR;
+  *nc = (*nc + GEMM_NR - 1) / GEMM_NR * GEMM_NR;
+  *mc = MIN(*mc, (m + GEMM_MR - 1) / GEMM_MR * GEMM_MR);
+  *nc = MIN(*nc, (n + GEMM_NR - 1) / GEMM_NR * GEMM_NR);
+  *kc = MIN(*kc, k);
+}
+
+/* the panel of B, then a block of A for each thread */
+long GEMM_FN(_blocked_ws_size)(const dgemm_params_t* params, int m, int n, int k, int nthreads)
+{
+  int mc, kc, nc, order, maxthreads;
+
+  if (m <= 0 || n <= 0 || k <= 0)
+    return 0;
+  GEMM_FN(_tiles)(params, m, n, k, &mc, &kc, &nc, &order, &maxthreads);
+  return GEMM_FN(_lines)((long)kc*nc) + nthreads*GEMM_FN(_lines)((long)mc*kc);
+}
+
+void GEMM_FN(_blocked_ws)(const dgemm_params_t* params, int m, int n, int k, GEMM_OUT alpha,
+                          const GEMM_IN* A, int lda, const GEMM_IN* B, int ldb,
+                          GEMM_OUT beta, GEMM_OUT* C, int ldc, GEMM_IN* work, long lwork)
+{
+  int mc, kc, nc, order, nthreads;
+  int npc, njc;
+  long bsize, asize;
+  GEMM_IN *Bp, *own = NULL;
+  int i, j;
+
+  if (m <= 0 || n <= 0)
+    return;
+
+  /* nothing to multiply: just scale C */
+  if (k <= 0 || alpha == 0) {
+    for (j = 0; j < n; j++)
+      for (i = 0; i < m; i++)
+        C[i + (long)j*ldc] = (beta == 0) ? 0 : beta*C[i + (long)j*ldc];
+    return;
+  }
+
+  GEMM_FN(_tiles)(params, m, n, k, &mc, &kc, &nc, &order, &nthreads);
+  npc = (k + kc - 1) / kc;
+  njc = (n + nc - 1) / nc;
+  bsize = GEMM_FN(_lines)((long)kc*nc);
+  asize = GEMM_FN(_lines)((long)mc*kc);
+
+  /* no more threads than the workspace has blocks of A for */
+  if (work == NULL) {
+    own = work = (GEMM_IN*)gemm_alloc(sizeof(GEMM_IN)*(bsize + nthreads*asize));
+  }
+  else {
+    if (lwork < bsize + asize) {
+      fprintf(stderr, "Error: a GEMM workspace of %ld elements is too small, it needs %ld\n",
+              lwork, bsize + asize);
+      exit(EXIT_FAILURE);
+    }
+    nthreads = MIN(nthreads, (lwork - bsize) / asize);
+  }
+  Bp = work;
+
+#pragma omp parallel num_threads(nthreads)
+  {
+    GEMM_IN* Ap = work + bsize + omp_get_thread_num()*asize;
+    int ic, jc, pc, t;
+
+    /* the panels of B, taken in jc-pc (GotoBLAS) or pc-jc order */
+    for (t = 0; t < npc*njc; t++) {
+      int pc_outer = order & DGEMM_ORDER_PC_OUTER;
+      int nb, kb;
+      GEMM_OUT beta_p;
+
+      jc = (pc_outer ? t % njc : t / npc) * nc;
+      pc = (pc_outer ? t / njc : t % npc) * kc;
+      nb = MIN(nc, n - jc);
+      kb = MIN(kc, k - pc);
+      /* C is scaled by beta on the first pass only */
+      beta_p = (pc == 0) ? beta : 1;
+
+      GEMM_FN(_pack_B)(kb, nb, B + pc + (long)jc*ldb, ldb, Bp);
+
+      /* the barrier at the end keeps Bp in use until every tile is done */
+#pragma omp for schedule(dynamic)
+      for (ic = 0; ic < m; ic += mc) {
+        int mb = MIN(mc, m - ic);
+        GEMM_FN(_pack_A)(mb, kb, A + ic + (long)pc*lda, lda, Ap);
+        GEMM_FN(_macro_kernel)(mb, nb, kb, alpha, Ap, Bp, beta_p, C + ic + (long)jc*ldc, ldc,
+                               order & DGEMM_ORDER_IR_OUTER);
+      }
+    }
+  }
+
+  free(own);
+}
+
+void GEMM_FN(_blocked_params)(const dgemm_params_t* params, int m, int n, int k, GEMM_OUT alpha,
+                              const GEMM_IN* A, int lda, const GEMM_IN* B, int ldb,
+                              GEMM_OUT beta, GEMM_OUT* C, int ldc)
+{
+  GEMM_FN(_blocked_ws)(params, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, NULL, 0);
+}
+
+#undef GEMM_FN
+#undef GEMM_CAT
+#undef GEMM_CAT_
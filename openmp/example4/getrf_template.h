@@ -0,0 +1,187 @@
+/*
+** A blocked LU factorisation with partial pivoting, and the solve with its
+** factors, written once for every precision.
+**
+** omp_sgemm_mm.c includes this file twice, each time defining:
+**
+**   GETRF_PREFIX  the prefix of the generated names, s or d
+**   GETRF_T       the type of the matrices, float or double
+**   GETRF_GEMM    the blocked GEMM of that type, sgemm_blocked or dgemm_blocked
+**
+** and gets
+**
+**   GETRF_PREFIX getrf(n, nb, A, lda, piv)   P A = L U, in place, in steps
+**                                            of nb columns
+**   GETRF_PREFIX getrs(n, nrhs, LU, lda, piv, B, ldb)
+**                                            B = A^-1 B, from the factors
+**
+** As in omp_tiled_factor.c, row r was swapped with row piv[r] (>= r).  Each
+** step factors a panel of nb columns recursively, solves for that block row
+** of U, and updates the rest of the matrix with one GEMM, which is where
+** nearly all of the time goes.  In float, the GEMM works on vectors of
+** twice as many elements.
+*/
+
+#define GETRF_CAT_(a, b) a##b
+#define GETRF_CAT(a, b) GETRF_CAT_(a, b)
+#define GETRF_FN(name) GETRF_CAT(GETRF_PREFIX, name)
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef GETRF_LEAF
+#define GETRF_LEAF 16    /* panels this narrow are factored a column at a time */
+#endif
+#ifndef GETRS_NB
+#define GETRS_NB 128     /* rows per step of the triangular solves of getrs() */
+#endif
+
+/* swap rows k1..k2-1 of the n columns of A with rows piv[k1..k2-1] */
+static void GETRF_FN(laswp)(int n, GETRF_T* A, int lda, int k1, int k2, const int* piv)
+{
+  int j, r;
+  GETRF_T tmp;
+
+#pragma omp parallel for private(r, tmp) schedule(static) if(n > 64)
+  for (j = 0; j < n; j++)
+    for (r = k1; r < k2; r++)
+      if (piv[r] != r) {
+        tmp = A[r + (long)j*lda];
+        A[r + (long)j*lda] = A[piv[r] + (long)j*lda];
+        A[piv[r] + (long)j*lda] = tmp;
+      }
+}
+
+/* B = L^-1 B, for m x m unit lower triangular L and m x n B */
+static void GETRF_FN(trsm_lower_unit)(int m, int n, const GETRF_T* L, int ldl, GETRF_T* B,
+                                      int ldb)
+{
+  int i, j, k;
+
+#pragma omp parallel for private(i, k) schedule(static) if(n > 64)
+  for (j = 0; j < n; j++)
+    for (k = 0; k < m; k++)
+      for (i = k + 1; i < m; i++)
+        B[i + (long)j*ldb] -= L[i + (long)k*ldl]*B[k + (long)j*ldb];
+}
+
+/* B = U^-1 B, for m x m upper triangular U and m x n B */
+static void GETRF_FN(trsm_upper)(int m, int n, const GETRF_T* U, int ldu, GETRF_T* B, int ldb)
+{
+  int i, j, k;
+
+#pragma omp parallel for private(i, k) schedule(static)
+  for (j = 0; j < n; j++)
+    for (k = m - 1; k >= 0; k--) {
+      B[k + (long)j*ldb] /= U[k + (long)k*ldu];
+      for (i = 0; i < k; i++)
+        B[i + (long)j*ldb] -= U[i + (long)k*ldu]*B[k + (long)j*ldb];
+    }
+}
+
+/*
+** Factor the m x n panel A (m >= n) with partial pivoting, recursively, as
+** getrf_panel() in omp_tiled_factor.c.  The pivots are relative to the top
+** of the panel.
+*/
+static void GETRF_FN(getrf_panel)(int m, int n, GETRF_T* A, int lda, int* piv)
+{
+  int n1, n2, i, j, k, p;
+  GETRF_T amax, tmp;
+
+  if (n <= GETRF_LEAF) {
+    for (k = 0; k < n; k++) {
+      p = k;
+      amax = fabs(A[k + (long)k*lda]);
+      for (i = k + 1; i < m; i++)
+        if (fabs(A[i + (long)k*lda]) > amax) {
+          amax = fabs(A[i + (long)k*lda]);
+          p = i;
+        }
+      piv[k] = p;
+      if (p != k)
+        for (j = 0; j < n; j++) {
+          tmp = A[k + (long)j*lda];
+          A[k + (long)j*lda] = A[p + (long)j*lda];
+          A[p + (long)j*lda] = tmp;
+        }
+      /* a zero pivot leaves a zero column of L, as LAPACK does */
+      if (A[k + (long)k*lda] != 0)
+        for (i = k + 1; i < m; i++)
+          A[i + (long)k*lda] /= A[k + (long)k*lda];
+      for (j = k + 1; j < n; j++)
+        for (i = k + 1; i < m; i++)
+          A[i + (long)j*lda] -= A[i + (long)k*lda]*A[k + (long)j*lda];
+    }
+    return;
+  }
+
+  n1 = n/2;
+  n2 = n - n1;
+  GETRF_FN(getrf_panel)(m, n1, A, lda, piv);
+  GETRF_FN(laswp)(n2, A + (long)n1*lda, lda, 0, n1, piv);
+  GETRF_FN(trsm_lower_unit)(n1, n2, A, lda, A + (long)n1*lda, lda);
+  GETRF_GEMM(m - n1, n2, n1, -1, A + n1, lda, A + (long)n1*lda, lda, 1,
+             A + n1 + (long)n1*lda, lda);
+  GETRF_FN(getrf_panel)(m - n1, n2, A + n1 + (long)n1*lda, lda, piv + n1);
+  for (k = n1; k < n; k++)
+    piv[k] += n1;
+  GETRF_FN(laswp)(n1, A, lda, n1, n, piv);
+}
+
+static void GETRF_FN(getrf)(int n, int nb, GETRF_T* A, int lda, int* piv)
+{
+  int k, kb, rest, r;
+
+  for (k = 0; k < n; k += nb) {
+    kb = MIN(nb, n - k);
+    rest = n - k - kb;
+
+    GETRF_FN(getrf_panel)(n - k, kb, A + k + (long)k*lda, lda, piv + k);
+    for (r = k; r < k + kb; r++)
+      piv[r] += k;
+
+    /* the panel's row swaps, to its left and to its right */
+    GETRF_FN(laswp)(k, A, lda, k, k + kb, piv);
+    GETRF_FN(laswp)(rest, A + (long)(k + kb)*lda, lda, k, k + kb, piv);
+
+    /* U12 = L11^-1 A12, A22 = A22 - L21 U12 */
+    if (rest > 0) {
+      GETRF_FN(trsm_lower_unit)(kb, rest, A + k + (long)k*lda, lda, A + k + (long)(k + kb)*lda,
+                                lda);
+      GETRF_GEMM(rest, rest, kb, -1, A + (k + kb) + (long)k*lda, lda,
+                 A + k + (long)(k + kb)*lda, lda, 1, A + (k + kb) + (long)(k + kb)*lda, lda);
+    }
+  }
+}
+
+/*
+** The triangular solves a block of GETRS_NB rows at a time: the block of
+** the diagonal, then one GEMM for the rows still to do, so L and U are read
+** once rather than once for each right-hand side.
+*/
+static void GETRF_FN(getrs)(int n, int nrhs, const GETRF_T* LU, int lda, const int* piv,
+                            GETRF_T* B, int ldb)
+{
+  int k, kb;
+
+  GETRF_FN(laswp)(nrhs, B, ldb, 0, n, piv);
+
+  /* B = L^-1 B, top down */
+  for (k = 0; k < n; k += GETRS_NB) {
+    kb = MIN(GETRS_NB, n - k);
+    GETRF_FN(trsm_lower_unit)(kb, nrhs, LU + k + (long)k*lda, lda, B + k, ldb);
+    if (k + kb < n)
+      GETRF_GEMM(n - k - kb, nrhs, kb, -1, LU + (k + kb) + (long)k*lda, lda, B + k, ldb, 1,
+                 B + k + kb, ldb);
+  }
+
+  /* B = U^-1 B, bottom up */
+  for (k = ((n - 1)/GETRS_NB)*GETRS_NB; k >= 0; k -= GETRS_NB) {
+    kb = MIN(GETRS_NB, n - k);
+    GETRF_FN(trsm_upper)(kb, nrhs, LU + k + (long)k*lda, lda, B + k, ldb);
+    if (k > 0)
+      GETRF_GEMM(k, nrhs, kb, -1, LU + (long)k*lda, lda, B + k, ldb, 1, B, ldb);
+  }
+}
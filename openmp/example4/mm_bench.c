@@ -0,0 +1,221 @@
+/*
+** A benchmark driver for the matrix multiplies in this directory.
+**
+** Each variant computes C(M,N) = A(M,K) B(K,N) for the same column-major
+** matrices.  It is run once to warm up (page faults, thread start-up,
+** caches) and then timed with omp_get_wtime() over a number of repeats.
+** We report the fastest and the median time, as GFLOP/s, and the largest
+** error over a sample of entries checked against a dot product accumulated
+** in long double.
+**
+** Usage: mm_bench.exe [M N K [repeats [variants]]]
+**
+** where variants is a comma separated list taken from
+** naive,omp_naive,blocked,blas (the default is all of them).  The BLAS is
+** loaded at run-time: set MM_BLAS to openblas, blis, mkl, reference or the
+** file name of a library (the default is openblas).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "dgemm_blocked.h"
+#include "philox.h"
+#include "blas_loader.h"
+
+#define DIM 2000        /* default M, N and K, as in serial_naive_mm.c */
+#define REPEATS 5       /* default number of timed runs */
+#define NCHECK 1000     /* entries of C checked against a dot product */
+
+static blas_backend_t blas;
+
+typedef void (*mm_fn)(int m, int n, int k, const double* A, const double* B, double* C);
+
+/* the loop of serial_naive_mm.c */
+void naive_mm(int m, int n, int k, const double* A, const double* B, double* C)
+{
+  int i, j, p;
+
+  for (j = 0; j < n; j++) {
+    for (i = 0; i < m; i++)
+      C[i + (long)j*m] = 0.0;
+    for (p = 0; p < k; p++)
+      for (i = 0; i < m; i++)
+        C[i + (long)j*m] += A[i + (long)p*m]*B[p + (long)j*k];
+  }
+}
+
+/* the loop of omp_naive_mm.c */
+void omp_naive_mm(int m, int n, int k, const double* A, const double* B, double* C)
+{
+  int i, j, p;
+
+#pragma omp parallel for private(i,p)
+  for (j = 0; j < n; j++) {
+    for (i = 0; i < m; i++)
+      C[i + (long)j*m] = 0.0;
+    for (p = 0; p < k; p++)
+      for (i = 0; i < m; i++)
+        C[i + (long)j*m] += A[i + (long)p*m]*B[p + (long)j*k];
+  }
+}
+
+void blocked_mm(int m, int n, int k, const double* A, const double* B, double* C)
+{
+  dgemm_blocked(m, n, k, 1.0, A, m, B, k, 0.0, C, m);
+}
+
+void blas_mm(int m, int n, int k, const double* A, const double* B, double* C)
+{
+  char trans = 'N';
+  double alpha = 1.0, beta = 0.0;
+
+  blas.dgemm(&trans, &trans, &m, &n, &k, &alpha, A, &m, B, &k, &beta, C, &m);
+}
+
+struct variant {
+  const char* name;
+  mm_fn mm;
+};
+
+static const struct variant variants[] = {
+  { "naive",     naive_mm },
+  { "omp_naive", omp_naive_mm },
+  { "blocked",   blocked_mm },
+  { "blas",      blas_mm },
+};
+#define NVARIANTS (int)(sizeof(variants)/sizeof(variants[0]))
+
+int compare_doubles(const void* a, const void* b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* is name in the comma separated list? */
+int selected(const char* name, const char* list)
+{
+  size_t len = strlen(name);
+  const char* p = list;
+
+  while ((p = strstr(p, name)) != NULL) {
+    if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+      return 1;
+    p += len;
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  int m = DIM, n = DIM, k = DIM;
+  int repeats = REPEATS;
+  const char* list = "naive,omp_naive,blocked,blas";
+  int nthreads;
+  int v, r, s, p;
+
+  double *A;
+  double *B;
+  double *C;
+  double *times;
+  int *check_i, *check_j;
+  long double *check_c;
+
+  double tic, flops;
+
+  if (argc != 1 && argc != 4 && argc != 5 && argc != 6) {
+    fprintf(stderr, "Usage: %s [M N K [repeats [variants]]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (argc >= 4) {
+    m = atoi(argv[1]);
+    n = atoi(argv[2]);
+    k = atoi(argv[3]);
+  }
+  if (argc >= 5) repeats = atoi(argv[4]);
+  if (argc >= 6) list = argv[5];
+  if (m < 1 || n < 1 || k < 1 || repeats < 1) {
+    fprintf(stderr, "Error: sizes and repeats must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+
+  A = dgemm_alloc((long)m*k);
+  B = dgemm_alloc((long)k*n);
+  C = dgemm_alloc((long)m*n);
+  times = (double*)malloc(sizeof(double)*repeats);
+  check_i = (int*)malloc(sizeof(int)*NCHECK);
+  check_j = (int*)malloc(sizeof(int)*NCHECK);
+  check_c = (long double*)malloc(sizeof(long double)*NCHECK);
+
+  /* one Philox stream for each matrix, filled in by all the threads */
+  philox_fill_uniform(A, (long)m*k, 86456, 0);
+  philox_fill_uniform(B, (long)k*n, 86456, 1);
+
+  /* the reference values for a sample of entries */
+  srand(86456);
+  for (s = 0; s < NCHECK; s++) {
+    long double sum = 0.0L;
+    check_i[s] = rand() % m;
+    check_j[s] = rand() % n;
+    for (p = 0; p < k; p++)
+      sum += (long double)A[check_i[s] + (long)p*m]*B[p + (long)check_j[s]*k];
+    check_c[s] = sum;
+  }
+
+#pragma omp parallel
+  {
+#pragma omp master
+    nthreads = omp_get_num_threads();
+  }
+
+  flops = 2.0*m*n*k;
+  printf("C(%d,%d) = A(%d,%d) B(%d,%d), %d threads, 1 warm-up and %d timed runs\n\n",
+         m, n, m, k, k, n, nthreads, repeats);
+  printf("%-10s %12s %12s %12s %12s %12s\n",
+         "variant", "min (s)", "median (s)", "best GFLOP/s", "med GFLOP/s", "max error");
+
+  for (v = 0; v < NVARIANTS; v++) {
+    double err, maxerr = 0.0, median;
+
+    if (!selected(variants[v].name, list))
+      continue;
+    if (variants[v].mm == blas_mm) {
+      const char* name = getenv("MM_BLAS");
+      if (blas_load(name != NULL ? name : "openblas", &blas) != 0)
+        continue;
+    }
+
+    variants[v].mm(m, n, k, A, B, C);
+    for (r = 0; r < repeats; r++) {
+      tic = omp_get_wtime();
+      variants[v].mm(m, n, k, A, B, C);
+      times[r] = omp_get_wtime() - tic;
+    }
+    qsort(times, repeats, sizeof(double), compare_doubles);
+    median = (repeats % 2) ? times[repeats/2]
+                           : 0.5*(times[repeats/2 - 1] + times[repeats/2]);
+
+    for (s = 0; s < NCHECK; s++) {
+      err = (double)fabsl(C[check_i[s] + (long)check_j[s]*m] - check_c[s]);
+      if (check_c[s] != 0.0L)
+        err /= (double)fabsl(check_c[s]);
+      if (err > maxerr) maxerr = err;
+    }
+
+    printf("%-10s %12.6f %12.6f %12.2f %12.2f %12.2e\n", variants[v].name,
+           times[0], median, flops / times[0] / 1.0e9, flops / median / 1.0e9, maxerr);
+  }
+
+  free(A);
+  free(B);
+  free(C);
+  free(times);
+  free(check_i);
+  free(check_j);
+  free(check_c);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+/*
+** Tune the blocked DGEMM of dgemm_blocked.c for this machine.
+**
+** The search is coordinate descent: starting from the built-in defaults,
+** it tries every value of one parameter in turn - the register block, kc,
+** mc, nc, the loop order and the number of threads - keeps the fastest and
+** moves on to the next.  The sweep is repeated until nothing changes, as
+** the best mc, say, can depend on the register block.  Each trial is the
+** fastest of a few runs of an n x n x n multiply, and is checked against
+** the result with the built-in parameters.
+**
+** The winner is saved in the tuning cache (DGEMM_TUNE_FILE, or else
+** ~/.dgemm_tune) under the CPU model, and dgemm_blocked() picks it up on
+** any later run on the same kind of CPU.  Run it once on each node type,
+** with OMP_NUM_THREADS set as it will be for the real jobs.  The best
+** number of threads is saved too, but only as a note: dgemm_blocked()
+** always uses all of OMP_NUM_THREADS, so if fewer were faster, we say so
+** and leave it to you to set OMP_NUM_THREADS to match.
+**
+** Usage: omp_autotune_mm.exe [n [repeats]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "dgemm_blocked.h"
+#include "philox.h"
+
+#define DIM 1000
+#define REPEATS 3      /* timed runs of each trial; we keep the fastest */
+#define MAX_SWEEPS 3
+#define TOLERANCE 1e-12
+
+static const int kc_values[] = { 64, 128, 192, 256, 384, 512 };
+static const int mc_values[] = { 48, 72, 96, 144, 192, 288, 384 };
+static const int nc_values[] = { 512, 1024, 2048, 4096, 8192 };
+#define COUNT(a) ((int)(sizeof(a)/sizeof(a[0])))
+
+enum { KERNEL, KC, MC, NC, ORDER, THREADS, NPARAMS };
+static const char* param_names[NPARAMS] = { "kernel", "kc", "mc", "nc", "order", "threads" };
+
+static int n = DIM;
+static int repeats = REPEATS;
+static double *A, *B, *C, *Cref;
+
+/* the number of values of parameter p to try */
+int nvalues(int p, int maxthreads)
+{
+  int count = 0, t;
+
+  switch (p) {
+  case KERNEL:  return dgemm_nkernels();
+  case KC:      return COUNT(kc_values);
+  case MC:      return COUNT(mc_values);
+  case NC:      return COUNT(nc_values);
+  case ORDER:   return DGEMM_NORDERS;
+  case THREADS:
+    /* 1, 2, 4, ... and then all of them (0) */
+    for (t = 1; t < maxthreads; t *= 2)
+      count++;
+    return count + 1;
+  }
+  return 0;
+}
+
+/* set parameter p to its v-th value */
+void set_value(dgemm_params_t* params, int p, int v, int maxthreads)
+{
+  switch (p) {
+  case KERNEL:  params->kernel = v; break;
+  case KC:      params->kc = kc_values[v]; break;
+  case MC:      params->mc = mc_values[v]; break;
+  case NC:      params->nc = nc_values[v]; break;
+  case ORDER:   params->order = v; break;
+  case THREADS:
+    params->nthreads = (v == nvalues(THREADS, maxthreads) - 1) ? 0 : 1 << v;
+    break;
+  }
+}
+
+/* GFLOP/s of the fastest of the runs with these parameters, or 0 if the answer is wrong */
+double trial(const dgemm_params_t* params)
+{
+  double tic, elapsed, best = 0.0;
+  double err, maxerr = 0.0;
+  long i, nn = (long)n*n;
+  int r;
+
+  /* run 0 is the warm-up */
+  for (r = 0; r <= repeats; r++) {
+    tic = omp_get_wtime();
+    dgemm_blocked_params(params, n, n, n, 1.0, A, n, B, n, 0.0, C, n);
+    elapsed = omp_get_wtime() - tic;
+    if (r == 1 || (r > 1 && elapsed < best)) best = elapsed;
+  }
+
+  for (i = 0; i < nn; i++) {
+    err = fabs(C[i] - Cref[i]) / fabs(Cref[i]);
+    if (err > maxerr) maxerr = err;
+  }
+  if (maxerr > TOLERANCE) {
+    printf("  (wrong answer, error %g)\n", maxerr);
+    return 0.0;
+  }
+
+  return 2.0*n*n*(double)n / best / 1.0e9;
+}
+
+void print_params(const dgemm_params_t* params)
+{
+  printf("kernel %-5s mc %4d kc %4d nc %5d order %s threads ",
+         dgemm_kernel_name(params->kernel), params->mc, params->kc, params->nc,
+         dgemm_order_name(params->order));
+  if (params->nthreads > 0)
+    printf("%d", params->nthreads);
+  else
+    printf("all");
+}
+
+int main(int argc, char* argv[])
+{
+  int maxthreads = omp_get_max_threads();
+  int sweep, p, v, changed;
+  long nn;
+  char model[256];
+
+  dgemm_params_t best, params;
+  double gflops, best_gflops, builtin_gflops;
+
+  if (argc > 3) {
+    fprintf(stderr, "Usage: %s [n [repeats]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (argc > 1) n = atoi(argv[1]);
+  if (argc > 2) repeats = atoi(argv[2]);
+  if (n < 1 || repeats < 1) {
+    fprintf(stderr, "Error: n and repeats must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+  nn = (long)n*n;
+
+  A = dgemm_alloc(nn);
+  B = dgemm_alloc(nn);
+  C = dgemm_alloc(nn);
+  Cref = dgemm_alloc(nn);
+
+  /* one Philox stream for each matrix, filled in by all the threads */
+  philox_fill_uniform(A, nn, 86456, 0);
+  philox_fill_uniform(B, nn, 86456, 1);
+
+  dgemm_cpu_model(model, sizeof(model));
+  printf("tuning C(%d,%d) = A(%d,%d) B(%d,%d) on \"%s\", up to %d threads, fastest of %d runs\n\n",
+         n, n, n, n, n, n, model, maxthreads, repeats);
+
+  dgemm_builtin_params(&best);
+  dgemm_blocked_params(&best, n, n, n, 1.0, A, n, B, n, 0.0, Cref, n);
+  best_gflops = builtin_gflops = trial(&best);
+  printf("built-in: ");
+  print_params(&best);
+  printf(": %.2f GFLOP/s\n", best_gflops);
+
+  for (sweep = 0; sweep < MAX_SWEEPS; sweep++) {
+    changed = 0;
+    for (p = 0; p < NPARAMS; p++) {
+      printf("\nsweep %d, %s:\n", sweep + 1, param_names[p]);
+      for (v = 0; v < nvalues(p, maxthreads); v++) {
+        params = best;
+        set_value(&params, p, v, maxthreads);
+        printf("  ");
+        print_params(&params);
+        gflops = trial(&params);
+        printf(": %.2f GFLOP/s\n", gflops);
+        /* a change has to be worth 1%, so that noise doesn't keep the sweeps going */
+        if (gflops > 1.01*best_gflops) {
+          best = params;
+          best_gflops = gflops;
+          changed = 1;
+        }
+      }
+    }
+    if (!changed)
+      break;
+  }
+
+  printf("\nbest: ");
+  print_params(&best);
+  printf(": %.2f GFLOP/s (%.2fx the built-in parameters)\n",
+         best_gflops, best_gflops / builtin_gflops);
+
+  if (dgemm_save_params(model, &best) == 0)
+    printf("saved in %s\n", dgemm_tune_file());
+  if (best.nthreads > 0 && best.nthreads < maxthreads)
+    printf("dgemm_blocked() will use all %d threads: set OMP_NUM_THREADS=%d for %d\n",
+           maxthreads, best.nthreads, best.nthreads);
+
+  free(A);
+  free(B);
+  free(C);
+  free(Cref);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+/*
+** C = A B for the same 2000x2000 column-major matrices as serial_blas_mm.c,
+** using the cache-blocked, register-tiled DGEMM in dgemm_blocked.c.
+**
+** It starts from the parameters saved for this CPU by omp_autotune_mm.exe
+** (or the built-in ones, if there are none), and any given on the command
+** line replace them.  The kernel is a register block such as 8x6, and the
+** order a number from 0 to 3 (see dgemm_blocked.h).
+**
+** Usage: omp_blocked_mm.exe [mc kc nc [kernel [order [nthreads]]]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "dgemm_blocked.h"
+#include "philox.h"
+
+#define DIM1 2000
+#define DIM2 2000
+#define DIM3 2000
+
+#define NCHECK 1000    /* entries of C checked against a dot product */
+
+int main(int argc, char* argv[])
+{
+  int i, j, k, n;
+  int nthreads;
+
+  double *A;
+  double *B;
+  double *C;
+
+  long dim1 = DIM1;
+  long dim2 = DIM2;
+  long dim3 = DIM3;
+
+  dgemm_params_t params;
+
+  double tic, toc;
+  double elapsed_time;
+  double err, maxerr = 0.0;
+
+  dgemm_default_params(&params);
+
+  if (argc == 2 || argc == 3 || argc > 7) {
+    fprintf(stderr, "Usage: %s [mc kc nc [kernel [order [nthreads]]]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (argc > 3) {
+    params.mc = atoi(argv[1]);
+    params.kc = atoi(argv[2]);
+    params.nc = atoi(argv[3]);
+  }
+  if (argc > 4 && (params.kernel = dgemm_find_kernel(argv[4])) < 0) {
+    fprintf(stderr, "Error: the kernels are");
+    for (i = 0; i < dgemm_nkernels(); i++)
+      fprintf(stderr, " %s", dgemm_kernel_name(i));
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+  }
+  if (argc > 5) params.order = atoi(argv[5]);
+  if (argc > 6) params.nthreads = atoi(argv[6]);
+  if (params.mc < 1 || params.kc < 1 || params.nc < 1) {
+    fprintf(stderr, "Error: tile sizes must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+  if (params.order < 0 || params.order >= DGEMM_NORDERS || params.nthreads < 0) {
+    fprintf(stderr, "Error: order must be 0 to %d and nthreads not negative\n",
+            DGEMM_NORDERS - 1);
+    exit(EXIT_FAILURE);
+  }
+
+  A = dgemm_alloc(dim1*dim2);
+  B = dgemm_alloc(dim2*dim3);
+  C = dgemm_alloc(dim1*dim3);
+
+  /* one Philox stream for each matrix, filled in by all the threads */
+  philox_fill_uniform(A, (long)dim1*dim2, 86456, 0);
+  philox_fill_uniform(B, (long)dim2*dim3, 86456, 1);
+
+  nthreads = omp_get_max_threads();
+  if (params.nthreads > 0 && params.nthreads < nthreads)
+    nthreads = params.nthreads;
+
+  tic = omp_get_wtime();
+
+  dgemm_blocked_params(&params, dim1, dim3, dim2, 1.0, A, dim1, B, dim2, 0.0, C, dim1);
+
+  toc = omp_get_wtime();
+  elapsed_time = toc - tic;
+
+  /* spot-check some entries of C against a plain dot product */
+  srand(86456);
+  for (n = 0; n < NCHECK; n++) {
+    double sum = 0.0;
+    i = rand() % dim1;
+    j = rand() % dim3;
+    for (k = 0; k < dim2; k++)
+      sum += A[i + k*dim1]*B[k + j*dim2];
+    err = fabs(C[i + j*dim1] - sum) / fabs(sum);
+    if (err > maxerr) maxerr = err;
+  }
+
+  printf("time for C(%ld,%ld) = A(%ld,%ld) B(%ld,%ld) is %fs (%d threads, %.2f GFLOP/s)\n",
+         dim1, dim3, dim1, dim2, dim2, dim3, elapsed_time, nthreads,
+         2.0*dim1*dim2*dim3 / elapsed_time / 1.0e9);
+  printf("tiles: mc=%d kc=%d nc=%d, register block %s, loop order %s\n",
+         params.mc, params.kc, params.nc, dgemm_kernel_name(params.kernel),
+         dgemm_order_name(params.order));
+  printf("max relative error in %d sampled entries: %g\n", NCHECK, maxerr);
+
+  free(A);
+  free(B);
+  free(C);
+
+  return EXIT_SUCCESS;
+}
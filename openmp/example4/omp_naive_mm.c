@@ -1,55 +1,133 @@
+/*
+** The naive matrix multiply of serial_naive_mm.c, with OpenMP work sharing.
+**
+** On a node with more than one socket, each socket has its own memory
+** (NUMA) and a page of memory is placed next to the thread that first
+** writes to it.  So where A, B and C are filled in decides how much of
+** the multiply has to read across the link between the sockets:
+**
+**   serial      - the master thread fills everything, as serial_naive_mm.c
+**                 does, so every page lands on the master's socket
+**   first-touch - each thread fills the columns of B and C that it will
+**                 use in the multiply (the default)
+**   interleave  - pages are dealt out round-robin over all the sockets
+**
+** The random numbers of each column come from its own Philox stream
+** (../../mpi/montecarlo/philox.h), so the matrices are the same for any
+** number of threads.
+**
+** Usage: omp_naive_mm.exe [serial|first-touch|interleave]
+*/
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <omp.h>
+
+#include "philox.h"
 
 #define DIM1 2000
 #define DIM2 2000
 #define DIM3 2000
 
-int main()
+#define SEED 86456
+
+enum { SERIAL, FIRST_TOUCH, INTERLEAVE };
+static const char* placements[] = { "serial", "first-touch", "interleave" };
+
+/*
+** Memory for n doubles.  The pages are not touched here, so they are
+** placed when they are first written; with interleave they are placed
+** round-robin over every NUMA node we are allowed to use.
+*/
+double* alloc_matrix(long n, int placement)
+{
+  size_t bytes = sizeof(double)*n;
+  unsigned long nodemask = ~0UL;
+  void* p;
+
+  p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "Error: could not allocate %ld doubles\n", n);
+    exit(EXIT_FAILURE);
+  }
+  /* mbind() has no wrapper in glibc; the nodes in the mask that don't exist are ignored */
+  if (placement == INTERLEAVE &&
+      syscall(SYS_mbind, p, bytes, MPOL_INTERLEAVE, &nodemask, 8*sizeof(nodemask), 0) != 0)
+    perror("Warning: mbind failed, using first-touch placement");
+
+  return (double*)p;
+}
+
+/* fill column j of an m-row matrix with its own, reproducible random numbers */
+void fill_column(double* M, long m, long j)
+{
+  philox_t rng = philox_init(SEED, j);
+
+  philox_uniform_batch(&rng, &M[j*m], m);
+}
+
+int main(int argc, char* argv[])
 {
   int ii, jj, kk;
   int nthreads;
+  int placement = FIRST_TOUCH;
 
   double *A;
-  double *B; 
+  double *B;
   double *C;
 
   long dim1 = DIM1;
   long dim2 = DIM2;
   long dim3 = DIM3;
 
-  clock_t tic, toc;
-  float elapsed_time;
-  double maxr;
-
-
-  A = (double*)malloc(sizeof(double)*(dim1*dim2));
-  B = (double*)malloc(sizeof(double)*(dim2*dim3));
-  C = (double*)malloc(sizeof(double)*(dim1*dim3));
-
-  srand(86456);
-  maxr = (double)RAND_MAX;
+  double tic, toc;
+  double elapsed_time;
 
-  /* filling out in column-major order */
-  for (ii = 0; ii < dim1; ii++)
-    for (jj = 0; jj < dim2; jj++)
-      A[ii + jj*dim1] = rand()/maxr;
+  if (argc > 1) {
+    for (placement = SERIAL; placement <= INTERLEAVE; placement++)
+      if (!strcmp(argv[1], placements[placement])) break;
+    if (placement > INTERLEAVE || argc > 2) {
+      fprintf(stderr, "Usage: %s [serial|first-touch|interleave]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
 
-  for (ii = 0; ii < dim2; ii++)
-    for (jj = 0; jj < dim3; jj++)
-      B[ii + jj*dim2] = rand()/maxr;
+  A = alloc_matrix(dim1*dim2, placement);
+  B = alloc_matrix(dim2*dim3, placement);
+  C = alloc_matrix(dim1*dim3, placement);
+
+  /*
+  ** Fill in the matrices.  The static schedule over columns is the same as
+  ** the multiply's, so each thread first touches the columns of B and C it
+  ** will use.  Every thread reads all of A, so its columns are just spread
+  ** evenly over the threads.
+  */
+#pragma omp parallel for schedule(static) if(placement != SERIAL)
+  for (kk = 0; kk < dim2; kk++)
+    fill_column(A, dim1, kk);
+
+#pragma omp parallel for schedule(static) private(ii) if(placement != SERIAL)
+  for (jj = 0; jj < dim3; jj++) {
+    fill_column(B, dim2, dim2 + jj);    /* offset, so B's columns differ from A's */
+    for (ii = 0; ii < dim1; ii++)
+      C[ii + jj*dim1] = 0.;
+  }
 
-  tic = clock();
+  tic = omp_get_wtime();
 
 #pragma omp parallel shared(A,B,C,nthreads) private(ii,jj,kk)
   {
-#pragma master
+#pragma omp master
     {
       nthreads = omp_get_num_threads();
     }
 
-#pragma omp for
+#pragma omp for schedule(static)
     for (jj = 0; jj < dim3; jj++)
       {
 	for (ii = 0; ii < dim3; ii++)
@@ -57,19 +135,20 @@ int main()
 	for (kk = 0; kk < dim2; kk++)
 	  for (ii = 0; ii < dim1; ii++)
 	    C[ii + jj*dim1] += A[ii + kk*dim1]*B[kk + jj*dim2];
-      }   
+      }
   }
-  
-  toc = clock();
-  elapsed_time = (float)(toc - tic)/(float)CLOCKS_PER_SEC;
-  elapsed_time /= (float)nthreads;
 
-  printf("time for C(%d,%d) = A(%d,%d) B(%d,%d) is %fs (%d threads)\n",
-	 dim1, dim3, dim1, dim2, dim2, dim3, elapsed_time, nthreads);
+  /* wall-clock time: clock() would add up the CPU time of every thread */
+  toc = omp_get_wtime();
+  elapsed_time = toc - tic;
+
+  printf("time for C(%ld,%ld) = A(%ld,%ld) B(%ld,%ld) is %fs (%d threads, %s placement, %.2f GFLOP/s)\n",
+	 dim1, dim3, dim1, dim2, dim2, dim3, elapsed_time, nthreads, placements[placement],
+	 2.0*dim1*dim2*dim3 / elapsed_time / 1.0e9);
 
-  free(A);
-  free(B);
-  free(C);
+  munmap(A, sizeof(double)*dim1*dim2);
+  munmap(B, sizeof(double)*dim2*dim3);
+  munmap(C, sizeof(double)*dim1*dim3);
 
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,361 @@
+/*
+** C = A B in single, mixed and double precision, using the blocked kernels
+** of dgemm_blocked.c, with the error of each against the DGEMM result;
+** then the solve of A X = B for nrhs right-hand sides, to double precision
+** accuracy, with most of the work done in single precision.
+**
+**   dgemm   - double in, double sums: the reference
+**   sgemm   - float in, float sums; twice as many elements per vector and
+**             half the memory traffic of dgemm
+**   mixed   - float in, double sums: the error is mostly from rounding the
+**             inputs, rather than from adding up n terms in float
+**
+**   dgesv   - the LU of A in double (getrf_template.h, whose time goes on
+**             dgemm_blocked()), then the triangular solves: the reference
+**   sgesv   - the same in float, with sgemm_blocked(): faster, but only as
+**             accurate as float
+**   refined - iterative refinement, as LAPACK's dsgesv: the float LU and
+**             solve, then, until the residual R = B - A X (in double) is as
+**             small as dgesv's, solve A D = R with the float factors and
+**             set X = X + D.  Each step costs
+**             O(n^2 nrhs), against O(n^3) for the LU, and gains several
+**             digits as long as cond(A) is well below 1/FLT_EPSILON.  If it
+**             hasn't converged after ITERMAX steps, it falls back to dgesv.
+**
+** For the solves we report the backward error, max_j ||r_j|| / (||A|| ||x_j||)
+** in the infinity norm, which refined stops at sqrt(n) DBL_EPSILON as
+** dsgesv does, and the largest difference from the dgesv solution,
+** relative to its largest element.
+**
+** Usage: omp_sgemm_mm.exe [n [repeats [nrhs]]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+
+#include "dgemm_blocked.h"
+#include "philox.h"
+
+#define DIM 2000
+#define REPEATS 3    /* timed runs of each mode; we keep the fastest */
+#define NRHS 16      /* right-hand sides of the solves */
+#define NB 128       /* columns per step of the LU */
+#define ITERMAX 30   /* refinement steps before falling back to dgesv */
+
+#define GETRF_PREFIX s
+#define GETRF_T float
+#define GETRF_GEMM sgemm_blocked
+#include "getrf_template.h"
+#undef GETRF_PREFIX
+#undef GETRF_T
+#undef GETRF_GEMM
+
+#define GETRF_PREFIX d
+#define GETRF_T double
+#define GETRF_GEMM dgemm_blocked
+#include "getrf_template.h"
+#undef GETRF_PREFIX
+#undef GETRF_T
+#undef GETRF_GEMM
+
+#define NMODES 3
+enum { DGEMM, SGEMM, MIXED };
+static const char* names[NMODES] = { "dgemm", "sgemm", "mixed" };
+
+#define NSOLVES 3
+enum { DGESV, SGESV, REFINED };
+static const char* solve_names[NSOLVES] = { "dgesv", "sgesv", "refined" };
+
+/* the workspace of the solves */
+typedef struct {
+  double* Ad;    /* the double LU */
+  float* As;     /* the float LU */
+  int* piv;
+  double* R;     /* the residual */
+  float* Rs;     /* ... in float, and the correction */
+} solve_work_t;
+
+/* the infinity norm of the n x n matrix A: the largest sum of a row */
+static double norm_inf(int n, const double* A)
+{
+  double norm = 0.0;
+  int i0;
+
+#pragma omp parallel for reduction(max:norm) schedule(static)
+  for (i0 = 0; i0 < n; i0 += 256) {
+    double sum[256] = { 0.0 };
+    int ib = MIN(256, n - i0), i, j;
+
+    for (j = 0; j < n; j++)
+      for (i = 0; i < ib; i++)
+        sum[i] += fabs(A[(i0 + i) + (long)j*n]);
+    for (i = 0; i < ib; i++)
+      if (sum[i] > norm) norm = sum[i];
+  }
+  return norm;
+}
+
+/* R = B - A X, for n x nrhs X and B */
+static void residual(int n, int nrhs, const double* A, const double* X, const double* B,
+                     double* R)
+{
+  memcpy(R, B, (size_t)n*nrhs*sizeof(double));
+  dgemm_blocked(n, nrhs, n, -1.0, A, n, X, n, 1.0, R, n);
+}
+
+static double backward_error(int n, int nrhs, double normA, const double* X, const double* R)
+{
+  double err, maxerr = 0.0, rmax, xmax;
+  int i, j;
+
+  for (j = 0; j < nrhs; j++) {
+    rmax = xmax = 0.0;
+    for (i = 0; i < n; i++) {
+      if (fabs(R[i + (long)j*n]) > rmax) rmax = fabs(R[i + (long)j*n]);
+      if (fabs(X[i + (long)j*n]) > xmax) xmax = fabs(X[i + (long)j*n]);
+    }
+    err = rmax/(normA*xmax);
+    if (err > maxerr) maxerr = err;
+  }
+  return maxerr;
+}
+
+/* X = A^-1 B in double */
+static void double_solve(int n, int nrhs, const double* A, const double* B, double* X,
+                         solve_work_t* w)
+{
+  long i;
+
+#pragma omp parallel for
+  for (i = 0; i < (long)n*n; i++)
+    w->Ad[i] = A[i];
+  dgetrf(n, NB, w->Ad, n, w->piv);
+
+  for (i = 0; i < (long)n*nrhs; i++)
+    X[i] = B[i];
+  dgetrs(n, nrhs, w->Ad, n, w->piv, X, n);
+}
+
+/* X = A^-1 B in float */
+static void single_solve(int n, int nrhs, const double* A, const double* B, double* X,
+                         solve_work_t* w)
+{
+  long i;
+
+#pragma omp parallel for
+  for (i = 0; i < (long)n*n; i++)
+    w->As[i] = (float)A[i];
+  sgetrf(n, NB, w->As, n, w->piv);
+
+  for (i = 0; i < (long)n*nrhs; i++)
+    w->Rs[i] = (float)B[i];
+  sgetrs(n, nrhs, w->As, n, w->piv, w->Rs, n);
+  for (i = 0; i < (long)n*nrhs; i++)
+    X[i] = w->Rs[i];
+}
+
+/*
+** X = A^-1 B by iterative refinement of the float solve.  Returns the
+** number of refinement steps, or -1 if it fell back to the double solve.
+*/
+static int refined_solve(int n, int nrhs, const double* A, const double* B, double* X,
+                         solve_work_t* w)
+{
+  double normA = norm_inf(n, A);
+  double tol = sqrt((double)n)*DBL_EPSILON;
+  long i, nx = (long)n*nrhs;
+  int step;
+
+  single_solve(n, nrhs, A, B, X, w);
+
+  for (step = 0; ; step++) {
+    residual(n, nrhs, A, X, B, w->R);
+    if (backward_error(n, nrhs, normA, X, w->R) <= tol)
+      return step;
+    if (step == ITERMAX)
+      break;
+
+    /* the correction, from the float factors of A */
+    for (i = 0; i < nx; i++)
+      w->Rs[i] = (float)w->R[i];
+    sgetrs(n, nrhs, w->As, n, w->piv, w->Rs, n);
+    for (i = 0; i < nx; i++)
+      X[i] += w->Rs[i];
+  }
+
+  /* A is too badly conditioned for float */
+  double_solve(n, nrhs, A, B, X, w);
+  return -1;
+}
+
+int main(int argc, char* argv[])
+{
+  int n = DIM;
+  int repeats = REPEATS;
+  int nrhs = NRHS;
+  int nthreads;
+  int mode, r, steps = 0;
+  long i, nn, nx;
+
+  double *A, *B, *Cd, *C;
+  float *As, *Bs, *Cs;
+  double *Bx, *X, *Xd;
+  solve_work_t w;
+
+  double tic, elapsed, best;
+  double err, maxerr, normA, xmax;
+
+  if (argc > 4) {
+    fprintf(stderr, "Usage: %s [n [repeats [nrhs]]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (argc > 1) n = atoi(argv[1]);
+  if (argc > 2) repeats = atoi(argv[2]);
+  if (argc > 3) nrhs = atoi(argv[3]);
+  if (n < 1 || repeats < 1 || nrhs < 1) {
+    fprintf(stderr, "Error: n, repeats and nrhs must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+  nn = (long)n*n;
+  nx = (long)n*nrhs;
+
+  A = dgemm_alloc(nn);
+  B = dgemm_alloc(nn);
+  Cd = dgemm_alloc(nn);
+  C = dgemm_alloc(nn);
+  As = sgemm_alloc(nn);
+  Bs = sgemm_alloc(nn);
+  Cs = sgemm_alloc(nn);
+  Bx = dgemm_alloc(nx);
+  X = dgemm_alloc(nx);
+  Xd = dgemm_alloc(nx);
+  w.Ad = dgemm_alloc(nn);
+  w.As = sgemm_alloc(nn);
+  w.R = dgemm_alloc(nx);
+  w.Rs = sgemm_alloc(nx);
+  w.piv = (int*)malloc(sizeof(int)*n);
+  if (w.piv == NULL) {
+    fprintf(stderr, "Error: could not allocate the pivots\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* one Philox stream for each matrix, filled in by all the threads */
+  philox_fill_uniform(A, nn, 86456, 0);
+  philox_fill_uniform(B, nn, 86456, 1);
+  philox_fill_uniform(Bx, nx, 86456, 2);
+
+  for (i = 0; i < nn; i++) {
+    As[i] = (float)A[i];
+    Bs[i] = (float)B[i];
+  }
+
+#pragma omp parallel
+  {
+#pragma omp master
+    nthreads = omp_get_num_threads();
+  }
+
+  printf("C(%d,%d) = A(%d,%d) B(%d,%d), %d threads, fastest of %d runs\n\n",
+         n, n, n, n, n, n, nthreads, repeats);
+  printf("%-8s %12s %12s %14s\n", "mode", "time (s)", "GFLOP/s", "max rel error");
+
+  for (mode = 0; mode < NMODES; mode++) {
+    best = 0.0;
+    /* run 0 is the warm-up */
+    for (r = 0; r <= repeats; r++) {
+      tic = omp_get_wtime();
+      switch (mode) {
+      case DGEMM:
+        dgemm_blocked(n, n, n, 1.0, A, n, B, n, 0.0, Cd, n);
+        break;
+      case SGEMM:
+        sgemm_blocked(n, n, n, 1.0f, As, n, Bs, n, 0.0f, Cs, n);
+        break;
+      case MIXED:
+        dsgemm_blocked(n, n, n, 1.0, As, n, Bs, n, 0.0, C, n);
+        break;
+      }
+      elapsed = omp_get_wtime() - tic;
+      if (r == 1 || (r > 1 && elapsed < best)) best = elapsed;
+    }
+
+    maxerr = 0.0;
+    if (mode != DGEMM) {
+      for (i = 0; i < nn; i++) {
+        err = fabs(((mode == SGEMM) ? (double)Cs[i] : C[i]) - Cd[i]) / fabs(Cd[i]);
+        if (err > maxerr) maxerr = err;
+      }
+    }
+
+    printf("%-8s %12.6f %12.2f %14.2e\n", names[mode], best,
+           2.0*n*n*(double)n / best / 1.0e9, maxerr);
+  }
+
+  printf("\nA(%d,%d) X = B(%d,%d), LU in steps of %d columns\n\n", n, n, n, nrhs, NB);
+  printf("%-8s %12s %12s %14s %14s %6s\n", "mode", "time (s)", "GFLOP/s", "backward err",
+         "diff dgesv", "steps");
+
+  normA = norm_inf(n, A);
+  for (mode = 0; mode < NSOLVES; mode++) {
+    best = 0.0;
+    for (r = 0; r <= repeats; r++) {
+      tic = omp_get_wtime();
+      switch (mode) {
+      case DGESV:
+        double_solve(n, nrhs, A, Bx, Xd, &w);
+        break;
+      case SGESV:
+        single_solve(n, nrhs, A, Bx, X, &w);
+        break;
+      case REFINED:
+        steps = refined_solve(n, nrhs, A, Bx, X, &w);
+        break;
+      }
+      elapsed = omp_get_wtime() - tic;
+      if (r == 1 || (r > 1 && elapsed < best)) best = elapsed;
+    }
+
+    /* the error of the last run */
+    if (mode == DGESV)
+      for (i = 0; i < nx; i++)
+        X[i] = Xd[i];
+    residual(n, nrhs, A, X, Bx, w.R);
+    maxerr = xmax = 0.0;
+    for (i = 0; i < nx; i++) {
+      if (fabs(X[i] - Xd[i]) > maxerr) maxerr = fabs(X[i] - Xd[i]);
+      if (fabs(Xd[i]) > xmax) xmax = fabs(Xd[i]);
+    }
+
+    printf("%-8s %12.6f %12.2f %14.2e %14.2e", solve_names[mode], best,
+           (2.0*n*n*(double)n/3.0 + 2.0*n*(double)n*nrhs) / best / 1.0e9,
+           backward_error(n, nrhs, normA, X, w.R), maxerr/xmax);
+    if (mode != REFINED)
+      printf(" %6s\n", "-");
+    else if (steps >= 0)
+      printf(" %6d\n", steps);
+    else
+      printf(" %6s\n", "dgesv");
+  }
+
+  free(A);
+  free(B);
+  free(Cd);
+  free(C);
+  free(As);
+  free(Bs);
+  free(Cs);
+  free(Bx);
+  free(X);
+  free(Xd);
+  free(w.Ad);
+  free(w.As);
+  free(w.R);
+  free(w.Rs);
+  free(w.piv);
+
+  return EXIT_SUCCESS;
+}
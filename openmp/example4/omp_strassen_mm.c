@@ -0,0 +1,291 @@
+/*
+** C = A B for large n x n column-major matrices using the Strassen-Winograd
+** algorithm: 7 multiplies and 15 additions of half-size blocks in place of
+** 8 multiplies, applied recursively.
+**
+** The top levels of the recursion run their 7 products as OpenMP tasks.
+** Below a crossover size we switch to an ordinary O(n^3) kernel, either
+** the blocked DGEMM of dgemm_blocked.c or a BLAS loaded at run-time.  All
+** of the temporaries come from one arena, sized before we start, and so
+** do the packing buffers of the blocked kernel (through dgemm_blocked_ws()),
+** one set for each product that can run at once, so there is no malloc in
+** the recursion.
+**
+** We report the time and error against the same kernel applied to the
+** whole matrix (classical DGEMM).
+**
+** Usage: omp_strassen_mm.exe [n [crossover [task_levels [kernel]]]]
+**
+** where kernel is blocked (the default) or a BLAS backend, as for
+** serial_blas_mm.exe.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "dgemm_blocked.h"
+#include "philox.h"
+#include "blas_loader.h"
+
+#define DIM 4096          /* default matrix size */
+#define CROSSOVER 512     /* default size below which we use the kernel */
+#define TASK_LEVELS 1     /* default number of levels that spawn tasks */
+#define NTEMP 11          /* h x h temporaries held by each level */
+
+static int crossover = CROSSOVER;
+static int task_levels = TASK_LEVELS;
+static int use_blas = 0;
+static blas_backend_t blas;
+static dgemm_params_t params;    /* the tuned parameters of the blocked kernel */
+static int leaf_threads;         /* threads for each call of the kernel */
+
+/*
+** C = A B, with the O(n^3) kernel.  The blocked kernel packs into work,
+** which holds lwork doubles, or into buffers of its own if work is NULL.
+*/
+static void kernel_mm(int n, const double* A, int lda, const double* B, int ldb,
+                      double* C, int ldc, double* work, long lwork)
+{
+  if (use_blas) {
+    char trans = 'N';
+    double one = 1.0, zero = 0.0;
+    blas.dgemm(&trans, &trans, &n, &n, &n, &one, A, &lda, B, &ldb, &zero, C, &ldc);
+  }
+  else if (work == NULL)
+    dgemm_blocked_params(&params, n, n, n, 1.0, A, lda, B, ldb, 0.0, C, ldc);
+  else
+    dgemm_blocked_ws(&params, n, n, n, 1.0, A, lda, B, ldb, 0.0, C, ldc, work, lwork);
+}
+
+/* the packing buffers of the kernel for an n x n product */
+static long kernel_workspace(int n)
+{
+  return use_blas ? 0 : dgemm_blocked_ws_size(&params, n, n, n, leaf_threads);
+}
+
+/* Z = X + sign*Y for h x h blocks, split into tasks if asked */
+static void add(int h, const double* X, int ldx, double sign, const double* Y, int ldy,
+                double* Z, int ldz, int spawn)
+{
+  int i, j;
+
+#pragma omp taskloop if(spawn) private(i)
+  for (j = 0; j < h; j++)
+    for (i = 0; i < h; i++)
+      Z[i + (long)j*ldz] = X[i + (long)j*ldx] + sign*Y[i + (long)j*ldy];
+}
+
+/* the workspace needed below a node of size n at the given depth */
+static long workspace(int n, int depth)
+{
+  long h = n/2;
+
+  if (n <= crossover || n % 2)
+    return kernel_workspace(n);
+  return NTEMP*h*h + ((depth < task_levels) ? 7 : 1) * workspace(h, depth + 1);
+}
+
+static void strassen(int n, const double* A, int lda, const double* B, int ldb,
+                     double* C, int ldc, double* work, int depth)
+{
+  int h = n/2;
+  long hh = (long)h*h;
+  int spawn = depth < task_levels;
+  long wsize;
+
+  const double *A11, *A12, *A21, *A22, *B11, *B12, *B21, *B22;
+  double *C11, *C12, *C21, *C22;
+  double *S1, *S2, *S3, *S4, *T1, *T2, *T3, *T4, *P1, *P6, *P7, *child;
+
+  if (n <= crossover || n % 2) {
+    kernel_mm(n, A, lda, B, ldb, C, ldc, work, kernel_workspace(n));
+    return;
+  }
+
+  A11 = A;  A21 = A + h;  A12 = A + (long)h*lda;  A22 = A12 + h;
+  B11 = B;  B21 = B + h;  B12 = B + (long)h*ldb;  B22 = B12 + h;
+  C11 = C;  C21 = C + h;  C12 = C + (long)h*ldc;  C22 = C12 + h;
+
+  S1 = work;       S2 = work + hh;   S3 = work + 2*hh;  S4 = work + 3*hh;
+  T1 = work + 4*hh;  T2 = work + 5*hh;  T3 = work + 6*hh;  T4 = work + 7*hh;
+  P1 = work + 8*hh;  P6 = work + 9*hh;  P7 = work + 10*hh;
+  child = work + NTEMP*hh;
+  /* tasks run together and need an arena each; otherwise they share one */
+  wsize = spawn ? workspace(h, depth + 1) : 0;
+
+  add(h, A21, lda,  1.0, A22, lda, S1, h, spawn);
+  add(h, S1,  h,   -1.0, A11, lda, S2, h, spawn);
+  add(h, A11, lda, -1.0, A21, lda, S3, h, spawn);
+  add(h, A12, lda, -1.0, S2,  h,   S4, h, spawn);
+  add(h, B12, ldb, -1.0, B11, ldb, T1, h, spawn);
+  add(h, B22, ldb, -1.0, T1,  h,   T2, h, spawn);
+  add(h, B22, ldb, -1.0, B12, ldb, T3, h, spawn);
+  add(h, T2,  h,   -1.0, B21, ldb, T4, h, spawn);
+
+  /* the 7 products: four of them are parked in the quadrants of C */
+#pragma omp task if(spawn)
+  strassen(h, A11, lda, B11, ldb, P1,  h,   child,           depth + 1);
+#pragma omp task if(spawn)
+  strassen(h, A12, lda, B21, ldb, C11, ldc, child + wsize,   depth + 1);
+#pragma omp task if(spawn)
+  strassen(h, S4,  h,   B22, ldb, C12, ldc, child + 2*wsize, depth + 1);
+#pragma omp task if(spawn)
+  strassen(h, A22, lda, T4,  h,   C21, ldc, child + 3*wsize, depth + 1);
+#pragma omp task if(spawn)
+  strassen(h, S1,  h,   T1,  h,   C22, ldc, child + 4*wsize, depth + 1);
+#pragma omp task if(spawn)
+  strassen(h, S2,  h,   T2,  h,   P6,  h,   child + 5*wsize, depth + 1);
+#pragma omp task if(spawn)
+  strassen(h, S3,  h,   T3,  h,   P7,  h,   child + 6*wsize, depth + 1);
+#pragma omp taskwait
+
+  /* C11 = P1 + P2, and the rest from U2 = P1 + P6, U3 = U2 + P7, U4 = U2 + P5 */
+  add(h, P1, h,  1.0, C11, ldc, C11, ldc, spawn);
+  add(h, P1, h,  1.0, P6,  h,   P6,  h,   spawn);
+  add(h, P6, h,  1.0, P7,  h,   P7,  h,   spawn);
+  add(h, P6, h,  1.0, C22, ldc, P6,  h,   spawn);
+  add(h, P6, h,  1.0, C12, ldc, C12, ldc, spawn);
+  add(h, P7, h, -1.0, C21, ldc, C21, ldc, spawn);
+  add(h, P7, h,  1.0, C22, ldc, C22, ldc, spawn);
+}
+
+int main(int argc, char* argv[])
+{
+  int n = DIM;
+  int npad, nbase, levels;
+  int nthreads;
+  int i, j;
+  long l;
+  const char* kernel = "blocked";
+
+  double *A, *B, *C, *Cref;
+  double *Ap, *Bp, *Cp;
+  double *arena;
+  long wsize;
+
+  double tic, time_classical, time_strassen;
+  double err, maxerr = 0.0, maxref = 0.0;
+
+  if (argc > 5) {
+    fprintf(stderr, "Usage: %s [n [crossover [task_levels [kernel]]]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (argc > 1) n = atoi(argv[1]);
+  if (argc > 2) crossover = atoi(argv[2]);
+  if (argc > 3) task_levels = atoi(argv[3]);
+  if (argc > 4) kernel = argv[4];
+  if (n < 1 || crossover < 1 || task_levels < 0) {
+    fprintf(stderr, "Error: n and crossover must be positive and task_levels not negative\n");
+    exit(EXIT_FAILURE);
+  }
+
+  nthreads = omp_get_max_threads();
+  dgemm_default_params(&params);
+  if (strcmp(kernel, "blocked")) {
+    if (blas_load(kernel, &blas) != 0)
+      exit(EXIT_FAILURE);
+    use_blas = 1;
+  }
+
+  /* pad n so that it halves exactly down to the crossover */
+  nbase = n;
+  levels = 0;
+  while (nbase > crossover) {
+    nbase = (nbase + 1) / 2;
+    levels++;
+  }
+  npad = nbase << levels;
+
+  A = dgemm_alloc((long)n*n);
+  B = dgemm_alloc((long)n*n);
+  C = dgemm_alloc((long)n*n);
+  Cref = dgemm_alloc((long)n*n);
+
+  /* one Philox stream for each matrix, filled in by all the threads */
+  philox_fill_uniform(A, (long)n*n, 86456, 0);
+  philox_fill_uniform(B, (long)n*n, 86456, 1);
+
+  /* and touch C, so neither method is timed taking its page faults */
+  for (l = 0; l < (long)n*n; l++)
+    C[l] = Cref[l] = 0.0;
+
+  /* classical DGEMM, using every thread in the kernel */
+  if (use_blas) blas_set_threads(&blas, nthreads);
+  tic = omp_get_wtime();
+  kernel_mm(n, A, n, B, n, Cref, n, NULL, 0);
+  time_classical = omp_get_wtime() - tic;
+
+  /* with tasks, each kernel call gets one thread; without, it gets them all */
+  leaf_threads = (task_levels > 0) ? 1 : nthreads;
+  wsize = workspace(npad, 0);
+  arena = dgemm_alloc(wsize > 0 ? wsize : 1);
+
+  /* touch the arena now, so its page faults are not timed */
+#pragma omp parallel for
+  for (l = 0; l < wsize; l++)
+    arena[l] = 0.0;
+
+  if (use_blas) blas_set_threads(&blas, leaf_threads);
+
+  tic = omp_get_wtime();
+  if (npad != n) {
+    Ap = dgemm_alloc((long)npad*npad);
+    Bp = dgemm_alloc((long)npad*npad);
+    Cp = dgemm_alloc((long)npad*npad);
+    for (j = 0; j < npad; j++)
+      for (i = 0; i < npad; i++) {
+        Ap[i + (long)j*npad] = (i < n && j < n) ? A[i + (long)j*n] : 0.0;
+        Bp[i + (long)j*npad] = (i < n && j < n) ? B[i + (long)j*n] : 0.0;
+      }
+  }
+  else {
+    Ap = A;
+    Bp = B;
+    Cp = C;
+  }
+
+  if (task_levels > 0) {
+#pragma omp parallel
+#pragma omp single
+    strassen(npad, Ap, npad, Bp, npad, Cp, npad, arena, 0);
+  }
+  else
+    strassen(npad, Ap, npad, Bp, npad, Cp, npad, arena, 0);
+
+  if (npad != n) {
+    for (j = 0; j < n; j++)
+      for (i = 0; i < n; i++)
+        C[i + (long)j*n] = Cp[i + (long)j*npad];
+    free(Ap);
+    free(Bp);
+    free(Cp);
+  }
+  time_strassen = omp_get_wtime() - tic;
+
+  for (l = 0; l < (long)n*n; l++) {
+    err = fabs(C[l] - Cref[l]);
+    if (err > maxerr) maxerr = err;
+    if (fabs(Cref[l]) > maxref) maxref = fabs(Cref[l]);
+  }
+
+  printf("C(%d,%d) = A(%d,%d) B(%d,%d), %d threads, %s kernel\n",
+         n, n, n, n, n, n, nthreads, kernel);
+  printf("strassen: %d levels down to %d (padded to %d), tasks on %d levels, %.1f MB arena\n",
+         levels, nbase, npad, task_levels, wsize*sizeof(double) / 1.0e6);
+  printf("classical: %fs (%.2f GFLOP/s)\n", time_classical,
+         2.0*n*n*(double)n / time_classical / 1.0e9);
+  printf("strassen:  %fs (%.2f effective GFLOP/s), speed-up %.2f\n", time_strassen,
+         2.0*n*n*(double)n / time_strassen / 1.0e9, time_classical / time_strassen);
+  printf("max difference from classical: %.2e (relative %.2e)\n", maxerr, maxerr / maxref);
+
+  free(A);
+  free(B);
+  free(C);
+  free(Cref);
+  free(arena);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,505 @@
+/*
+** Tiled LU factorisation with partial pivoting, PA = LU, and tiled Cholesky
+** factorisation, A = L L^T, of an n x n column-major matrix cut into nb x nb
+** tiles.  The products of tiles use the blocked DGEMM of dgemm_blocked.c,
+** one thread per call.
+**
+** Each factorisation is scheduled two ways, with the same tile kernels:
+**
+**   fork-join - step k is a sequence of parallel loops: factor the panel,
+**               solve the tiles to its right (or below), update the tiles
+**               of the trailing matrix.  Every loop ends in a barrier, so
+**               threads wait for the slowest tile of each loop, and all of
+**               them wait while the panel is factored.
+**   tasks     - every tile operation is an OpenMP task, with depend clauses
+**               on the tiles it reads and writes.  The runtime starts each
+**               task as soon as the tasks it depends on are done, so the
+**               panel of step k+1 can start while the rest of the update
+**               of step k is still going on, with no barriers at all.
+**
+** A panel of LU is factored by a single task, since the choice of each
+** pivot needs the whole column; it is recursive (split the columns in half,
+** factor the left half, update the right half with DGEMM, factor it), so
+** most of its work is DGEMM too.  The row swaps it chooses are then applied
+** to the other columns by one task per tile column.  The depend clauses of
+** those tasks name a whole column of tiles, with an OpenMP 5.0 iterator.
+**
+** The answer is checked by solving A x = b with the factors.
+**
+** Usage: omp_tiled_factor.exe <lu|cholesky> [n [nb [repeats]]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+
+#include "dgemm_blocked.h"
+#include "philox.h"
+
+#define DIM 3000
+#define NB 192
+#define REPEATS 2      /* timed runs of each schedule; we keep the fastest */
+#define PANEL_LEAF 8   /* the recursive panel factorisation stops at this many columns */
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+/* the first element of tile (i,j): also the name of the tile in depend clauses */
+#define TILE(i, j) A[(long)(i)*nb + (long)(j)*nb*n]
+/* the number of rows or columns in tile row or column t */
+#define TSIZE(t) MIN(nb, n - (t)*nb)
+
+enum { FORK_JOIN, TASKS, NSCHEDULES };
+static const char* schedules[NSCHEDULES] = { "fork-join", "tasks" };
+
+static dgemm_params_t serial;    /* the tuned DGEMM, on one thread */
+static int failed = 0;           /* set if Cholesky finds A is not positive definite */
+
+/* C = C - A B for tiles, or any other small blocks */
+void gemm_update(int m, int n, int k, const double* A, int lda, const double* B, int ldb,
+                 double* C, int ldc)
+{
+  if (m > 0 && n > 0 && k > 0)
+    dgemm_blocked_params(&serial, m, n, k, -1.0, A, lda, B, ldb, 1.0, C, ldc);
+}
+
+/*
+** ------------------------------------------------------------------
+** LU kernels
+** ------------------------------------------------------------------
+*/
+
+/* swap rows k1..k2-1 of the n columns of A with rows piv[k1..k2-1] */
+void apply_pivots(int n, double* A, int lda, int k1, int k2, const int* piv)
+{
+  int j, r;
+  double tmp;
+
+  for (j = 0; j < n; j++)
+    for (r = k1; r < k2; r++)
+      if (piv[r] != r) {
+        tmp = A[r + (long)j*lda];
+        A[r + (long)j*lda] = A[piv[r] + (long)j*lda];
+        A[piv[r] + (long)j*lda] = tmp;
+      }
+}
+
+/* B = L^-1 B, for m x m unit lower triangular L and m x n B */
+void trsm_lower_unit(int m, int n, const double* L, int ldl, double* B, int ldb)
+{
+  int i, j, k;
+
+  for (j = 0; j < n; j++)
+    for (k = 0; k < m; k++)
+      for (i = k + 1; i < m; i++)
+        B[i + (long)j*ldb] -= L[i + (long)k*ldl]*B[k + (long)j*ldb];
+}
+
+/*
+** Factor the m x n panel A (m >= n) with partial pivoting, recursively.  On
+** return, A holds L and U, and row r was swapped with row piv[r] (>= r),
+** both relative to the top of the panel.
+*/
+void getrf_panel(int m, int n, double* A, int lda, int* piv)
+{
+  int n1, n2, i, j, k, p;
+  double amax, tmp;
+
+  if (n <= PANEL_LEAF) {
+    for (k = 0; k < n; k++) {
+      p = k;
+      amax = fabs(A[k + (long)k*lda]);
+      for (i = k + 1; i < m; i++)
+        if (fabs(A[i + (long)k*lda]) > amax) {
+          amax = fabs(A[i + (long)k*lda]);
+          p = i;
+        }
+      piv[k] = p;
+      if (p != k)
+        for (j = 0; j < n; j++) {
+          tmp = A[k + (long)j*lda];
+          A[k + (long)j*lda] = A[p + (long)j*lda];
+          A[p + (long)j*lda] = tmp;
+        }
+      /* a zero pivot leaves a zero column of L, as LAPACK does */
+      if (A[k + (long)k*lda] != 0.0)
+        for (i = k + 1; i < m; i++)
+          A[i + (long)k*lda] /= A[k + (long)k*lda];
+      for (j = k + 1; j < n; j++)
+        for (i = k + 1; i < m; i++)
+          A[i + (long)j*lda] -= A[i + (long)k*lda]*A[k + (long)j*lda];
+    }
+    return;
+  }
+
+  n1 = n/2;
+  n2 = n - n1;
+  /* [A11; A21] */
+  getrf_panel(m, n1, A, lda, piv);
+  /* A12 = L11^-1 P A12, A22 = A22 - A21 A12 */
+  apply_pivots(n2, A + (long)n1*lda, lda, 0, n1, piv);
+  trsm_lower_unit(n1, n2, A, lda, A + (long)n1*lda, lda);
+  gemm_update(m - n1, n2, n1, A + n1, lda, A + (long)n1*lda, lda, A + n1 + (long)n1*lda, lda);
+  /* A22, and its row swaps applied to A21 */
+  getrf_panel(m - n1, n2, A + n1 + (long)n1*lda, lda, piv + n1);
+  for (k = n1; k < n; k++)
+    piv[k] += n1;
+  apply_pivots(n1, A, lda, n1, n, piv);
+}
+
+/*
+** Factor tile column k, rows K0 = k*nb onwards, and make its pivots refer
+** to rows of the whole matrix.
+*/
+void lu_panel(int k, int n, int nb, double* A, int* piv)
+{
+  int K0 = k*nb, r;
+
+  getrf_panel(n - K0, TSIZE(k), A + K0 + (long)K0*n, n, piv + K0);
+  for (r = K0; r < K0 + TSIZE(k); r++)
+    piv[r] += K0;
+}
+
+/* apply the swaps of step k to tile column j, and for j > k solve for tile (k,j) of U */
+void lu_swap_solve(int k, int j, int n, int nb, double* A, const int* piv)
+{
+  int K0 = k*nb;
+
+  apply_pivots(TSIZE(j), A + (long)j*nb*n, n, K0, K0 + TSIZE(k), piv);
+  if (j > k)
+    trsm_lower_unit(TSIZE(k), TSIZE(j), &TILE(k, k), n, &TILE(k, j), n);
+}
+
+void lu_fork_join(int n, int nb, double* A, int* piv)
+{
+  int nt = (n + nb - 1)/nb;
+
+#pragma omp parallel
+  {
+    int i, j, k;
+
+    for (k = 0; k < nt; k++) {
+#pragma omp single
+      lu_panel(k, n, nb, A, piv);
+
+#pragma omp for schedule(dynamic)
+      for (j = 0; j < nt; j++)
+        if (j != k)
+          lu_swap_solve(k, j, n, nb, A, piv);
+
+#pragma omp for collapse(2) schedule(dynamic)
+      for (j = k + 1; j < nt; j++)
+        for (i = k + 1; i < nt; i++)
+          gemm_update(TSIZE(i), TSIZE(j), TSIZE(k), &TILE(i, k), n, &TILE(k, j), n,
+                      &TILE(i, j), n);
+    }
+  }
+}
+
+/* the task graph; called by one thread, so that i, j and k are firstprivate in the tasks */
+void lu_task_graph(int n, int nb, double* A, int* piv)
+{
+  int nt = (n + nb - 1)/nb;
+  int i, j, k;
+
+  for (k = 0; k < nt; k++) {
+    /* the panel is on the critical path, so it goes first if the runtime allows */
+#pragma omp task depend(iterator(t = k:nt), inout: TILE(t, k)) priority(1)
+    lu_panel(k, n, nb, A, piv);
+
+    /* the pivots of step k are ready once tile (k,k) is */
+    for (j = 0; j < nt; j++) {
+      if (j == k) continue;
+#pragma omp task depend(in: TILE(k, k)) depend(iterator(t = k:nt), inout: TILE(t, j))
+      lu_swap_solve(k, j, n, nb, A, piv);
+    }
+
+    for (j = k + 1; j < nt; j++)
+      for (i = k + 1; i < nt; i++) {
+#pragma omp task depend(in: TILE(i, k), TILE(k, j)) depend(inout: TILE(i, j))
+        gemm_update(TSIZE(i), TSIZE(j), TSIZE(k), &TILE(i, k), n, &TILE(k, j), n,
+                    &TILE(i, j), n);
+      }
+  }
+}
+
+void lu_tasks(int n, int nb, double* A, int* piv)
+{
+#pragma omp parallel
+#pragma omp single
+  lu_task_graph(n, nb, A, piv);
+}
+
+/*
+** ------------------------------------------------------------------
+** Cholesky kernels
+**
+** The blocked DGEMM has no transposes, so each tile of L below the
+** diagonal is also written, transposed, to the same place in the upper
+** triangle of A: the update of tile (i,j) is then L(i,k) L(j,k)^T =
+** L(i,k) A(k,j), a plain product of two tiles.
+** ------------------------------------------------------------------
+*/
+
+/* factor tile (k,k) in place: the lower triangle becomes L */
+void chol_diag(int k, int n, int nb, double* A)
+{
+  double* L = &TILE(k, k);
+  int kb = TSIZE(k), i, j, p;
+  double d;
+
+  for (j = 0; j < kb; j++) {
+    d = L[j + (long)j*n];
+    for (p = 0; p < j; p++)
+      d -= L[j + (long)p*n]*L[j + (long)p*n];
+    if (d <= 0.0) {
+#pragma omp atomic write
+      failed = 1;
+      return;
+    }
+    d = sqrt(d);
+    L[j + (long)j*n] = d;
+    for (i = j + 1; i < kb; i++) {
+      double s = L[i + (long)j*n];
+      for (p = 0; p < j; p++)
+        s -= L[i + (long)p*n]*L[j + (long)p*n];
+      L[i + (long)j*n] = s / d;
+    }
+  }
+}
+
+/* tile (i,k) = tile (i,k) L(k,k)^-T, and its transpose into tile (k,i) */
+void chol_solve(int i, int k, int n, int nb, double* A)
+{
+  const double* L = &TILE(k, k);
+  double* X = &TILE(i, k);
+  double* Xt = &TILE(k, i);
+  int ib = TSIZE(i), kb = TSIZE(k), r, c, p;
+
+  for (c = 0; c < kb; c++) {
+    for (p = 0; p < c; p++)
+      for (r = 0; r < ib; r++)
+        X[r + (long)c*n] -= X[r + (long)p*n]*L[c + (long)p*n];
+    for (r = 0; r < ib; r++)
+      X[r + (long)c*n] /= L[c + (long)c*n];
+  }
+  for (r = 0; r < ib; r++)
+    for (c = 0; c < kb; c++)
+      Xt[c + (long)r*n] = X[r + (long)c*n];
+}
+
+/* tile (i,j) -= L(i,k) L(j,k)^T, for j <= i; the diagonal tiles are done in full */
+void chol_update(int i, int j, int k, int n, int nb, double* A)
+{
+  gemm_update(TSIZE(i), TSIZE(j), TSIZE(k), &TILE(i, k), n, &TILE(k, j), n, &TILE(i, j), n);
+}
+
+void cholesky_fork_join(int n, int nb, double* A)
+{
+  int nt = (n + nb - 1)/nb;
+
+#pragma omp parallel
+  {
+    int i, j, k;
+
+    for (k = 0; k < nt; k++) {
+#pragma omp single
+      chol_diag(k, n, nb, A);
+
+#pragma omp for schedule(dynamic)
+      for (i = k + 1; i < nt; i++)
+        chol_solve(i, k, n, nb, A);
+
+      /* the lower triangle of tiles, so the rows get longer: dynamic again */
+#pragma omp for schedule(dynamic)
+      for (i = k + 1; i < nt; i++)
+        for (j = k + 1; j <= i; j++)
+          chol_update(i, j, k, n, nb, A);
+    }
+  }
+}
+
+void cholesky_task_graph(int n, int nb, double* A)
+{
+  int nt = (n + nb - 1)/nb;
+  int i, j, k;
+
+  for (k = 0; k < nt; k++) {
+#pragma omp task depend(inout: TILE(k, k)) priority(1)
+    chol_diag(k, n, nb, A);
+
+    /* tile (k,i) is written along with tile (i,k), and always read with it */
+    for (i = k + 1; i < nt; i++) {
+#pragma omp task depend(in: TILE(k, k)) depend(inout: TILE(i, k))
+      chol_solve(i, k, n, nb, A);
+    }
+
+    for (i = k + 1; i < nt; i++)
+      for (j = k + 1; j <= i; j++) {
+#pragma omp task depend(in: TILE(i, k), TILE(j, k)) depend(inout: TILE(i, j))
+        chol_update(i, j, k, n, nb, A);
+      }
+  }
+}
+
+void cholesky_tasks(int n, int nb, double* A)
+{
+#pragma omp parallel
+#pragma omp single
+  cholesky_task_graph(n, nb, A);
+}
+
+/*
+** ------------------------------------------------------------------
+** Checking: solve A x = b with the factors, and return the residual
+** |A x - b| / (|A| |x| n eps), in the infinity norm.  Anything up to
+** about 10 is as good as LAPACK.
+** ------------------------------------------------------------------
+*/
+double check(int cholesky, int n, const double* A0, const double* F, const int* piv)
+{
+  double *b, *x;
+  double anorm = 0.0, xnorm = 0.0, rnorm = 0.0, s;
+  long i, j;
+
+  b = dgemm_alloc(n);
+  x = dgemm_alloc(n);
+  for (i = 0; i < n; i++)
+    b[i] = x[i] = 1.0 + (double)i/n;
+
+  if (cholesky) {
+    /* L y = b, then L^T x = y */
+    for (j = 0; j < n; j++) {
+      x[j] /= F[j + j*n];
+      for (i = j + 1; i < n; i++)
+        x[i] -= F[i + j*n]*x[j];
+    }
+    for (i = n - 1; i >= 0; i--) {
+      for (j = i + 1; j < n; j++)
+        x[i] -= F[j + i*n]*x[j];
+      x[i] /= F[i + i*n];
+    }
+  }
+  else {
+    /* P b, then L y = P b, then U x = y */
+    for (i = 0; i < n; i++) {
+      s = x[i];
+      x[i] = x[piv[i]];
+      x[piv[i]] = s;
+    }
+    for (j = 0; j < n; j++)
+      for (i = j + 1; i < n; i++)
+        x[i] -= F[i + j*n]*x[j];
+    for (j = n - 1; j >= 0; j--) {
+      x[j] /= F[j + j*n];
+      for (i = 0; i < j; i++)
+        x[i] -= F[i + j*n]*x[j];
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    double rowsum = 0.0, r = -b[i];
+    for (j = 0; j < n; j++) {
+      rowsum += fabs(A0[i + j*n]);
+      r += A0[i + j*n]*x[j];
+    }
+    if (rowsum > anorm) anorm = rowsum;
+    if (fabs(r) > rnorm) rnorm = fabs(r);
+    if (fabs(x[i]) > xnorm) xnorm = fabs(x[i]);
+  }
+
+  free(b);
+  free(x);
+  return rnorm / (anorm*xnorm*n*DBL_EPSILON);
+}
+
+int main(int argc, char* argv[])
+{
+  int n = DIM, nb = NB;
+  int repeats = REPEATS;
+  int cholesky;
+  int schedule, r;
+  long i, j, nn;
+
+  double *A0, *A;
+  int* piv;
+
+  double flops;
+  double tic, elapsed, best, fork_join_time = 0.0;
+
+  if (argc < 2 || argc > 5 || (strcmp(argv[1], "lu") && strcmp(argv[1], "cholesky"))) {
+    fprintf(stderr, "Usage: %s <lu|cholesky> [n [nb [repeats]]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  cholesky = !strcmp(argv[1], "cholesky");
+  if (argc > 2) n = atoi(argv[2]);
+  if (argc > 3) nb = atoi(argv[3]);
+  if (argc > 4) repeats = atoi(argv[4]);
+  if (n < 1 || nb < 1 || repeats < 1) {
+    fprintf(stderr, "Error: n, nb and repeats must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+  nn = (long)n*n;
+
+  dgemm_default_params(&serial);
+  serial.nthreads = 1;
+
+  A0 = dgemm_alloc(nn);
+  A = dgemm_alloc(nn);
+  piv = (int*)malloc(sizeof(int)*n);
+  if (piv == NULL) {
+    fprintf(stderr, "Error: could not allocate the pivots\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* random for LU; for Cholesky, symmetric and made positive definite by a large diagonal */
+  philox_fill_uniform(A0, (long)n*n, 86456, 0);
+  if (cholesky) {
+    for (j = 0; j < n; j++) {
+      for (i = j + 1; i < n; i++)
+        A0[j + i*n] = A0[i + j*n];
+      A0[j + j*n] += n;
+    }
+  }
+  flops = cholesky ? n*(double)n*n/3.0 : 2.0*n*(double)n*n/3.0;
+
+  printf("%s of A(%d,%d) in %d x %d tiles, %d threads, fastest of %d runs\n\n",
+         cholesky ? "Cholesky" : "LU", n, n, nb, nb, omp_get_max_threads(), repeats);
+  printf("%-10s %12s %10s %10s %12s\n", "schedule", "time (s)", "GFLOP/s", "speed-up", "residual");
+
+  for (schedule = 0; schedule < NSCHEDULES; schedule++) {
+    best = 0.0;
+    /* run 0 is the warm-up */
+    for (r = 0; r <= repeats; r++) {
+      memcpy(A, A0, sizeof(double)*nn);
+      tic = omp_get_wtime();
+      if (cholesky && schedule == FORK_JOIN)
+        cholesky_fork_join(n, nb, A);
+      else if (cholesky)
+        cholesky_tasks(n, nb, A);
+      else if (schedule == FORK_JOIN)
+        lu_fork_join(n, nb, A, piv);
+      else
+        lu_tasks(n, nb, A, piv);
+      elapsed = omp_get_wtime() - tic;
+      if (r == 1 || (r > 1 && elapsed < best)) best = elapsed;
+    }
+    if (schedule == FORK_JOIN)
+      fork_join_time = best;
+
+    if (failed) {
+      fprintf(stderr, "Error: the matrix is not positive definite\n");
+      exit(EXIT_FAILURE);
+    }
+    printf("%-10s %12.6f %10.2f %10.2f %12.3g\n", schedules[schedule], best,
+           flops / best / 1.0e9, fork_join_time / best, check(cholesky, n, A0, A, piv));
+  }
+
+  free(A0);
+  free(A);
+  free(piv);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,214 @@
+/*
+** B = A^T for a column-major m x n matrix A, in several ways, each timed
+** against a plain copy of the same amount of memory:
+**
+**   copy      - B = A, the bandwidth a transpose would get if reading A and
+**               writing B were both in order
+**   naive     - read A in order, write B with a stride of n
+**   blocked   - go through A in nb x nb tiles, so that the lines of B written
+**               by one tile are still in cache when the next column of the
+**               tile comes along
+**   oblivious - split the longer side in half, recursively, until the pieces
+**               are small; at some depth the pieces fit each level of cache,
+**               whatever its size, with no block size to tune.  The top of
+**               the recursion is shared out as OpenMP tasks
+**   inplace   - A = A^T for a square matrix, with no second array: the tiles
+**               either side of the diagonal are swapped and transposed in
+**               pairs, and those on the diagonal transposed in place
+**
+** The bandwidth counts both the read and the write of every element.
+**
+** Usage: omp_transpose.exe [m [n [nb [repeats]]]]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#define DIM 4096
+#define NB 32          /* tile size for blocked and inplace */
+#define LEAF 32        /* oblivious stops splitting below LEAF x LEAF */
+#define TASK_SIZE (256*256)    /* ... and making tasks below this many elements */
+#define REPEATS 5      /* timed runs of each variant; we keep the fastest */
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+#define NVARIANTS 5
+enum { COPY, NAIVE, BLOCKED, OBLIVIOUS, INPLACE };
+static const char* names[NVARIANTS] = { "copy", "naive", "blocked", "oblivious", "inplace" };
+
+void copy(long m, long n, const double* A, double* B)
+{
+  long i;
+
+#pragma omp parallel for schedule(static)
+  for (i = 0; i < m*n; i++)
+    B[i] = A[i];
+}
+
+void transpose_naive(int m, int n, const double* A, double* B)
+{
+  int i, j;
+
+#pragma omp parallel for schedule(static) private(i)
+  for (j = 0; j < n; j++)
+    for (i = 0; i < m; i++)
+      B[j + (long)i*n] = A[i + (long)j*m];
+}
+
+void transpose_blocked(int m, int n, int nb, const double* A, double* B)
+{
+  int ii, jj, i, j;
+
+#pragma omp parallel for collapse(2) schedule(static) private(i, j)
+  for (jj = 0; jj < n; jj += nb)
+    for (ii = 0; ii < m; ii += nb)
+      for (j = jj; j < MIN(jj + nb, n); j++)
+        for (i = ii; i < MIN(ii + nb, m); i++)
+          B[j + (long)i*n] = A[i + (long)j*m];
+}
+
+/*
+** The rows i0..i0+mb-1 and columns j0..j0+nb-1 of A, into B.  lda and ldb
+** are the leading dimensions of the whole matrices.
+*/
+void oblivious(int i0, int j0, int mb, int nb, const double* A, int lda, double* B, int ldb)
+{
+  int i, j;
+
+  if (mb <= LEAF && nb <= LEAF) {
+    for (j = j0; j < j0 + nb; j++)
+      for (i = i0; i < i0 + mb; i++)
+        B[j + (long)i*ldb] = A[i + (long)j*lda];
+  }
+  else if (mb >= nb) {
+#pragma omp task if((long)mb*nb > TASK_SIZE)
+    oblivious(i0, j0, mb/2, nb, A, lda, B, ldb);
+    oblivious(i0 + mb/2, j0, mb - mb/2, nb, A, lda, B, ldb);
+#pragma omp taskwait
+  }
+  else {
+#pragma omp task if((long)mb*nb > TASK_SIZE)
+    oblivious(i0, j0, mb, nb/2, A, lda, B, ldb);
+    oblivious(i0, j0 + nb/2, mb, nb - nb/2, A, lda, B, ldb);
+#pragma omp taskwait
+  }
+}
+
+void transpose_oblivious(int m, int n, const double* A, double* B)
+{
+#pragma omp parallel
+#pragma omp single
+  oblivious(0, 0, m, n, A, m, B, n);
+}
+
+void transpose_inplace(int n, int nb, double* A)
+{
+  int ii, jj, i, j;
+  double tmp;
+
+  /* the rows of tiles get shorter down the matrix, hence the dynamic schedule */
+#pragma omp parallel for schedule(dynamic) private(jj, i, j, tmp)
+  for (ii = 0; ii < n; ii += nb) {
+    /* the tile on the diagonal */
+    for (j = ii; j < MIN(ii + nb, n); j++)
+      for (i = j + 1; i < MIN(ii + nb, n); i++) {
+        tmp = A[i + (long)j*n];
+        A[i + (long)j*n] = A[j + (long)i*n];
+        A[j + (long)i*n] = tmp;
+      }
+    /* the tiles to its right, each swapped with its mirror below the diagonal */
+    for (jj = ii + nb; jj < n; jj += nb)
+      for (j = jj; j < MIN(jj + nb, n); j++)
+        for (i = ii; i < MIN(ii + nb, n); i++) {
+          tmp = A[i + (long)j*n];
+          A[i + (long)j*n] = A[j + (long)i*n];
+          A[j + (long)i*n] = tmp;
+        }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int m = DIM, n = -1, nb = NB;
+  int repeats = REPEATS;
+  int variant, r;
+  long i, j, errors;
+
+  double *A, *B;
+  double tic, elapsed, best, copy_time = 0.0;
+
+  if (argc > 5) {
+    fprintf(stderr, "Usage: %s [m [n [nb [repeats]]]]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (argc > 1) m = atoi(argv[1]);
+  if (argc > 2) n = atoi(argv[2]);
+  if (argc > 3) nb = atoi(argv[3]);
+  if (argc > 4) repeats = atoi(argv[4]);
+  if (n < 0) n = m;
+  if (m < 1 || n < 1 || nb < 1 || repeats < 1) {
+    fprintf(stderr, "Error: m, n, nb and repeats must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+
+  A = (double*)malloc(sizeof(double)*m*n);
+  B = (double*)malloc(sizeof(double)*m*n);
+  if (A == NULL || B == NULL) {
+    fprintf(stderr, "Error: could not allocate two %d x %d matrices\n", m, n);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("B = A^T for A(%d,%d), %d threads, %d x %d tiles, fastest of %d runs\n\n",
+         m, n, omp_get_max_threads(), nb, nb, repeats);
+  printf("%-10s %12s %10s %10s\n", "variant", "time (s)", "GB/s", "vs copy");
+
+  for (variant = 0; variant < NVARIANTS; variant++) {
+    if (variant == INPLACE && m != n) {
+      printf("%-10s %12s\n", names[variant], "(square only)");
+      continue;
+    }
+
+    best = 0.0;
+    /* run 0 is the warm-up */
+    for (r = 0; r <= repeats; r++) {
+      /* every entry is different, and a double holds it exactly */
+#pragma omp parallel for schedule(static)
+      for (i = 0; i < (long)m*n; i++)
+        A[i] = (double)i;
+
+      tic = omp_get_wtime();
+      switch (variant) {
+      case COPY:      copy(m, n, A, B); break;
+      case NAIVE:     transpose_naive(m, n, A, B); break;
+      case BLOCKED:   transpose_blocked(m, n, nb, A, B); break;
+      case OBLIVIOUS: transpose_oblivious(m, n, A, B); break;
+      case INPLACE:   transpose_inplace(n, nb, A); break;
+      }
+      elapsed = omp_get_wtime() - tic;
+      if (r == 1 || (r > 1 && elapsed < best)) best = elapsed;
+    }
+    if (variant == COPY)
+      copy_time = best;
+
+    /* entry (i,j) of A was i + j*m, so entry (j,i) of the transpose should be */
+    errors = 0;
+    if (variant != COPY) {
+      const double* T = (variant == INPLACE) ? A : B;
+      for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+          if (T[j + i*n] != (double)(i + j*m)) errors++;
+    }
+
+    printf("%-10s %12.6f %10.2f %10.2f", names[variant], best,
+           2.0*sizeof(double)*m*n / best / 1.0e9, copy_time / best);
+    if (errors)
+      printf("   %ld WRONG ENTRIES", errors);
+    printf("\n");
+  }
+
+  free(A);
+  free(B);
+
+  return EXIT_SUCCESS;
+}
@@ -1,24 +1,42 @@
+/*
+** C = A B using dgemm from one or more BLAS libraries, chosen at run-time.
+**
+** Each backend is loaded with dlopen(), its answer is compared with the
+** naive triple loop of serial_naive_mm.c, and it is timed on 1, 2, 4, ...
+** threads up to OMP_NUM_THREADS (or the number of cores).
+**
+** Usage: serial_blas_mm.exe [backend ...]
+**
+** where a backend is openblas, blis, mkl or reference, or the file name of
+** any library exporting dgemm_ (the default is openblas).
+*/
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <math.h>
+#include <omp.h>
+
+#include "blas_loader.h"
 
 #define DIM1 2000
 #define DIM2 2000
 #define DIM3 2000
 
-#define DGEMM dgemm_
+#define REPEATS 3    /* timed runs for each thread count; we keep the fastest */
 
-int main()
+int main(int argc, char* argv[])
 {
   int i, j, k;
+  int b, nb, r, nthreads, maxthreads;
 
   double *A;
-  double *B; 
+  double *B;
   double *C;
+  double *Cref;
 
-  long dim1 = DIM1;
-  long dim2 = DIM2;
-  long dim3 = DIM3;
+  int dim1 = DIM1;
+  int dim2 = DIM2;
+  int dim3 = DIM3;
 
   char transa = 'N';
   char transb = 'N';
@@ -26,12 +44,27 @@ int main()
   double alpha = 1.0;
   double beta  = 0.0;
 
-  clock_t tic, toc;
-  double maxr;
+  const char* default_backend[] = { "openblas" };
+  const char** backends;
+  blas_backend_t blas;
+
+  double tic, toc;
+  double elapsed_time, best_time, serial_time;
+  double maxr, err, maxerr, maxref;
+
+  if (argc > 1) {
+    backends = (const char**)&argv[1];
+    nb = argc - 1;
+  }
+  else {
+    backends = default_backend;
+    nb = 1;
+  }
 
   A = (double*)malloc(sizeof(double)*(dim1*dim2));
   B = (double*)malloc(sizeof(double)*(dim2*dim3));
   C = (double*)malloc(sizeof(double)*(dim1*dim3));
+  Cref = (double*)malloc(sizeof(double)*(dim1*dim3));
 
   srand(86456);
   maxr = (double)RAND_MAX;
@@ -44,18 +77,82 @@ int main()
     for (j = 0; j < dim3; j++)
       B[i + j*dim2] = rand()/maxr;
 
-  tic = clock();
-
-  DGEMM(&transa,&transb,&dim1,&dim3,&dim2,&alpha,A,&dim1,B,&dim2,&beta,C,&dim1);
-
-  toc = clock();
-
-  printf("time for C(%d,%d) = A(%d,%d) B(%d,%d) is %fs\n",
-	 dim1, dim3, dim1, dim2, dim2, dim3,((float)toc -(float)tic)/(float)CLOCKS_PER_SEC);
+  /* the reference answer, from the naive loop */
+  tic = omp_get_wtime();
+  for (j = 0; j < dim3; j++)
+    {
+      for (i = 0; i < dim1; i++)
+	Cref[i + j*dim1] = 0.;
+      for (k = 0; k < dim2; k++)
+	for (i = 0; i < dim1; i++)
+	  Cref[i + j*dim1] += A[i + k*dim1]*B[k + j*dim2];
+    }
+  toc = omp_get_wtime();
+
+  maxref = 0.0;
+  for (i = 0; i < dim1*dim3; i++)
+    if (fabs(Cref[i]) > maxref) maxref = fabs(Cref[i]);
+
+  printf("time for C(%d,%d) = A(%d,%d) B(%d,%d) is %fs (naive loop, %.2f GFLOP/s)\n",
+	 dim1, dim3, dim1, dim2, dim2, dim3, toc - tic,
+	 2.0*dim1*dim2*dim3 / (toc - tic) / 1.0e9);
+
+  maxthreads = omp_get_max_threads();
+
+  for (b = 0; b < nb; b++) {
+    if (blas_load(backends[b], &blas) != 0)
+      continue;
+
+    /* check against the naive loop */
+    blas.dgemm(&transa,&transb,&dim1,&dim3,&dim2,&alpha,A,&dim1,B,&dim2,&beta,C,&dim1);
+    maxerr = 0.0;
+    for (i = 0; i < dim1*dim3; i++) {
+      err = fabs(C[i] - Cref[i]);
+      if (err > maxerr) maxerr = err;
+    }
+
+    printf("\n%s (%s): max difference from the naive loop %.2e (relative %.2e)\n",
+	   blas.name, blas.path, maxerr, maxerr / maxref);
+    if (blas.set_threads == NULL)
+      printf("  no way to set the number of threads: timing the library's default only\n");
+
+    serial_time = 0.0;
+    nthreads = 1;
+    while (nthreads <= maxthreads) {
+      blas_set_threads(&blas, nthreads);
+
+      /* one warm-up run, then the fastest of the timed runs */
+      blas.dgemm(&transa,&transb,&dim1,&dim3,&dim2,&alpha,A,&dim1,B,&dim2,&beta,C,&dim1);
+      best_time = 0.0;
+      for (r = 0; r < REPEATS; r++) {
+	tic = omp_get_wtime();
+	blas.dgemm(&transa,&transb,&dim1,&dim3,&dim2,&alpha,A,&dim1,B,&dim2,&beta,C,&dim1);
+	toc = omp_get_wtime();
+	elapsed_time = toc - tic;
+	if (r == 0 || elapsed_time < best_time) best_time = elapsed_time;
+      }
+
+      if (blas.set_threads == NULL) {
+	printf("  default threads: %fs (%.2f GFLOP/s)\n", best_time,
+	       2.0*dim1*dim2*dim3 / best_time / 1.0e9);
+	break;
+      }
+      if (nthreads == 1) serial_time = best_time;
+      printf("  %3d threads: %fs (%.2f GFLOP/s, speed-up %.2f)\n", nthreads, best_time,
+	     2.0*dim1*dim2*dim3 / best_time / 1.0e9, serial_time / best_time);
+
+      /* 1, 2, 4, ... and finally maxthreads itself */
+      if (nthreads < maxthreads && 2*nthreads > maxthreads)
+	nthreads = maxthreads;
+      else
+	nthreads *= 2;
+    }
+  }
 
   free(A);
   free(B);
   free(C);
+  free(Cref);
 
   return EXIT_SUCCESS;
 }